@@ -14,7 +14,9 @@
 
 //TODO: Enable particle-wise sphere radius
 
-template<typename T_real=double, typename T_vertex=GLfloat>
+//T_simReal is the scalar type of the rendered PBD::CWorld (float for single precision simulations)
+
+template<typename T_real=double, typename T_vertex=GLfloat, typename T_simReal=double>
 class CGLParticleSystem
 {
 public:
@@ -41,9 +43,9 @@ public:
 
 	void setPointSize(const GLuint& s){	m_pointSize = s; }
 
-    PBD::CWorld* getParticleSystem() {return m_pPSystem;}
+    PBD::CWorld<T_simReal>* getParticleSystem() {return m_pPSystem;}
 
-    void setParticleSystem( PBD::CWorld* pS) {m_pPSystem = pS;}
+    void setParticleSystem( PBD::CWorld<T_simReal>* pS) {m_pPSystem = pS;}
 
     std::vector<T_vertex>& getColors() {return m_colors;}
 
@@ -74,14 +76,14 @@ public:
 
     DRAW_PRIMITIVE getDrawPrimitive( ){ return m_drawPrimitive; }
 
-    bool addEigenVectorsAndCoMtoVertexBuffer( Eigen::Vector3d CoM, Eigen::Matrix3d cov, T_real colorMult = T_real(1.0), const T_real length = T_real(1.0));
+    bool addEigenVectorsAndCoMtoVertexBuffer( Eigen::Matrix<T_simReal,3,1> CoM, Eigen::Matrix<T_simReal,3,3> cov, T_real colorMult = T_real(1.0), const T_real length = T_real(1.0));
 
 protected:
     bool updateBuffersPoints();
 
     bool updateConstraintBuffers();
 
-    PBD::CWorld* m_pPSystem;
+    PBD::CWorld<T_simReal>* m_pPSystem;
 
     std::vector<T_vertex> m_colors;
 
@@ -106,8 +108,8 @@ protected:
 };
 
 
-template<class T_real, class T_vertex>
-CGLParticleSystem<T_real,T_vertex>::CGLParticleSystem()
+template<class T_real, class T_vertex, class T_simReal>
+CGLParticleSystem<T_real,T_vertex,T_simReal>::CGLParticleSystem()
 {
 	glEnable(GL_PROGRAM_POINT_SIZE);
     glGenVertexArrays(1, &VAO);
@@ -127,8 +129,8 @@ CGLParticleSystem<T_real,T_vertex>::CGLParticleSystem()
 
 }
 
-template<class T_real, class T_vertex>
-CGLParticleSystem<T_real,T_vertex>::~CGLParticleSystem()
+template<class T_real, class T_vertex, class T_simReal>
+CGLParticleSystem<T_real,T_vertex,T_simReal>::~CGLParticleSystem()
 {
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
@@ -136,8 +138,8 @@ CGLParticleSystem<T_real,T_vertex>::~CGLParticleSystem()
     glDeleteBuffers(1, &VBOConstraints);
 }
 
-template<class T_real, class T_vertex>
-bool CGLParticleSystem<T_real,T_vertex>::updateBuffers()
+template<class T_real, class T_vertex, class T_simReal>
+bool CGLParticleSystem<T_real,T_vertex,T_simReal>::updateBuffers()
 {
     updateBuffersPoints();
 
@@ -149,8 +151,8 @@ bool CGLParticleSystem<T_real,T_vertex>::updateBuffers()
 };
 
 
-template<class T_real, class T_vertex>
-bool CGLParticleSystem<T_real,T_vertex>::updateBuffersPoints()
+template<class T_real, class T_vertex, class T_simReal>
+bool CGLParticleSystem<T_real,T_vertex,T_simReal>::updateBuffersPoints()
 {
 
     if( m_colors.size()*3 != m_pPSystem->m_particles.size())
@@ -191,7 +193,7 @@ bool CGLParticleSystem<T_real,T_vertex>::updateBuffersPoints()
         {
             for (const auto& p:c->m_shapeMatchingPositions)
             {
-                Eigen::Vector3d pos = c->getDeformedCovMat().inverse() * p + c->getDeformedCoM();
+                Eigen::Matrix<T_simReal,3,1> pos = c->getDeformedCovMat().inverse() * p + c->getDeformedCoM();
                 m_vertexBufferDataPoints.push_back(pos(0));
                 m_vertexBufferDataPoints.push_back(pos(1));
                 m_vertexBufferDataPoints.push_back(pos(2)+1);
@@ -224,8 +226,8 @@ bool CGLParticleSystem<T_real,T_vertex>::updateBuffersPoints()
 	return true;
 }
 
-template<class T_real, class T_vertex>
-bool CGLParticleSystem<T_real,T_vertex>::updateConstraintBuffers()
+template<class T_real, class T_vertex, class T_simReal>
+bool CGLParticleSystem<T_real,T_vertex,T_simReal>::updateConstraintBuffers()
 {
     m_vertexBufferData.clear();
 
@@ -239,9 +241,9 @@ bool CGLParticleSystem<T_real,T_vertex>::updateConstraintBuffers()
     //CREATE LINES FOR CONTACT CONSTRAINTS
     for (uint p=0; p<m_pPSystem->m_constraints.size() ; ++p)
     {
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[0]->m_position(0));
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[0]->m_position(1));
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[0]->m_position(2));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[0] ](0));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[0] ](1));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[0] ](2));
 
         if (m_pPSystem->m_constraints[p]->isSatisfied())
         {
@@ -256,9 +258,9 @@ bool CGLParticleSystem<T_real,T_vertex>::updateConstraintBuffers()
             m_vertexBufferData.push_back(0);
         }
 
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[1]->m_position(0));
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[1]->m_position(1));
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[1]->m_position(2));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[1] ](0));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[1] ](1));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[1] ](2));
 
         if (m_pPSystem->m_constraints[p]->isSatisfied())
         {
@@ -275,13 +277,13 @@ bool CGLParticleSystem<T_real,T_vertex>::updateConstraintBuffers()
     }
 
     //CREATE LINES FOR PERMANENT CONSTRAINTS
-    for (uint p=0; p<m_pPSystem->m_permanentConstraints.size() ; ++p)
+    m_pPSystem->m_permanentConstraints.forEach([this](const auto& c)
     {
-        m_vertexBufferData.push_back(m_pPSystem->m_permanentConstraints[p]->m_particles[0]->m_position(0));
-        m_vertexBufferData.push_back(m_pPSystem->m_permanentConstraints[p]->m_particles[0]->m_position(1));
-        m_vertexBufferData.push_back(m_pPSystem->m_permanentConstraints[p]->m_particles[0]->m_position(2));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ c.m_particles[0] ](0));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ c.m_particles[0] ](1));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ c.m_particles[0] ](2));
 
-        if (m_pPSystem->m_permanentConstraints[p]->isSatisfied())
+        if (c.isSatisfied(m_pPSystem->m_particles))
         {
             m_vertexBufferData.push_back(0);
             m_vertexBufferData.push_back(1);
@@ -294,11 +296,11 @@ bool CGLParticleSystem<T_real,T_vertex>::updateConstraintBuffers()
             m_vertexBufferData.push_back(0);
         }
 
-        m_vertexBufferData.push_back(m_pPSystem->m_permanentConstraints[p]->m_particles[1]->m_position(0));
-        m_vertexBufferData.push_back(m_pPSystem->m_permanentConstraints[p]->m_particles[1]->m_position(1));
-        m_vertexBufferData.push_back(m_pPSystem->m_permanentConstraints[p]->m_particles[1]->m_position(2));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ c.m_particles[1] ](0));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ c.m_particles[1] ](1));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ c.m_particles[1] ](2));
 
-        if (m_pPSystem->m_permanentConstraints[p]->isSatisfied())
+        if (c.isSatisfied(m_pPSystem->m_particles))
         {
             m_vertexBufferData.push_back(0);
             m_vertexBufferData.push_back(1);
@@ -310,7 +312,7 @@ bool CGLParticleSystem<T_real,T_vertex>::updateConstraintBuffers()
             m_vertexBufferData.push_back(0);
             m_vertexBufferData.push_back(0);
         }
-    }
+    });
 
     //CREATE LINES FOR SHAPE MATCHING CONSTRAINTS
     for (uint p=0; p<m_pPSystem->m_shapeMatchingConstraints.size() ; ++p)
@@ -346,8 +348,8 @@ bool CGLParticleSystem<T_real,T_vertex>::updateConstraintBuffers()
 }
 
 
-template<class T_real, class T_vertex>
-bool CGLParticleSystem<T_real,T_vertex>::addEigenVectorsAndCoMtoVertexBuffer( Eigen::Vector3d CoM, Eigen::Matrix3d cov, const T_real colorMult, const T_real length)
+template<class T_real, class T_vertex, class T_simReal>
+bool CGLParticleSystem<T_real,T_vertex,T_simReal>::addEigenVectorsAndCoMtoVertexBuffer( Eigen::Matrix<T_simReal,3,1> CoM, Eigen::Matrix<T_simReal,3,3> cov, const T_real colorMult, const T_real length)
 {
     //Vertex 1 of the first eigenvector
     m_vertexBufferData.push_back( CoM[0] );
@@ -406,8 +408,8 @@ bool CGLParticleSystem<T_real,T_vertex>::addEigenVectorsAndCoMtoVertexBuffer( Ei
 };
 
 
-template<class T_real, class T_vertex>
-bool CGLParticleSystem<T_real,T_vertex>::draw(Shader *shader, Shader *constraintShader)
+template<class T_real, class T_vertex, class T_simReal>
+bool CGLParticleSystem<T_real,T_vertex,T_simReal>::draw(Shader *shader, Shader *constraintShader)
 {
     //Update transformation matrix
     m_transform.m_data.computeMatrix();
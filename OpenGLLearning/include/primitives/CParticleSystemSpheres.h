@@ -14,7 +14,7 @@
 #include <CGLShader.hpp>
 #include <physics/CWorld.h>
 
-template<typename T_real=double, typename T_vertex=GLfloat>
+template<typename T_real=double, typename T_vertex=GLfloat, typename T_simReal=double>
 class CGLParticleSystem
 {
 	typedef std::shared_ptr<CGLParticleSystem> Ptr;
@@ -36,9 +36,9 @@ public:
 
 	void setPointSize(const GLuint& s){	m_particleSize = s; }
 
-    PBD::CWorld* getParticleSystem() {return m_pPSystem;}
+    PBD::CWorld<T_simReal>* getParticleSystem() {return m_pPSystem;}
 
-    void setParticleSystem( PBD::CWorld* pS) {m_pPSystem = pS;}
+    void setParticleSystem( PBD::CWorld<T_simReal>* pS) {m_pPSystem = pS;}
 
     std::vector<T_vertex>& getColors() {return m_colors;}
 
@@ -57,7 +57,7 @@ public:
         }
     }
 
-    void setColors( const std::vector<PBD::CParticle<> >& vertices )
+    void setColors( const std::vector<PBD::CParticle<T_simReal> >& vertices )
     {
         m_colors.clear();
         for (uint p=0; p<vertices.size() ; ++p)
@@ -87,7 +87,7 @@ public:
     void showConstraints( bool c) { m_drawConstraints = c; }
 
 protected:
-    PBD::CWorld* m_pPSystem;
+    PBD::CWorld<T_simReal>* m_pPSystem;
 
     std::vector<T_vertex> m_colors;
 
@@ -106,8 +106,8 @@ protected:
 };
 
 
-template<class T_real, class T_vertex>
-CGLParticleSystem<T_real,T_vertex>::CGLParticleSystem()
+template<class T_real, class T_vertex, class T_simReal>
+CGLParticleSystem<T_real,T_vertex,T_simReal>::CGLParticleSystem()
 {
 	glEnable(GL_PROGRAM_POINT_SIZE);
     glGenVertexArrays(1, &VAO);
@@ -117,8 +117,8 @@ CGLParticleSystem<T_real,T_vertex>::CGLParticleSystem()
 	m_pointSize = 1;
 }
 
-template<class T_real, class T_vertex>
-CGLParticleSystem<T_real,T_vertex>::~CGLParticleSystem()
+template<class T_real, class T_vertex, class T_simReal>
+CGLParticleSystem<T_real,T_vertex,T_simReal>::~CGLParticleSystem()
 {
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
@@ -126,8 +126,8 @@ CGLParticleSystem<T_real,T_vertex>::~CGLParticleSystem()
     glDeleteBuffers(1, &VBOConstraints);
 }
 
-template<class T_real, class T_vertex>
-bool CGLParticleSystem<T_real,T_vertex>::updateBuffers()
+template<class T_real, class T_vertex, class T_simReal>
+bool CGLParticleSystem<T_real,T_vertex,T_simReal>::updateBuffers()
 {
 
     if( m_colors.size()*3 != m_pPSystem->m_particles.size())
@@ -188,15 +188,15 @@ bool CGLParticleSystem<T_real,T_vertex>::updateBuffers()
 	return true;
 }
 
-template<class T_real, class T_vertex>
-bool CGLParticleSystem<T_real,T_vertex>::updateConstraintBuffers()
+template<class T_real, class T_vertex, class T_simReal>
+bool CGLParticleSystem<T_real,T_vertex,T_simReal>::updateConstraintBuffers()
 {
     m_vertexBufferData.clear();
     for (uint p=0; p<m_pPSystem->m_constraints.size() ; ++p)
     {
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[0]->m_position(0));
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[0]->m_position(1));
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[0]->m_position(2));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[0] ](0));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[0] ](1));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[0] ](2));
 
         if (m_pPSystem->m_constraints[p]->isSatisfied())
         {
@@ -211,9 +211,9 @@ bool CGLParticleSystem<T_real,T_vertex>::updateConstraintBuffers()
             m_vertexBufferData.push_back(0);
         }
 
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[1]->m_position(0));
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[1]->m_position(1));
-        m_vertexBufferData.push_back(m_pPSystem->m_constraints[p]->m_particles[1]->m_position(2));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[1] ](0));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[1] ](1));
+        m_vertexBufferData.push_back(m_pPSystem->m_particles.m_position[ m_pPSystem->m_constraints[p]->m_particles[1] ](2));
 
         if (m_pPSystem->m_constraints[p]->isSatisfied())
         {
@@ -251,8 +251,8 @@ bool CGLParticleSystem<T_real,T_vertex>::updateConstraintBuffers()
 }
 
 
-template<class T_real, class T_vertex>
-bool CGLParticleSystem<T_real,T_vertex>::draw(Shader *shader)
+template<class T_real, class T_vertex, class T_simReal>
+bool CGLParticleSystem<T_real,T_vertex,T_simReal>::draw(Shader *shader)
 {
     shader->Use();
     //Update transformation matrix
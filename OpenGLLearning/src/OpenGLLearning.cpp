@@ -43,9 +43,13 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 void Do_Movement();
 
 //PBD Definitions
+#ifdef _PBD_SINGLE_PRECISION_
+typedef float T_real;
+#else
 typedef double T_real;
+#endif
 typedef vec3::Vector3<T_real> Vector3;
-void PBDCreateObjects( PBD::CWorld* pWorld );
+void PBDCreateObjects( PBD::CWorld<T_real>* pWorld );
 
 
 template<typename T>
@@ -140,13 +144,13 @@ int main()
 
 
     T_real simStep = 0.005;
-    PBD::CWorld PBDWorld;
-    PBDWorld.m_gravity = Eigen::Vector3d(0,0,-9.81);
+    PBD::CWorld<T_real> PBDWorld;
+    PBDWorld.m_gravity = Eigen::Matrix<T_real,3,1>(0,0,-9.81);
     PBDCreateObjects( &PBDWorld );
 
-    CGLParticleSystem<GLfloat> particleSystemsPointCloud;
+    CGLParticleSystem<GLfloat, GLfloat, T_real> particleSystemsPointCloud;
     particleSystemsPointCloud.setPointSize(g_pointSize);
-    particleSystemsPointCloud.setDrawPrimitive( CGLParticleSystem<GLfloat>::SPHERES );
+    particleSystemsPointCloud.setDrawPrimitive( CGLParticleSystem<GLfloat, GLfloat, T_real>::SPHERES );
     //particleSystemsPointCloud.setDrawPrimitive( CGLParticleSystem<GLfloat>::POINTS );
     particleSystemsPointCloud.setParticleSystem(&PBDWorld);
     particleSystemsPointCloud.updateBuffers();
@@ -190,8 +194,8 @@ int main()
     {
         if (g_reset)
         {
-            PBDWorld = PBD::CWorld();
-            PBDWorld.m_gravity = Eigen::Vector3d(0,0,-9.81);
+            PBDWorld = PBD::CWorld<T_real>();
+            PBDWorld.m_gravity = Eigen::Matrix<T_real,3,1>(0,0,-9.81);
             PBDCreateObjects( &PBDWorld );
             particleSystemsPointCloud.setParticleSystem(&PBDWorld);
             particleSystemsPointCloud.updateBuffers();
@@ -420,9 +424,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 }
 
 
-typedef double T_real;
-typedef vec3::Vector3<T_real> Vector3;
-void PBDCreateObjects( PBD::CWorld* pWorld )
+void PBDCreateObjects( PBD::CWorld<T_real>* pWorld )
 {
 
     std::cout<<"Creating objects"<<std::endl;
@@ -432,13 +434,13 @@ void PBDCreateObjects( PBD::CWorld* pWorld )
 //    PBD::createParticleSystemSolidCube<T_real>(Vector3(0.5,0.5,1) , Vector3(0.2,0.3,0.3), pWorld, 0.1, 0.02, 2);
 
     size_t object2Particle1 = pWorld->m_particles.size();
-    PBD::createParticleSystemFromASCIIXYZPointCloud(Vector3(.5,.5,2) ,
+    PBD::createParticleSystemFromASCIIXYZPointCloud<T_real>(Vector3(.5,.5,2) ,
                                                     std::string("/home/labuser/workspace/data/bun_zipper.xyz"),
                                                     pWorld, 0.1, 0.02, 1, 6.0);
 //    PBD::createParticleSystemSolidCube<T_real>(Vector3(0.5,0.5,2) , Vector3(0.2,0.3,0.3), pWorld, 0.1, 0.02, 1);
 
-    //Create a cube 5x5x0.05 m size with 5cm particles centered at 0,0,0 (This will be the floor)
-    PBD::createParticleSystemSolidCube<T_real>(Vector3(0,0,0) , Vector3(2,2,0.1), pWorld, 0.1, 0, 0);
+    //Floor: static plane at the top of the former 2x2 m particle slab
+    pWorld->m_staticColliders.m_planes.emplace_back(Eigen::Matrix<T_real,3,1>(0,0,0.1), Eigen::Matrix<T_real,3,1>(0,0,1));
 
     //Hang one object with a distance constraint from a point
 //    PBD::createParticleSystemSolidCube<T_real>(Vector3(0.5,0.5,4.5) , Vector3(0.1,0.1,0.1), pWorld, 0.1, 0, 3);   //Object to hang from
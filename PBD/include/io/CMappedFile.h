@@ -0,0 +1,71 @@
+#ifndef PBD_CMAPPEDFILE_H
+#define PBD_CMAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace PBD
+{
+
+/**
+ * Read-only memory mapping of a whole file. The mapping is released with the object.
+ * An empty file is open with size 0 and a null data pointer.
+ */
+class CMappedFile
+{
+public:
+    explicit CMappedFile(const std::string& filename): m_data(nullptr), m_size(0), m_open(false)
+    {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+
+        struct stat st;
+        if (::fstat(fd, &st) == 0)
+        {
+            m_size = size_t(st.st_size);
+            if (m_size == 0)
+            {
+                m_open = true;
+            }
+            else
+            {
+                void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED)
+                {
+                    m_data = static_cast<const char*>(p);
+                    m_open = true;
+                    ::madvise(p, m_size, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        ::close(fd);
+    }
+
+    ~CMappedFile()
+    {
+        if (m_data) ::munmap(const_cast<char*>(m_data), m_size);
+    }
+
+    CMappedFile(const CMappedFile&) = delete;
+
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    bool isOpen() const { return m_open; }
+
+    const char* data() const { return m_data; }
+
+    size_t size() const { return m_size; }
+
+protected:
+    const char* m_data;
+    size_t m_size;
+    bool m_open;
+};
+
+}
+
+#endif //PBD_CMAPPEDFILE_H
@@ -0,0 +1,570 @@
+#ifndef PBD_CTRAJECTORYRECORDER_H
+#define PBD_CTRAJECTORYRECORDER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <Common.h>
+#include <io/CMappedFile.h>
+#include <physics/CParticleStore.h>
+
+namespace PBD
+{
+
+/**
+ * Layout of the trajectory files written by CTrajectoryRecorder.
+ *
+ * File header, then one record per frame: a frame header followed by the positions quantized to 16 bits inside the
+ * frame AABB (stored as float min/max), optionally followed by the orientations (4 x int16 in [-1,1]) and the
+ * velocities (3 x float). Delta frames store the positions as zigzag varints of the difference with the quantized
+ * positions of the previous frame; every keyframeInterval-th frame is a keyframe with plain uint16 values.
+ * The file ends with the offset of every frame record and a trailer, for random access. A file without trailer
+ * (e.g. the process was killed) is still readable, its index is rebuilt by scanning the records.
+ */
+struct STrajectoryFormat
+{
+    const static uint32_t version = 1;
+
+    enum EFlags { ORIENTATION = 1, VELOCITY = 2, DELTA = 4 };
+
+    enum EEncoding { KEYFRAME = 0, DELTA_FRAME = 1 };
+
+    struct SFileHeader
+    {
+        char     m_magic[8];
+        uint32_t m_version;
+        uint32_t m_flags;
+        uint32_t m_keyframeInterval;
+        uint32_t m_reserved;
+    };
+
+    struct SFrameHeader
+    {
+        uint64_t m_frame;            ///< Index given by the simulation (e.g. the step number).
+        double   m_time;
+        uint64_t m_numParticles;
+        uint32_t m_encoding;
+        uint32_t m_reserved;
+        uint64_t m_payloadBytes;     ///< Bytes of the record after this header.
+        float    m_min[3];           ///< Quantization AABB.
+        float    m_max[3];
+    };
+
+    struct STrailer
+    {
+        uint64_t m_indexOffset;
+        uint64_t m_numFrames;
+        char     m_magic[8];
+    };
+
+    static uint16_t quantize(const double& v, const float& min, const float& max)
+    {
+        if (!(max > min)) return 0;
+        double q = std::round( (v - min) / (double(max) - min) * 65535.0 );
+        return uint16_t( std::min(65535.0, std::max(0.0, q)) );
+    }
+
+    static double dequantize(const uint16_t& q, const float& min, const float& max)
+    {
+        return double(min) + (double(max) - min) * q / 65535.0;
+    }
+};
+
+/**
+ * Records particle trajectories without stalling the simulation.
+ *
+ * record() copies the particle positions (and optionally orientations and velocities) into the next free buffer of a
+ * ring of preallocated frames and returns; a background thread encodes the frames and writes them to disk. If the
+ * ring is full, record() waits for the writer (backpressure) or, with setBlockWhenFull(false), drops the frame.
+ * Both cases are counted.
+ */
+class CTrajectoryRecorder
+{
+public:
+    typedef std::shared_ptr<CTrajectoryRecorder> Ptr;
+
+    typedef const std::shared_ptr<CTrajectoryRecorder> ConstPtr;
+
+    typedef CParticleStore<>::QuaternionVector QuaternionVector;
+
+    CTrajectoryRecorder(const std::string& filename,
+                        const size_t& ringSize=8,
+                        const uint32_t& flags=STrajectoryFormat::DELTA,
+                        const uint32_t& keyframeInterval=30):
+            m_out(filename, std::ios::binary | std::ios::trunc),
+            m_flags(flags),
+            m_keyframeInterval(std::max(keyframeInterval, 1u)),
+            m_ring(std::max(ringSize, size_t(1))),
+            m_head(0),
+            m_tail(0),
+            m_count(0),
+            m_stop(false),
+            m_blockWhenFull(true),
+            m_numRecorded(0),
+            m_numWritten(0),
+            m_numDropped(0),
+            m_numBackpressured(0),
+            m_bytesWritten(0),
+            m_writeError(false)
+    {
+        if (!m_out)
+        {
+            _GENERIC_ERROR_("Unable to open trajectory file: " + filename);
+            return;
+        }
+
+        STrajectoryFormat::SFileHeader h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.m_magic, "PBDTRAJ", 8);
+        h.m_version = STrajectoryFormat::version;
+        h.m_flags = m_flags;
+        h.m_keyframeInterval = m_keyframeInterval;
+        writeBytes(&h, sizeof(h));
+
+        m_writer = std::thread(&CTrajectoryRecorder::writerLoop, this);
+    }
+
+    ~CTrajectoryRecorder()
+    {
+        close();
+    }
+
+    CTrajectoryRecorder(const CTrajectoryRecorder&) = delete;
+
+    CTrajectoryRecorder& operator=(const CTrajectoryRecorder&) = delete;
+
+    bool isOpen() const { return m_writer.joinable(); }
+
+    /// With false, record() drops the frame instead of waiting when every buffer is waiting to be written.
+    void setBlockWhenFull(const bool& block) { m_blockWhenFull = block; }
+
+    /// Queue a copy of the particle state. Returns false if the frame was dropped or the recorder is closed.
+    /// Single precision stores are widened to double while copying.
+    template<typename T_real>
+    bool record(const PBD::CParticleStore<T_real>& particles, const uint64_t& frame, const double& time)
+    {
+        if (!isOpen()) return false;
+
+        SFrame* pSlot;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_count == m_ring.size())
+            {
+                if (!m_blockWhenFull)
+                {
+                    ++m_numDropped;
+                    return false;
+                }
+                ++m_numBackpressured;
+                m_notFull.wait(lock, [this]{ return m_count < m_ring.size(); });
+            }
+            pSlot = &m_ring[m_head];
+        }
+
+        //The slot is owned by this thread until it is published
+        pSlot->m_frame = frame;
+        pSlot->m_time = time;
+        copyAsDouble(particles.m_position, pSlot->m_positions);
+        if (m_flags & STrajectoryFormat::ORIENTATION)
+        {
+            copyAsDouble(particles.m_orientation, pSlot->m_orientations);
+        }
+        if (m_flags & STrajectoryFormat::VELOCITY)
+        {
+            copyAsDouble(particles.m_velocity, pSlot->m_velocities);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_head = (m_head + 1) % m_ring.size();
+            ++m_count;
+        }
+        m_notEmpty.notify_one();
+        ++m_numRecorded;
+        return true;
+    }
+
+    /// Write the queued frames and the frame index, and close the file.
+    void close()
+    {
+        if (!isOpen()) return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_notEmpty.notify_one();
+        m_writer.join();
+
+        STrajectoryFormat::STrailer trailer;
+        trailer.m_indexOffset = m_bytesWritten;
+        trailer.m_numFrames = m_frameOffsets.size();
+        std::memcpy(trailer.m_magic, "PBDTIDX", 8);
+        writeBytes(m_frameOffsets.data(), m_frameOffsets.size() * sizeof(uint64_t));
+        writeBytes(&trailer, sizeof(trailer));
+        m_out.close();
+        if (m_writeError) _GENERIC_ERROR_("Error writing the trajectory file");
+    }
+
+    uint64_t getNumRecorded() const { return m_numRecorded; }
+
+    uint64_t getNumWritten() const { return m_numWritten; }
+
+    /// Frames lost because the ring was full (only with setBlockWhenFull(false)).
+    uint64_t getNumDropped() const { return m_numDropped; }
+
+    /// Calls to record() that had to wait for the writer.
+    uint64_t getNumBackpressured() const { return m_numBackpressured; }
+
+protected:
+    template<typename T_in, typename T_out>
+    static void copyAsDouble(const T_in& in, T_out& out)
+    {
+        if constexpr (std::is_same<T_in, T_out>::value)
+        {
+            out.assign(in.begin(), in.end());
+        }
+        else
+        {
+            out.resize(in.size());
+            for (size_t i=0; i<in.size(); ++i) out[i] = in[i].template cast<double>();
+        }
+    }
+
+    struct SFrame
+    {
+        uint64_t m_frame;
+        double m_time;
+        std::vector<Eigen::Vector3d> m_positions;
+        QuaternionVector m_orientations;
+        std::vector<Eigen::Vector3d> m_velocities;
+    };
+
+    void writerLoop()
+    {
+        while (true)
+        {
+            SFrame* pSlot;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_notEmpty.wait(lock, [this]{ return m_count > 0 || m_stop; });
+                if (m_count == 0) return;
+                pSlot = &m_ring[m_tail];
+            }
+
+            writeFrame(*pSlot);
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tail = (m_tail + 1) % m_ring.size();
+                --m_count;
+            }
+            m_notFull.notify_one();
+            ++m_numWritten;
+        }
+    }
+
+    void writeFrame(const SFrame& f)
+    {
+        const size_t n = f.m_positions.size();
+
+        STrajectoryFormat::SFrameHeader h;
+        std::memset(&h, 0, sizeof(h));
+        h.m_frame = f.m_frame;
+        h.m_time = f.m_time;
+        h.m_numParticles = n;
+        for (int k=0; k<3; ++k)
+        {
+            h.m_min[k] = n ? std::numeric_limits<float>::max() : 0.f;
+            h.m_max[k] = n ? -std::numeric_limits<float>::max() : 0.f;
+        }
+        for (const auto& p:f.m_positions)
+        {
+            for (int k=0; k<3; ++k)
+            {
+                h.m_min[k] = std::min(h.m_min[k], std::nextafter(float(p(k)), -std::numeric_limits<float>::max()));
+                h.m_max[k] = std::max(h.m_max[k], std::nextafter(float(p(k)),  std::numeric_limits<float>::max()));
+            }
+        }
+
+        m_quantized.resize(3*n);
+        for (size_t i=0; i<n; ++i)
+        {
+            for (int k=0; k<3; ++k)
+            {
+                m_quantized[3*i+k] = STrajectoryFormat::quantize(f.m_positions[i](k), h.m_min[k], h.m_max[k]);
+            }
+        }
+
+        const bool delta = (m_flags & STrajectoryFormat::DELTA) && m_previous.size() == m_quantized.size() &&
+                           m_frameOffsets.size() % m_keyframeInterval != 0;
+        h.m_encoding = delta ? STrajectoryFormat::DELTA_FRAME : STrajectoryFormat::KEYFRAME;
+
+        m_payload.clear();
+        if (delta)
+        {
+            for (size_t i=0; i<m_quantized.size(); ++i)
+            {
+                int32_t d = int32_t(m_quantized[i]) - int32_t(m_previous[i]);
+                uint32_t z = (uint32_t(d) << 1) ^ uint32_t(d >> 31);
+                while (z >= 0x80)
+                {
+                    m_payload.push_back(char(z | 0x80));
+                    z >>= 7;
+                }
+                m_payload.push_back(char(z));
+            }
+        }
+        else
+        {
+            append(m_quantized.data(), m_quantized.size() * sizeof(uint16_t));
+        }
+        m_previous.swap(m_quantized);
+
+        if (m_flags & STrajectoryFormat::ORIENTATION)
+        {
+            std::vector<int16_t> q(4*n);
+            for (size_t i=0; i<n; ++i)
+            {
+                for (int k=0; k<4; ++k)
+                {
+                    q[4*i+k] = int16_t( std::round( std::max(-1.0, std::min(1.0, f.m_orientations[i].coeffs()(k))) * 32767.0 ) );
+                }
+            }
+            append(q.data(), q.size() * sizeof(int16_t));
+        }
+        if (m_flags & STrajectoryFormat::VELOCITY)
+        {
+            std::vector<float> v(3*n);
+            for (size_t i=0; i<n; ++i)
+            {
+                for (int k=0; k<3; ++k) v[3*i+k] = float(f.m_velocities[i](k));
+            }
+            append(v.data(), v.size() * sizeof(float));
+        }
+
+        h.m_payloadBytes = m_payload.size();
+        m_frameOffsets.push_back(m_bytesWritten);
+        writeBytes(&h, sizeof(h));
+        writeBytes(m_payload.data(), m_payload.size());
+    }
+
+    void append(const void* data, const size_t& size)
+    {
+        const char* p = static_cast<const char*>(data);
+        m_payload.insert(m_payload.end(), p, p + size);
+    }
+
+    void writeBytes(const void* data, const size_t& size)
+    {
+        m_out.write(static_cast<const char*>(data), std::streamsize(size));
+        m_bytesWritten += size;
+        m_writeError = m_writeError || !m_out;
+    }
+
+    std::ofstream m_out;
+    uint32_t m_flags;
+    uint32_t m_keyframeInterval;
+
+    //Ring of frame buffers, filled by record() and drained by the writer thread
+    std::vector<SFrame> m_ring;
+    size_t m_head;                      ///< Next slot to fill.
+    size_t m_tail;                      ///< Next slot to write.
+    size_t m_count;                     ///< Slots waiting to be written.
+    bool m_stop;
+    bool m_blockWhenFull;
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::thread m_writer;
+
+    std::atomic<uint64_t> m_numRecorded;
+    std::atomic<uint64_t> m_numWritten;
+    std::atomic<uint64_t> m_numDropped;
+    std::atomic<uint64_t> m_numBackpressured;
+
+    //Writer thread state
+    uint64_t m_bytesWritten;
+    bool m_writeError;
+    std::vector<uint64_t> m_frameOffsets;
+    std::vector<uint16_t> m_quantized;
+    std::vector<uint16_t> m_previous;   ///< Quantized positions of the last written frame (delta reference).
+    std::vector<char> m_payload;
+};
+
+/**
+ * Random access reader of the trajectory files written by CTrajectoryRecorder. Delta frames are decoded from the
+ * preceding keyframe, or from the last decoded frame when reading forward.
+ */
+class CTrajectoryReader
+{
+public:
+    typedef CParticleStore<>::QuaternionVector QuaternionVector;
+
+    explicit CTrajectoryReader(const std::string& filename): m_file(filename), m_flags(0), m_valid(false), m_lastFrame(size_t(-1))
+    {
+        STrajectoryFormat::SFileHeader h;
+        if (!m_file.isOpen() || m_file.size() < sizeof(h)) return;
+        std::memcpy(&h, m_file.data(), sizeof(h));
+        if (std::memcmp(h.m_magic, "PBDTRAJ", 8) != 0 || h.m_version != STrajectoryFormat::version) return;
+        m_flags = h.m_flags;
+        m_valid = true;
+
+        //Frame index from the trailer, or rebuilt by scanning the records
+        STrajectoryFormat::STrailer t;
+        bool indexed = false;
+        if (m_file.size() >= sizeof(h) + sizeof(t))
+        {
+            std::memcpy(&t, m_file.data() + m_file.size() - sizeof(t), sizeof(t));
+            indexed = std::memcmp(t.m_magic, "PBDTIDX", 8) == 0 &&
+                      t.m_indexOffset + t.m_numFrames * sizeof(uint64_t) + sizeof(t) == m_file.size();
+        }
+        if (indexed)
+        {
+            m_frameOffsets.resize(t.m_numFrames);
+            std::memcpy(m_frameOffsets.data(), m_file.data() + t.m_indexOffset, t.m_numFrames * sizeof(uint64_t));
+        }
+        else
+        {
+            uint64_t offset = sizeof(h);
+            STrajectoryFormat::SFrameHeader fh;
+            while (offset + sizeof(fh) <= m_file.size())
+            {
+                std::memcpy(&fh, m_file.data() + offset, sizeof(fh));
+                if (offset + sizeof(fh) + fh.m_payloadBytes > m_file.size()) break;
+                m_frameOffsets.push_back(offset);
+                offset += sizeof(fh) + fh.m_payloadBytes;
+            }
+        }
+    }
+
+    bool isValid() const { return m_valid; }
+
+    size_t getNumFrames() const { return m_frameOffsets.size(); }
+
+    uint32_t getFlags() const { return m_flags; }
+
+    STrajectoryFormat::SFrameHeader getFrameHeader(const size_t& i) const
+    {
+        STrajectoryFormat::SFrameHeader h;
+        std::memcpy(&h, m_file.data() + m_frameOffsets[i], sizeof(h));
+        return h;
+    }
+
+    /// Decode frame i. Orientations and velocities are only filled if they were recorded and a container is given.
+    bool readFrame(const size_t& i, std::vector<Eigen::Vector3d>& positions,
+                   QuaternionVector* pOrientations=nullptr, std::vector<Eigen::Vector3d>* pVelocities=nullptr)
+    {
+        if (i >= m_frameOffsets.size()) return false;
+
+        //Start from the last keyframe at or before i, unless the last decoded frame is closer
+        size_t first = i;
+        while (getFrameHeader(first).m_encoding != STrajectoryFormat::KEYFRAME && first > 0 && first != m_lastFrame + 1)
+        {
+            --first;
+        }
+        if (getFrameHeader(first).m_encoding != STrajectoryFormat::KEYFRAME && first != m_lastFrame + 1) return false;
+
+        for (size_t f=first; f<=i; ++f)
+        {
+            decodePositions(f);
+        }
+
+        const STrajectoryFormat::SFrameHeader h = getFrameHeader(i);
+        const size_t n = h.m_numParticles;
+        positions.resize(n);
+        for (size_t p=0; p<n; ++p)
+        {
+            for (int k=0; k<3; ++k)
+            {
+                positions[p](k) = STrajectoryFormat::dequantize(m_quantized[3*p+k], h.m_min[k], h.m_max[k]);
+            }
+        }
+
+        const char* extra = m_file.data() + m_frameOffsets[i] + sizeof(h) + m_positionBytes;
+        if (m_flags & STrajectoryFormat::ORIENTATION)
+        {
+            if (pOrientations)
+            {
+                pOrientations->resize(n);
+                for (size_t p=0; p<n; ++p)
+                {
+                    int16_t q[4];
+                    std::memcpy(q, extra + 8*p, sizeof(q));
+                    (*pOrientations)[p] = Eigen::Quaterniond(q[3] / 32767.0, q[0] / 32767.0, q[1] / 32767.0, q[2] / 32767.0).normalized();
+                }
+            }
+            extra += 8*n;
+        }
+        if ((m_flags & STrajectoryFormat::VELOCITY) && pVelocities)
+        {
+            pVelocities->resize(n);
+            for (size_t p=0; p<n; ++p)
+            {
+                float v[3];
+                std::memcpy(v, extra + 12*p, sizeof(v));
+                (*pVelocities)[p] = Eigen::Vector3d(v[0], v[1], v[2]);
+            }
+        }
+        return true;
+    }
+
+protected:
+    /// Update m_quantized to the positions of frame f, which is a keyframe or follows the last decoded frame.
+    void decodePositions(const size_t& f)
+    {
+        const STrajectoryFormat::SFrameHeader h = getFrameHeader(f);
+        const char* p = m_file.data() + m_frameOffsets[f] + sizeof(h);
+        const size_t count = 3 * h.m_numParticles;
+
+        if (h.m_encoding == STrajectoryFormat::KEYFRAME)
+        {
+            m_quantized.resize(count);
+            std::memcpy(m_quantized.data(), p, count * sizeof(uint16_t));
+            m_positionBytes = count * sizeof(uint16_t);
+        }
+        else
+        {
+            const char* begin = p;
+            for (size_t j=0; j<count; ++j)
+            {
+                uint32_t z = 0;
+                int shift = 0;
+                uint8_t byte;
+                do
+                {
+                    byte = uint8_t(*p++);
+                    z |= uint32_t(byte & 0x7f) << shift;
+                    shift += 7;
+                } while (byte & 0x80);
+                int32_t d = int32_t(z >> 1) ^ -int32_t(z & 1);
+                m_quantized[j] = uint16_t(int32_t(m_quantized[j]) + d);
+            }
+            m_positionBytes = size_t(p - begin);
+        }
+        m_lastFrame = f;
+    }
+
+    PBD::CMappedFile m_file;
+    uint32_t m_flags;
+    bool m_valid;
+    std::vector<uint64_t> m_frameOffsets;
+    std::vector<uint16_t> m_quantized;      ///< Quantized positions of m_lastFrame.
+    size_t m_lastFrame;
+    size_t m_positionBytes = 0;             ///< Size of the position block of m_lastFrame.
+};
+
+}
+
+#endif //PBD_CTRAJECTORYRECORDER_H
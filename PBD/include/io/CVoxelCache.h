@@ -0,0 +1,253 @@
+#ifndef PBD_CVOXELCACHE_H
+#define PBD_CVOXELCACHE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+#include <Eigen/Dense>
+#include <io/CMappedFile.h>
+
+namespace PBD
+{
+
+/**
+ * On-disk cache of a voxelized point cloud object.
+ *
+ * The key hashes the content of the source file together with the scale, the particle size and an optional layout
+ * key, so an entry is only found while all of them are unchanged. An entry is a small header followed by the particle
+ * centers relative to the object position and, optionally, the shape-matching rest configuration, all as doubles, so
+ * load() maps the file and reads it in place. Entries are written next to the source file ("<source>.<key>.pbdvox")
+ * or into setDirectory(). Stale entries are never read but are not deleted either.
+ */
+class CVoxelCache
+{
+public:
+    typedef std::shared_ptr<CVoxelCache> Ptr;
+
+    typedef const std::shared_ptr<CVoxelCache> ConstPtr;
+
+    const static uint32_t version = 1;
+
+    CVoxelCache(const std::string& sourceFile, const double& scale, const double& partSize, const uint64_t& layoutKey=0):
+            m_key(0),
+            m_numParticles(0),
+            m_centers(nullptr),
+            m_hasRestData(false)
+    {
+        m_restCoM.setZero();
+        m_restCovariance.setIdentity();
+        m_restCovMat.setIdentity();
+
+        if (!isEnabled()) return;
+        PBD::CMappedFile source(sourceFile);
+        if (!source.isOpen()) return;
+
+        m_key = hashBytes(source.data(), source.size(), version);
+        m_key = hashCombine(m_key, bitsOf(scale));
+        m_key = hashCombine(m_key, bitsOf(partSize));
+        m_key = hashCombine(m_key, layoutKey);
+
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)m_key);
+        std::string base = sourceFile;
+        if (!getDirectory().empty())
+        {
+            size_t slash = sourceFile.find_last_of('/');
+            base = getDirectory() + "/" + (slash == std::string::npos ? sourceFile : sourceFile.substr(slash + 1));
+        }
+        m_path = base + "." + hex + ".pbdvox";
+    }
+
+    ~CVoxelCache() = default;
+
+    CVoxelCache(const CVoxelCache&) = delete;
+
+    CVoxelCache& operator=(const CVoxelCache&) = delete;
+
+    /// Map the entry of the key. Returns false if there is none or it does not match the key.
+    bool load()
+    {
+        if (m_path.empty()) return false;
+        m_file.reset(new PBD::CMappedFile(m_path));
+
+        SHeader h;
+        if (!m_file->isOpen() || m_file->size() < sizeof(SHeader)) return release();
+        std::memcpy(&h, m_file->data(), sizeof(SHeader));
+        if (std::memcmp(h.m_magic, "PBDVOXC", 8) != 0 || h.m_version != version || h.m_key != m_key ||
+            m_file->size() != sizeof(SHeader) + h.m_numParticles * 3 * sizeof(double))
+        {
+            return release();
+        }
+
+        m_numParticles = h.m_numParticles;
+        m_centers = reinterpret_cast<const double*>(m_file->data() + sizeof(SHeader));
+        m_hasRestData = h.m_hasRestData != 0;
+        m_restCoM = Eigen::Map<const Eigen::Vector3d>(h.m_restCoM);
+        m_restCovariance = Eigen::Map<const Eigen::Matrix3d>(h.m_restCovariance);
+        m_restCovMat = Eigen::Map<const Eigen::Matrix3d>(h.m_restCovMat);
+        return true;
+    }
+
+    /**
+     * Write the entry of the key: numParticles centers (x, y, z doubles relative to the object position) and the
+     * rest configuration if pRestCoM is given. The file is written aside and renamed, so readers never see it partial.
+     */
+    bool store(const double* centers, const size_t& numParticles,
+               const Eigen::Vector3d* pRestCoM=nullptr,
+               const Eigen::Matrix3d* pRestCovariance=nullptr,
+               const Eigen::Matrix3d* pRestCovMat=nullptr) const
+    {
+        if (m_path.empty()) return false;
+
+        SHeader h;
+        std::memset(&h, 0, sizeof(SHeader));
+        std::memcpy(h.m_magic, "PBDVOXC", 8);
+        h.m_version = version;
+        h.m_key = m_key;
+        h.m_numParticles = numParticles;
+        h.m_hasRestData = (pRestCoM && pRestCovariance && pRestCovMat) ? 1 : 0;
+        if (h.m_hasRestData)
+        {
+            Eigen::Map<Eigen::Vector3d>(h.m_restCoM) = *pRestCoM;
+            Eigen::Map<Eigen::Matrix3d>(h.m_restCovariance) = *pRestCovariance;
+            Eigen::Map<Eigen::Matrix3d>(h.m_restCovMat) = *pRestCovMat;
+        }
+
+        const std::string tmpPath = m_path + ".tmp" + std::to_string(::getpid());
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out) return false;
+            out.write(reinterpret_cast<const char*>(&h), sizeof(SHeader));
+            out.write(reinterpret_cast<const char*>(centers), std::streamsize(numParticles * 3 * sizeof(double)));
+            if (!out)
+            {
+                out.close();
+                std::remove(tmpPath.c_str());
+                return false;
+            }
+        }
+        return std::rename(tmpPath.c_str(), m_path.c_str()) == 0;
+    }
+
+    size_t getNumParticles() const { return m_numParticles; }
+
+    /// Center of particle i relative to the object position. Valid after a successful load().
+    Eigen::Vector3d getCenter(const size_t& i) const
+    {
+        double c[3];
+        std::memcpy(c, m_centers + 3*i, sizeof(c));
+        return Eigen::Vector3d(c[0], c[1], c[2]);
+    }
+
+    bool hasRestData() const { return m_hasRestData; }
+
+    /// Rest CoM relative to the object position.
+    const Eigen::Vector3d& getRestCoM() const { return m_restCoM; }
+
+    const Eigen::Matrix3d& getRestCovariance() const { return m_restCovariance; }
+
+    const Eigen::Matrix3d& getRestCovMat() const { return m_restCovMat; }
+
+    const std::string& getPath() const { return m_path; }
+
+    uint64_t getKey() const { return m_key; }
+
+    /// Directory of the cache entries. Empty (default) stores them next to their source file.
+    static void setDirectory(const std::string& directory) { directoryRef() = directory; }
+
+    static const std::string& getDirectory() { return directoryRef(); }
+
+    static void setEnabled(const bool& enabled) { enabledRef() = enabled; }
+
+    static bool isEnabled() { return enabledRef(); }
+
+    static uint64_t hashCombine(uint64_t h, uint64_t v)
+    {
+        v *= 0x9E3779B97F4A7C15ull;
+        h ^= (v << 31) | (v >> 33);
+        h = ((h << 27) | (h >> 37)) * 0xBF58476D1CE4E5B9ull + 0x94D049BB133111EBull;
+        return h;
+    }
+
+    /// 64 bit hash of a buffer, processed in 8 byte words.
+    static uint64_t hashBytes(const char* data, const size_t& size, const uint64_t& seed=0)
+    {
+        uint64_t h = hashCombine(seed, size);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t w;
+            std::memcpy(&w, data + i, 8);
+            h = hashCombine(h, w);
+        }
+        if (i < size)
+        {
+            uint64_t tail = 0;
+            std::memcpy(&tail, data + i, size - i);
+            h = hashCombine(h, tail);
+        }
+
+        //Final avalanche
+        h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 27; h *= 0x94D049BB133111EBull;
+        h ^= h >> 31;
+        return h;
+    }
+
+protected:
+    struct SHeader
+    {
+        char     m_magic[8];
+        uint32_t m_version;
+        uint32_t m_hasRestData;
+        uint64_t m_key;
+        uint64_t m_numParticles;
+        double   m_restCoM[3];
+        double   m_restCovariance[9];
+        double   m_restCovMat[9];
+    };
+
+    static uint64_t bitsOf(const double& v)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return bits;
+    }
+
+    static std::string& directoryRef()
+    {
+        static std::string directory;
+        return directory;
+    }
+
+    static bool& enabledRef()
+    {
+        static bool enabled = true;
+        return enabled;
+    }
+
+    bool release()
+    {
+        m_file.reset();
+        return false;
+    }
+
+    std::string m_path;
+    uint64_t m_key;
+    std::unique_ptr<PBD::CMappedFile> m_file;
+    size_t m_numParticles;
+    const double* m_centers;
+    bool m_hasRestData;
+    Eigen::Vector3d m_restCoM;
+    Eigen::Matrix3d m_restCovariance;
+    Eigen::Matrix3d m_restCovMat;
+};
+
+}
+
+#endif //PBD_CVOXELCACHE_H
@@ -0,0 +1,187 @@
+#ifndef PBD_CWORLDSNAPSHOT_H
+#define PBD_CWORLDSNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+#include <io/CMappedFile.h>
+
+namespace PBD
+{
+
+/**
+ * Header of the binary world snapshots written by CWorld::saveSnapshot.
+ *
+ * The header is followed by raw arrays (sections) in the in-memory layout of the simulation, each starting on a
+ * 16 byte boundary of the file, so a mapped snapshot is restored by copying every section into its container.
+ * The header stores the offset and size in bytes of every section; missing sections have size 0. Vector and scalar
+ * particle sections are in the precision of the world (SINGLE_PRECISION flag for CWorld<float>), the shape-matching
+ * frames, rigid body states and header values are always doubles.
+ */
+struct SWorldSnapshotHeader
+{
+    const static uint32_t version = 1;
+
+    enum ESection
+    {
+        //Particles (CParticleStore arrays, one entry per particle)
+        POSITION, PRED_POSITION, VELOCITY, EXT_FORCE, MASS, MASS_INV, SIZE, GROUP,
+        ORIENTATION, PRED_ORIENTATION, ANGULAR_VELOCITY,
+        //Permanent distance constraints: particle index pairs and (target distance, tolerance, stiffness)
+        DISTANCE_PARTICLES, DISTANCE_PARAMETERS,
+        //Shape matching: particle list bounds (numConstraints+1), particle lists, rest offsets and per object frames
+        SHAPE_MATCHING_BOUNDS, SHAPE_MATCHING_PARTICLES, SHAPE_MATCHING_REST_OFFSETS, SHAPE_MATCHING_FRAMES,
+        //Rigid bodies: particle ranges, per body state and local particle positions
+        RIGID_BODY_RANGES, RIGID_BODY_STATES, RIGID_BODY_LOCAL_POSITIONS,
+        NUM_SECTIONS
+    };
+
+    /// Doubles per shape-matching object: rest CoM (3), rest covariance (9), rest frame (9), rotation (4, x y z w),
+    /// rotation extraction method and its maximum iterations.
+    const static size_t shapeMatchingFrameSize = 27;
+
+    /// Doubles per rigid body: position (3), orientation (4, x y z w), velocity (3), angular velocity (3), mass, radius.
+    const static size_t rigidBodyStateSize = 15;
+
+    enum EFlags { RIGID_BODY_FAST_PATH = 1, SLEEPING_ENABLED = 2, SINGLE_PRECISION = 4 };
+
+    char     m_magic[8];
+    uint32_t m_version;
+    uint32_t m_solverMode;
+    uint32_t m_flags;
+    uint32_t m_sleepSteps;
+    double   m_sleepEnergyThreshold;
+    double   m_jacobiRelaxation;
+    double   m_gravity[3];
+    uint64_t m_numParticles;
+    uint64_t m_numDistanceConstraints;
+    uint64_t m_numShapeMatchingConstraints;
+    uint64_t m_numRigidBodies;
+    uint64_t m_sectionOffset[NUM_SECTIONS];
+    uint64_t m_sectionSize[NUM_SECTIONS];
+};
+
+/**
+ * Writes a snapshot section by section. The file is written aside and renamed by close(), so an existing snapshot is
+ * only replaced by a complete one.
+ */
+class CWorldSnapshotWriter
+{
+public:
+    explicit CWorldSnapshotWriter(const std::string& filename):
+            m_filename(filename),
+            m_tmpFilename(filename + ".tmp" + std::to_string(::getpid())),
+            m_out(m_tmpFilename, std::ios::binary | std::ios::trunc),
+            m_offset(0)
+    {
+        std::memset(&m_header, 0, sizeof(m_header));
+        std::memcpy(m_header.m_magic, "PBDSNAP", 8);
+        m_header.m_version = SWorldSnapshotHeader::version;
+        writeBytes(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    }
+
+    ~CWorldSnapshotWriter()
+    {
+        if (m_out.is_open())
+        {
+            m_out.close();
+            std::remove(m_tmpFilename.c_str());
+        }
+    }
+
+    bool isOpen() const { return bool(m_out); }
+
+    SWorldSnapshotHeader& header() { return m_header; }
+
+    template<typename T>
+    void section(const SWorldSnapshotHeader::ESection& s, const T* data, const size_t& count)
+    {
+        static const char zeros[16] = {0};
+        writeBytes(zeros, (16 - m_offset % 16) % 16);
+        m_header.m_sectionOffset[s] = m_offset;
+        m_header.m_sectionSize[s] = count * sizeof(T);
+        writeBytes(reinterpret_cast<const char*>(data), count * sizeof(T));
+    }
+
+    /// Rewrite the header with the section table and move the file into place.
+    bool close()
+    {
+        m_out.seekp(0);
+        m_out.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+        bool ok = bool(m_out);
+        m_out.close();
+        ok = ok && std::rename(m_tmpFilename.c_str(), m_filename.c_str()) == 0;
+        if (!ok) std::remove(m_tmpFilename.c_str());
+        return ok;
+    }
+
+protected:
+    void writeBytes(const char* data, const size_t& size)
+    {
+        m_out.write(data, std::streamsize(size));
+        m_offset += size;
+    }
+
+    std::string m_filename;
+    std::string m_tmpFilename;
+    std::ofstream m_out;
+    size_t m_offset;
+    SWorldSnapshotHeader m_header;
+};
+
+/**
+ * Maps a snapshot and validates its header and section table. Sections are copied out with a single memcpy.
+ */
+class CWorldSnapshotReader
+{
+public:
+    explicit CWorldSnapshotReader(const std::string& filename): m_file(filename), m_valid(false)
+    {
+        std::memset(&m_header, 0, sizeof(m_header));
+        if (!m_file.isOpen() || m_file.size() < sizeof(m_header)) return;
+        std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+        if (std::memcmp(m_header.m_magic, "PBDSNAP", 8) != 0 || m_header.m_version != SWorldSnapshotHeader::version) return;
+
+        for (size_t s=0; s<SWorldSnapshotHeader::NUM_SECTIONS; ++s)
+        {
+            if (m_header.m_sectionOffset[s] > m_file.size() ||
+                m_header.m_sectionSize[s] > m_file.size() - m_header.m_sectionOffset[s]) return;
+        }
+        m_valid = true;
+    }
+
+    bool isValid() const { return m_valid; }
+
+    const SWorldSnapshotHeader& header() const { return m_header; }
+
+    /// Number of T elements in section s.
+    template<typename T>
+    size_t count(const SWorldSnapshotHeader::ESection& s) const
+    {
+        return m_header.m_sectionSize[s] / sizeof(T);
+    }
+
+    /// Copy section s into out. Returns false unless it holds exactly expectedCount elements of T.
+    template<typename T, typename T_allocator>
+    bool read(const SWorldSnapshotHeader::ESection& s, std::vector<T, T_allocator>& out, const size_t& expectedCount) const
+    {
+        if (m_header.m_sectionSize[s] != expectedCount * sizeof(T)) return false;
+        out.resize(expectedCount);
+        if (expectedCount > 0) std::memcpy(static_cast<void*>(out.data()), m_file.data() + m_header.m_sectionOffset[s], m_header.m_sectionSize[s]);
+        return true;
+    }
+
+protected:
+    PBD::CMappedFile m_file;
+    SWorldSnapshotHeader m_header;
+    bool m_valid;
+};
+
+}
+
+#endif //PBD_CWORLDSNAPSHOT_H
@@ -0,0 +1,146 @@
+#ifndef PBD_MESHREADER_H
+#define PBD_MESHREADER_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <io/CMappedFile.h>
+#include <io/PointCloudReader.h>
+
+namespace PBD
+{
+
+/**
+ * Read the triangles of a binary PLY mesh (binary_little_endian or binary_big_endian). The vertices are read like
+ * parseBinaryPLYHeader does, then the "face" element, which must follow them, is read as a list of vertex indices
+ * per face, polygons being split in fans. Faces may carry other fixed size properties. Returns false if the file
+ * can not be read or is not a supported mesh.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+bool readBinaryPLYMesh(const std::string& filename, std::vector<T_vector>& vertices,
+                       std::vector< std::array<uint32_t,3> >& triangles, const T_real& scale=1)
+{
+    typedef CStridedPointView<T_real,T_vector> View;
+
+    PBD::CMappedFile file(filename);
+    View view;
+    if (!file.isOpen() || !parseBinaryPLYHeader<T_real,T_vector>(file.data(), file.size(), view)) return false;
+    view.m_scale = scale;
+
+    auto scalarType = [](const std::string& name, size_t& bytes, bool& isSigned)
+    {
+        isSigned = name == "char" || name == "int8" || name == "short" || name == "int16" || name == "int" || name == "int32";
+        if      (name == "char"   || name == "int8"    || name == "uchar"  || name == "uint8")   bytes = 1;
+        else if (name == "short"  || name == "int16"   || name == "ushort" || name == "uint16")  bytes = 2;
+        else if (name == "int"    || name == "int32"   || name == "uint"   || name == "uint32" ||
+                 name == "float"  || name == "float32") bytes = 4;
+        else if (name == "double" || name == "float64") bytes = 8;
+        else return false;
+        return true;
+    };
+
+    //Layout of the faces: the element following the vertices
+    const std::string endHeader = "end_header";
+    const char* headerEnd = std::search(file.data(), file.data() + file.size(), endHeader.begin(), endHeader.end());
+    std::istringstream header(std::string(file.data(), headerEnd));
+    std::string line;
+    bool afterVertex = false;
+    bool inFace = false;
+    size_t numFaces = 0;
+    size_t bytesBefore = 0, bytesAfter = 0;     //Fixed size properties around the index list
+    size_t countBytes = 0, indexBytes = 0;
+    bool indexSigned = false;
+    while (std::getline(header, line))
+    {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "element")
+        {
+            std::string name;
+            tokens >> name;
+            if (inFace) break;
+            if (afterVertex && name != "face") return false;
+            if (name == "face")
+            {
+                if (!afterVertex) return false;
+                tokens >> numFaces;
+                inFace = true;
+            }
+            afterVertex = name == "vertex";
+        }
+        else if (keyword == "property" && inFace)
+        {
+            std::string type;
+            tokens >> type;
+            bool isSigned;
+            if (type == "list")
+            {
+                std::string count, index, name;
+                tokens >> count >> index >> name;
+                bool countSigned;
+                if (indexBytes || !scalarType(count, countBytes, countSigned) || !scalarType(index, indexBytes, indexSigned) ||
+                    index == "float" || index == "float32" || index == "double" || index == "float64" ||
+                    count == "float" || count == "float32" || count == "double" || count == "float64")
+                {
+                    return false;
+                }
+                continue;
+            }
+            size_t bytes;
+            if (!scalarType(type, bytes, isSigned)) return false;
+            (indexBytes ? bytesAfter : bytesBefore) += bytes;
+        }
+    }
+    if (!inFace || !indexBytes) return false;
+
+    const bool littleEndian = View::hostIsLittleEndian() != view.m_swapBytes;
+    auto readInteger = [littleEndian](const char* p, const size_t& bytes, const bool& isSigned) -> int64_t
+    {
+        uint64_t u = 0;
+        for (size_t k=0; k<bytes; ++k)
+        {
+            const uint64_t byte = uint8_t(p[littleEndian ? bytes-1-k : k]);
+            u = (u << 8) | byte;
+        }
+        if (isSigned && bytes < 8 && ((u >> (8*bytes - 1)) & 1)) u |= ~uint64_t(0) << (8*bytes);
+        return int64_t(u);
+    };
+
+    vertices.resize(view.size());
+    for (size_t i=0; i<view.size(); ++i) vertices[i] = view[i];
+
+    triangles.clear();
+    triangles.reserve(numFaces);
+    const char* end = file.data() + file.size();
+    const char* p = view.m_data + view.m_count * view.m_stride;
+    for (size_t f=0; f<numFaces; ++f)
+    {
+        if (size_t(end - p) < bytesBefore + countBytes) return false;
+        p += bytesBefore;
+        const int64_t count = readInteger(p, countBytes, false);
+        p += countBytes;
+        if (size_t(end - p) < size_t(count)*indexBytes + bytesAfter) return false;
+
+        int64_t first = 0, previous = 0;
+        for (int64_t k=0; k<count; ++k)
+        {
+            const int64_t index = readInteger(p + size_t(k)*indexBytes, indexBytes, indexSigned);
+            if (index < 0 || uint64_t(index) >= vertices.size()) return false;
+            if (k == 0) first = index;
+            if (k >= 2) triangles.push_back({ uint32_t(first), uint32_t(previous), uint32_t(index) });
+            previous = index;
+        }
+        p += size_t(count)*indexBytes + bytesAfter;
+    }
+    return true;
+}
+
+}
+
+#endif //PBD_MESHREADER_H
@@ -0,0 +1,334 @@
+#ifndef PBD_POINTCLOUDREADER_H
+#define PBD_POINTCLOUDREADER_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <charconv>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include <sstream>
+#include <cstdint>
+#include <Eigen/Dense>
+#include <io/CMappedFile.h>
+#include <physics/CThreadPool.h>
+
+namespace PBD
+{
+
+/**
+ * Parse the lines of an ASCII XYZ buffer that start in [begin,end) and append their first three numbers, scaled, to
+ * points. Further columns (normals, colors, ...) are skipped, as are empty lines, comments and lines that do not
+ * start with three numbers.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+void parseASCIIXYZ(const char* begin, const char* end, const T_real& scale, std::vector<T_vector>& points)
+{
+    auto isBlank = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == ','; };
+
+    const char* p = begin;
+    while (p < end)
+    {
+        const char* eol = static_cast<const char*>( std::memchr(p, '\n', size_t(end - p)) );
+        if (!eol) eol = end;
+
+        T_real xyz[3];
+        int n = 0;
+        while (n < 3)
+        {
+            while (p < eol && isBlank(*p)) ++p;
+            if (p < eol && *p == '+') ++p;
+            auto result = std::from_chars(p, eol, xyz[n]);
+            if (result.ec != std::errc()) break;
+            p = result.ptr;
+            ++n;
+        }
+        if (n == 3)
+        {
+            points.emplace_back(xyz[0] * scale, xyz[1] * scale, xyz[2] * scale);
+        }
+
+        p = eol + 1;
+    }
+}
+
+/**
+ * Memory-mapped, multithreaded ASCII XYZ reader. The file is split into one chunk per task on line boundaries and
+ * the chunks are parsed concurrently with std::from_chars, without per-line strings. Points keep the file order.
+ * Returns false if the file can not be opened. If pointsPerSecond is given it receives the parsing throughput.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+bool readASCIIXYZPointCloud(const std::string& filename,
+                            std::vector<T_vector>& points,
+                            const T_real& scale=T_real(1),
+                            double* pointsPerSecond=nullptr,
+                            size_t numThreads=0)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    const size_t initialSize = points.size();
+
+    PBD::CMappedFile file(filename);
+    if (!file.isOpen()) return false;
+
+    if (numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+    const char* data = file.data();
+    const size_t size = file.size();
+
+    //Chunk boundaries moved forward to the start of the next line. Several chunks per thread balance the load.
+    const size_t numChunks = std::max(size_t(1), std::min(numThreads * 4, size / (1 << 16)));
+    std::vector<size_t> bounds(numChunks + 1, size);
+    bounds[0] = 0;
+    for (size_t c=1; c<numChunks; ++c)
+    {
+        size_t b = std::max(bounds[c-1], size * c / numChunks);
+        while (b < size && b > 0 && data[b-1] != '\n') ++b;
+        bounds[c] = b;
+    }
+
+    std::vector< std::vector<T_vector> > chunkPoints(numChunks);
+    PBD::CThreadPool pool(std::min(numThreads, numChunks));
+    pool.parallelForDynamic(0, numChunks, [&](size_t c, size_t)
+    {
+        //About 40 bytes per line in typical scans
+        chunkPoints[c].reserve((bounds[c+1] - bounds[c]) / 32);
+        parseASCIIXYZ<T_real, T_vector>(data + bounds[c], data + bounds[c+1], scale, chunkPoints[c]);
+    });
+
+    size_t total = initialSize;
+    for (const auto& chunk:chunkPoints) total += chunk.size();
+    points.reserve(total);
+    for (const auto& chunk:chunkPoints)
+    {
+        points.insert(points.end(), chunk.begin(), chunk.end());
+    }
+
+    if (pointsPerSecond)
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        *pointsPerSecond = seconds > 0 ? (total - initialSize) / seconds : 0;
+    }
+    return true;
+}
+
+
+/**
+ * Vertex positions of a binary point cloud, read in place from a mapped file.
+ *
+ * Point i starts at m_data + i*m_stride and its x, y and z components are at m_offset[0..2] of any supported scalar
+ * type, so extra per-vertex attributes (normals, colors, ...) are skipped by the stride. Components are read with
+ * memcpy (no alignment requirement) and byte swapped only if the file endianness differs from the host.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+class CStridedPointView
+{
+public:
+    enum EScalarType { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+    CStridedPointView(): m_data(nullptr), m_count(0), m_stride(3*sizeof(float)), m_swapBytes(false), m_scale(1)
+    {
+        for (size_t k=0; k<3; ++k)
+        {
+            m_offset[k] = k*sizeof(float);
+            m_type[k] = FLOAT32;
+        }
+    }
+
+    size_t size() const { return m_count; }
+
+    T_vector operator[](const size_t& i) const
+    {
+        const char* p = m_data + i*m_stride;
+        return T_vector(read(p + m_offset[0], m_type[0]) * m_scale,
+                        read(p + m_offset[1], m_type[1]) * m_scale,
+                        read(p + m_offset[2], m_type[2]) * m_scale);
+    }
+
+    static size_t scalarSize(const EScalarType& type)
+    {
+        switch (type)
+        {
+            case INT8:  case UINT8:   return 1;
+            case INT16: case UINT16:  return 2;
+            case INT32: case UINT32: case FLOAT32: return 4;
+            default: return 8;
+        }
+    }
+
+    static bool hostIsLittleEndian()
+    {
+        const uint16_t one = 1;
+        unsigned char first;
+        std::memcpy(&first, &one, 1);
+        return first == 1;
+    }
+
+    const char* m_data;         ///< First byte of the first point.
+    size_t m_count;
+    size_t m_stride;            ///< Bytes between consecutive points.
+    size_t m_offset[3];         ///< Byte offset of x, y and z inside a point.
+    EScalarType m_type[3];
+    bool m_swapBytes;
+    T_real m_scale;
+
+protected:
+    template<typename T>
+    T load(const char* p) const
+    {
+        T v;
+        if (m_swapBytes)
+        {
+            char bytes[sizeof(T)];
+            std::reverse_copy(p, p + sizeof(T), bytes);
+            std::memcpy(&v, bytes, sizeof(T));
+        }
+        else
+        {
+            std::memcpy(&v, p, sizeof(T));
+        }
+        return v;
+    }
+
+    T_real read(const char* p, const EScalarType& type) const
+    {
+        switch (type)
+        {
+            case INT8:    return T_real( load<int8_t>(p) );
+            case UINT8:   return T_real( load<uint8_t>(p) );
+            case INT16:   return T_real( load<int16_t>(p) );
+            case UINT16:  return T_real( load<uint16_t>(p) );
+            case INT32:   return T_real( load<int32_t>(p) );
+            case UINT32:  return T_real( load<uint32_t>(p) );
+            case FLOAT32: return T_real( load<float>(p) );
+            default:      return T_real( load<double>(p) );
+        }
+    }
+};
+
+/**
+ * Fill view with the vertex positions of a binary PLY file (binary_little_endian or binary_big_endian) mapped at
+ * [data, data+size). The elements before "vertex" must have a fixed size. Returns false for ASCII or unsupported files.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+bool parseBinaryPLYHeader(const char* data, const size_t& size, CStridedPointView<T_real,T_vector>& view)
+{
+    typedef CStridedPointView<T_real,T_vector> View;
+
+    const std::string endHeader = "end_header";
+    const char* headerEnd = std::search(data, data + size, endHeader.begin(), endHeader.end());
+    if (size < 4 || std::string(data, 3) != "ply" || headerEnd == data + size) return false;
+    const char* body = static_cast<const char*>( std::memchr(headerEnd, '\n', size_t(data + size - headerEnd)) );
+    if (!body) return false;
+    ++body;
+
+    auto scalarType = [](const std::string& name, typename View::EScalarType& type)
+    {
+        if      (name == "char"   || name == "int8")    type = View::INT8;
+        else if (name == "uchar"  || name == "uint8")   type = View::UINT8;
+        else if (name == "short"  || name == "int16")   type = View::INT16;
+        else if (name == "ushort" || name == "uint16")  type = View::UINT16;
+        else if (name == "int"    || name == "int32")   type = View::INT32;
+        else if (name == "uint"   || name == "uint32")  type = View::UINT32;
+        else if (name == "float"  || name == "float32") type = View::FLOAT32;
+        else if (name == "double" || name == "float64") type = View::FLOAT64;
+        else return false;
+        return true;
+    };
+
+    std::istringstream header(std::string(data, headerEnd));
+    std::string line;
+    bool littleEndian = true;
+    bool inVertex = false;
+    bool vertexFound = false;
+    bool fixedSize = true;
+    size_t skippedBytes = 0;           //Size of the elements stored before the vertices
+    size_t elementCount = 0;
+    size_t elementStride = 0;
+    int found = 0;
+    while (std::getline(header, line))
+    {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "format")
+        {
+            std::string format;
+            tokens >> format;
+            if (format == "binary_little_endian") littleEndian = true;
+            else if (format == "binary_big_endian") littleEndian = false;
+            else return false;
+        }
+        else if (keyword == "element")
+        {
+            if (inVertex) break;
+            if (!fixedSize) return false;
+            skippedBytes += elementCount * elementStride;
+
+            std::string name;
+            tokens >> name >> elementCount;
+            elementStride = 0;
+            inVertex = (name == "vertex");
+            vertexFound = vertexFound || inVertex;
+        }
+        else if (keyword == "property")
+        {
+            std::string type, name;
+            tokens >> type;
+            if (type == "list")
+            {
+                fixedSize = false;
+                if (inVertex) return false;
+                continue;
+            }
+            tokens >> name;
+
+            typename View::EScalarType scalar;
+            if (!scalarType(type, scalar)) return false;
+            if (inVertex)
+            {
+                int k = name == "x" ? 0 : name == "y" ? 1 : name == "z" ? 2 : -1;
+                if (k >= 0)
+                {
+                    view.m_offset[k] = elementStride;
+                    view.m_type[k] = scalar;
+                    found |= 1 << k;
+                }
+            }
+            elementStride += View::scalarSize(scalar);
+        }
+    }
+    if (!vertexFound || found != 7) return false;
+
+    view.m_data = body + skippedBytes;
+    view.m_stride = elementStride;
+    view.m_count = elementCount;
+    view.m_swapBytes = littleEndian != View::hostIsLittleEndian();
+    return size_t(data + size - view.m_data) >= view.m_count * view.m_stride;
+}
+
+/**
+ * Fill view with the positions of a raw float32 dump mapped at [data, data+size): an optional header of headerBytes,
+ * then one record of stride bytes per point with x, y and z stored consecutively at xOffset.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+bool parseRawFloat32Layout(const char* data, const size_t& size, CStridedPointView<T_real,T_vector>& view,
+                           const size_t& stride=3*sizeof(float), const size_t& xOffset=0, const size_t& headerBytes=0)
+{
+    typedef CStridedPointView<T_real,T_vector> View;
+    if (stride < xOffset + 3*sizeof(float) || size < headerBytes) return false;
+
+    view.m_data = data + headerBytes;
+    view.m_stride = stride;
+    view.m_count = (size - headerBytes) / stride;
+    for (size_t k=0; k<3; ++k)
+    {
+        view.m_offset[k] = xOffset + k*sizeof(float);
+        view.m_type[k] = View::FLOAT32;
+    }
+    view.m_swapBytes = false;
+    return true;
+}
+
+}
+
+#endif //PBD_POINTCLOUDREADER_H
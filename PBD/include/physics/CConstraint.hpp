@@ -6,6 +6,8 @@
 #include <vector>
 #include <CVector3.hpp>
 #include <physics/CParticle.hpp>
+#include <physics/CParticleStore.h>
+#include <physics/RotationExtraction.h>
 #include <Eigen/Dense>
 #include <Common.h>
 
@@ -26,20 +28,25 @@ public:
 
     virtual ~CConstraint() = default;
 
-    CConstraint(const CConstraint& C): m_particles(C.m_particles)
+    explicit CConstraint(PBD::CParticleStore<T_real>* pStore): m_pStore(pStore)
     {}
 
-    CConstraint(CConstraint&& C)noexcept : m_particles(std::move(C.m_particles))
+    CConstraint(const CConstraint& C): m_pStore(C.m_pStore), m_particles(C.m_particles)
+    {}
+
+    CConstraint(CConstraint&& C)noexcept : m_pStore(C.m_pStore), m_particles(std::move(C.m_particles))
     {}
 
     CConstraint & operator= (const CConstraint& C)
     {
+        m_pStore = C.m_pStore;
         m_particles = C.m_particles;
         return *this;
     }
 
     CConstraint & operator= (CConstraint&& C) noexcept
     {
+        m_pStore = C.m_pStore;
         m_particles = std::move(C.m_particles);
         return *this;
     }
@@ -50,152 +57,277 @@ public:
 
     virtual bool project()=0;// { return true; };
 
-    std::vector< PBD::CParticle<>* > m_particles;
+    /// Write the position correction of each constrained particle (one per m_particles entry) to corrections
+    /// without modifying the particles. Returns true if the constraint is already satisfied.
+    virtual bool computeCorrections(Eigen::Matrix<T_real,3,1>* corrections)=0;
+
+    /// Violation of the constraint by the predicted positions (0 if satisfied), in length units.
+    virtual T_real getPredError()=0;
+
+    PBD::CParticleStore<T_real>* m_pStore;       ///< Store holding the constrained particles.
+    std::vector< size_t > m_particles;      ///< Indices of the constrained particles in m_pStore.
     T_real m_epsilon;
 
 };
 
 
-    template<typename T_real=double, typename T_vector=Eigen::Vector3d>
-    class CNoPenetrationConstraint: public CConstraint<T_real>
+    /**
+     * Contact between two particles: their spheres (diameter m_size) must not overlap.
+     *
+     * Two-particle constraints are plain structs with inline particle indices, kept by value in the arrays of a
+     * CConstraintStore. Their kernels are not virtual: the solvers loop over each array with the kernels of its type.
+     */
+    template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+    struct SNoPenetrationConstraint
     {
-    public:
-        typedef std::shared_ptr< CNoPenetrationConstraint > Ptr;
+        static const size_t numParticles = 2;
 
-        typedef const std::shared_ptr< CNoPenetrationConstraint > ConstPtr;
+        SNoPenetrationConstraint(const size_t& p1, const size_t& p2): m_particles{p1, p2}, m_correction(0), m_warmStart(0)
+        {}
 
+        bool isSatisfied(const PBD::CParticleStore<T_real>& s) const
+        {
+            const size_t& i0 = m_particles[0];
+            const size_t& i1 = m_particles[1];
+            return (s.m_position[i0] - s.m_position[i1]).norm() > (s.m_size[i0] + s.m_size[i1]) * T_real(0.5);
+        }
 
-        CNoPenetrationConstraint(PBD::CParticle<>* p1, PBD::CParticle<>* p2)
+        bool isPredSatisfied(const PBD::CParticleStore<T_real>& s) const
         {
-            CConstraint<T_real>::m_particles.push_back(p1);
-            CConstraint<T_real>::m_particles.push_back(p2);
-            CConstraint<T_real>::m_epsilon = PBD::constraintEpsilon;
+            const size_t& i0 = m_particles[0];
+            const size_t& i1 = m_particles[1];
+            return (s.m_predPosition[i0] - s.m_predPosition[i1]).norm() > (s.m_size[i0] + s.m_size[i1]) * T_real(0.5);
         }
 
-        bool isSatisfied()
+        /// Separate the particles. A warm started contact may also move them back together, at most by its warm
+        /// start separation, so a warm start never leaves the pair further apart than needed.
+        bool project(PBD::CParticleStore<T_real>& s)
         {
-            //if (CConstraint<T_real>::m_particles.size()!=2) return true;
-            return (CConstraint<T_real>::m_particles[0]->m_position -
-                    CConstraint<T_real>::m_particles[1]->m_position).norm() >
-                   (CConstraint<T_real>::m_particles[0]->m_size + CConstraint<T_real>::m_particles[1]->m_size) * 0.5;
+            const size_t& i0 = m_particles[0];
+            const size_t& i1 = m_particles[1];
+            const T_real epsilon = PBD::constraintEpsilon;
+
+            T_vector posAdjustmentDir = s.m_predPosition[i0] - s.m_predPosition[i1];
+
+            T_real err = posAdjustmentDir.norm() - (s.m_size[i0] + s.m_size[i1])*T_real(0.5);
+
+            if (err < epsilon)
+            {
+                err -= epsilon;
+                m_correction -= err;
+
+                posAdjustmentDir.normalize();
+                applyCorrection(s, posAdjustmentDir, err);
+            }
+            else if (m_warmStart > 0)
+            {
+                err = std::min(err - epsilon, m_warmStart);
+                m_warmStart -= err;
+                m_correction -= err;
+
+                posAdjustmentDir.normalize();
+                applyCorrection(s, posAdjustmentDir, err);
+            }
+
+            //TODO: Apply friction
+            //TODO: Apply restitution
+
+            return isPredSatisfied(s);
         }
 
-        bool isPredSatisfied()
+        /// Push the particles apart by separation along their current direction and start the accumulated
+        /// correction from it.
+        void warmStart(PBD::CParticleStore<T_real>& s, const T_real& separation)
         {
-            //if (CConstraint<T_real>::m_particles.size()!=2) return true;
-            return (CConstraint<T_real>::m_particles[0]->m_predPosition -
-                    CConstraint<T_real>::m_particles[1]->m_predPosition).norm() >
-                   (CConstraint<T_real>::m_particles[0]->m_size + CConstraint<T_real>::m_particles[1]->m_size) * 0.5;
+            T_vector posAdjustmentDir = s.m_predPosition[m_particles[0]] - s.m_predPosition[m_particles[1]];
+            posAdjustmentDir.normalize();
+            applyCorrection(s, posAdjustmentDir, -separation);
+            m_correction = separation;
+            m_warmStart = separation;
         }
 
-        bool project()
+        /// Write the position correction of each particle to corrections without modifying the particles. Returns
+        /// true if the constraint is already satisfied.
+        bool computeCorrections(const PBD::CParticleStore<T_real>& s, T_vector* corrections) const
         {
-            T_vector posAdjustmentDir =
-                    CConstraint<T_real>::m_particles[0]->m_predPosition -
-                    CConstraint<T_real>::m_particles[1]->m_predPosition;
+            const size_t& i0 = m_particles[0];
+            const size_t& i1 = m_particles[1];
+            const T_real epsilon = PBD::constraintEpsilon;
+
+            T_vector posAdjustmentDir = s.m_predPosition[i0] - s.m_predPosition[i1];
 
-            T_real err = posAdjustmentDir.norm() -
-                    (CConstraint<T_real>::m_particles[0]->m_size + CConstraint<T_real>::m_particles[1]->m_size)*0.5;
+            T_real err = posAdjustmentDir.norm() - (s.m_size[i0] + s.m_size[i1])*T_real(0.5);
+            bool satisfied = err > 0;
 
-            if (err < CConstraint<T_real>::m_epsilon)
+            corrections[0].setZero();
+            corrections[1].setZero();
+            if (err < epsilon)
             {
-                err -= CConstraint<T_real>::m_epsilon;
+                err -= epsilon;
 
                 posAdjustmentDir.normalize();
-                if (CConstraint<T_real>::m_particles[0]->getMass()>0 && CConstraint<T_real>::m_particles[1]->getMass()>0)
+                if (s.m_mass[i0]>0 && s.m_mass[i1]>0)
                 {
-                    CConstraint<T_real>::m_particles[0]->m_predPosition -= posAdjustmentDir * err * 0.5;
-                    CConstraint<T_real>::m_particles[1]->m_predPosition += posAdjustmentDir * err * 0.5;
+                    corrections[0] = -posAdjustmentDir * err * T_real(0.5);
+                    corrections[1] =  posAdjustmentDir * err * T_real(0.5);
                 }
-                else if (CConstraint<T_real>::m_particles[0]->getMass()>0)
-                    CConstraint<T_real>::m_particles[0]->m_predPosition -= posAdjustmentDir * err * 1.0;
-                else if (CConstraint<T_real>::m_particles[1]->getMass()>0)
-                    CConstraint<T_real>::m_particles[1]->m_predPosition += posAdjustmentDir * err * 1.0;
+                else if (s.m_mass[i0]>0)
+                    corrections[0] = -posAdjustmentDir * err * T_real(1);
+                else if (s.m_mass[i1]>0)
+                    corrections[1] =  posAdjustmentDir * err * T_real(1);
             }
 
-            //TODO: Apply friction
-            //TODO: Apply restitution
+            return satisfied;
+        }
 
-            return isPredSatisfied();
+        /// Violation of the constraint by the predicted positions (0 if satisfied), in length units.
+        T_real getPredError(const PBD::CParticleStore<T_real>& s) const
+        {
+            const size_t& i0 = m_particles[0];
+            const size_t& i1 = m_particles[1];
+            T_real err = (s.m_size[i0] + s.m_size[i1])*T_real(0.5) - (s.m_predPosition[i0] - s.m_predPosition[i1]).norm();
+            return std::max(err, T_real(0));
         }
 
+        /// Move the dynamic particles by err along the normalized direction from particle 1 to particle 0 (a
+        /// negative err separates them). Split evenly if both are dynamic.
+        void applyCorrection(PBD::CParticleStore<T_real>& s, const T_vector& posAdjustmentDir, const T_real& err) const
+        {
+            const size_t& i0 = m_particles[0];
+            const size_t& i1 = m_particles[1];
+            if (s.m_mass[i0]>0 && s.m_mass[i1]>0)
+            {
+                s.m_predPosition[i0] -= posAdjustmentDir * err * T_real(0.5);
+                s.m_predPosition[i1] += posAdjustmentDir * err * T_real(0.5);
+            }
+            else if (s.m_mass[i0]>0)
+                s.m_predPosition[i0] -= posAdjustmentDir * err * T_real(1);
+            else if (s.m_mass[i1]>0)
+                s.m_predPosition[i1] += posAdjustmentDir * err * T_real(1);
+        }
+
+        size_t m_particles[numParticles];       ///< Indices of the constrained particles in the store.
+        T_real m_correction;                    ///< Separation applied by the projections of this step (warm start included).
+        T_real m_warmStart;                     ///< Part of the warm start separation that can still be given back.
     };
 
 
-    template<typename T_real=double, typename T_vector=Eigen::Vector3d>
-    class CConstantDistanceConstraint: public CConstraint<T_real>
+    /// Keeps two particles at the distance they had when the constraint was created, within a tolerance.
+    template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+    struct SDistanceConstraint
     {
-    public:
-        typedef std::shared_ptr< CConstantDistanceConstraint > Ptr;
+        static const size_t numParticles = 2;
 
-        typedef const std::shared_ptr< CConstantDistanceConstraint > ConstPtr;
-
-
-        CConstantDistanceConstraint(PBD::CParticle<>* p1, PBD::CParticle<>* p2)
+        SDistanceConstraint(const PBD::CParticleStore<T_real>& s, const size_t& p1, const size_t& p2): m_particles{p1, p2}
         {
-            CConstraint<T_real>::m_particles.push_back(p1);
-            CConstraint<T_real>::m_particles.push_back(p2);
-            m_targetDistance2 = (p1->m_position - p2->m_position).squaredNorm();
+            m_targetDistance2 = (s.m_position[p1] - s.m_position[p2]).squaredNorm();
             m_targetDistance = std::sqrt(m_targetDistance2);
-            m_targetDistanceTolerance = 0.01;
-            m_targetDistanceTolerance2 = m_targetDistanceTolerance * m_targetDistanceTolerance;
-            CConstraint<T_real>::m_epsilon = PBD::constraintEpsilon;
-            m_damping = 0.99;
+            setDistanceTolerance(0.01);
+            m_stiffness = 0.99;
         }
 
-        bool isSatisfied()
+        /// True if the distance is within the tolerance band, the band in which project() leaves the particles.
+        bool isSatisfied(const PBD::CParticleStore<T_real>& s) const
         {
-            T_real err = (CConstraint<T_real>::m_particles[0]->m_position -
-                          CConstraint<T_real>::m_particles[1]->m_position).squaredNorm() - m_targetDistance2;
+            const T_real distance = (s.m_position[m_particles[0]] - s.m_position[m_particles[1]]).norm();
 
-            return -m_targetDistanceTolerance2 < err && err < m_targetDistanceTolerance2;
+            return std::abs(distance - m_targetDistance) <= m_distanceTolerance;
         }
 
-        bool isPredSatisfied()
+        bool isPredSatisfied(const PBD::CParticleStore<T_real>& s) const
         {
-            T_real err = (CConstraint<T_real>::m_particles[0]->m_predPosition -
-                          CConstraint<T_real>::m_particles[1]->m_predPosition).squaredNorm() - m_targetDistance2;
+            const T_real distance = (s.m_predPosition[m_particles[0]] - s.m_predPosition[m_particles[1]]).norm();
 
-            return m_targetDistanceTolerance2 < err && err < m_targetDistanceTolerance2;
+            return std::abs(distance - m_targetDistance) <= m_distanceTolerance;
         }
 
-        bool project()
+        bool project(PBD::CParticleStore<T_real>& s) const
         {
-            T_vector posAdjustmentDir =
-                    CConstraint<T_real>::m_particles[0]->m_predPosition -
-                    CConstraint<T_real>::m_particles[1]->m_predPosition;
+            const size_t& i0 = m_particles[0];
+            const size_t& i1 = m_particles[1];
 
-            T_real err = posAdjustmentDir.norm() - m_targetDistance;
-            if (err > m_targetDistanceTolerance && !std::isinf(err) && !std::isnan(err))
+            T_vector posAdjustmentDir = s.m_predPosition[i0] - s.m_predPosition[i1];
+
+            T_real err;
+            if (!computeError(posAdjustmentDir.norm(), err))
             {
-                err = err  - m_targetDistanceTolerance + CConstraint<T_real>::m_epsilon;
+                //return isPredSatisfied(s);
+                return true;
             }
-            else if (err < -m_targetDistanceTolerance && !std::isinf(err) && !std::isnan(err))
+
+            posAdjustmentDir.normalize();
+            if (s.m_mass[i0]>0 && s.m_mass[i1]>0)
             {
-                err = err + m_targetDistanceTolerance - CConstraint<T_real>::m_epsilon;
+                s.m_predPosition[i0] -= posAdjustmentDir * err * T_real(0.5) * m_stiffness;
+                s.m_predPosition[i1] += posAdjustmentDir * err * T_real(0.5) * m_stiffness;
             }
-            else
+            else if (s.m_mass[i0]>0)
+                s.m_predPosition[i0] -= posAdjustmentDir * err * T_real(1) * m_stiffness;
+            else if (s.m_mass[i1]>0)
+                s.m_predPosition[i1] += posAdjustmentDir * err * T_real(1) * m_stiffness;
+
+            //return true;
+            return isPredSatisfied(s);
+        }
+
+        /// Write the position correction of each particle to corrections without modifying the particles. Returns
+        /// true if the constraint is already satisfied.
+        bool computeCorrections(const PBD::CParticleStore<T_real>& s, T_vector* corrections) const
+        {
+            const size_t& i0 = m_particles[0];
+            const size_t& i1 = m_particles[1];
+
+            corrections[0].setZero();
+            corrections[1].setZero();
+
+            T_vector posAdjustmentDir = s.m_predPosition[i0] - s.m_predPosition[i1];
+
+            T_real err;
+            if (!computeError(posAdjustmentDir.norm(), err))
             {
-                //return isPredSatisfied();
                 return true;
             }
 
             posAdjustmentDir.normalize();
-            T_real posAdjustmentDirX = posAdjustmentDir(0);
-            T_real posAdjustmentDirY = posAdjustmentDir(1);
-            T_real posAdjustmentDirZ = posAdjustmentDir(2);
-            if (CConstraint<T_real>::m_particles[0]->getMass()>0 && CConstraint<T_real>::m_particles[1]->getMass()>0)
+            if (s.m_mass[i0]>0 && s.m_mass[i1]>0)
             {
-                CConstraint<T_real>::m_particles[0]->m_predPosition -= posAdjustmentDir * err * 0.5 * m_damping;
-                CConstraint<T_real>::m_particles[1]->m_predPosition += posAdjustmentDir * err * 0.5 * m_damping;
+                corrections[0] = -posAdjustmentDir * err * T_real(0.5) * m_stiffness;
+                corrections[1] =  posAdjustmentDir * err * T_real(0.5) * m_stiffness;
             }
-            else if (CConstraint<T_real>::m_particles[0]->getMass()>0)
-                CConstraint<T_real>::m_particles[0]->m_predPosition -= posAdjustmentDir * err * 1.0 * m_damping;
-            else if (CConstraint<T_real>::m_particles[1]->getMass()>0)
-                CConstraint<T_real>::m_particles[1]->m_predPosition += posAdjustmentDir * err * 1.0 * m_damping;
+            else if (s.m_mass[i0]>0)
+                corrections[0] = -posAdjustmentDir * err * T_real(1) * m_stiffness;
+            else if (s.m_mass[i1]>0)
+                corrections[1] =  posAdjustmentDir * err * T_real(1) * m_stiffness;
 
-            //return true;
-            return isPredSatisfied();
+            return false;
+        }
+
+        /// Violation of the constraint by the predicted positions (0 if satisfied), in length units.
+        T_real getPredError(const PBD::CParticleStore<T_real>& s) const
+        {
+            T_real err = std::fabs( (s.m_predPosition[m_particles[0]] - s.m_predPosition[m_particles[1]]).norm() - m_targetDistance );
+            return std::max(err - m_distanceTolerance, T_real(0));
+        }
+
+        /// Signed correction for a particle distance outside the tolerance band. Returns false inside the band (or
+        /// for a degenerate distance).
+        bool computeError(const T_real& distance, T_real& err) const
+        {
+            const T_real epsilon = PBD::constraintEpsilon;
+            err = distance - m_targetDistance;
+            if (std::isinf(err) || std::isnan(err)) return false;
+
+            if (err > m_distanceTolerance)
+            {
+                err = err - m_distanceTolerance + epsilon;
+                return true;
+            }
+            if (err < -m_distanceTolerance)
+            {
+                err = err + m_distanceTolerance - epsilon;
+                return true;
+            }
+            return false;
         }
 
         void setTargetDistance( const T_real& d )
@@ -206,158 +338,193 @@ public:
 
         void setDistanceTolerance( const T_real& d )
         {
-            m_targetDistanceTolerance  = d;
-            m_targetDistanceTolerance2 = d*d;
+            m_distanceTolerance  = d;
+            m_distanceTolerance2 = d*d;
         }
 
         void setConstraintStiffness ( const T_real& d )
         {
-            m_damping = d;
+            m_stiffness = d;
         }
 
+        T_real getTargetDistance() const { return m_targetDistance; }
 
-    protected:
+        T_real getDistanceTolerance() const { return m_distanceTolerance; }
+
+        T_real getConstraintStiffness() const { return m_stiffness; }
+
+        size_t m_particles[numParticles];       ///< Indices of the constrained particles in the store.
         T_real m_targetDistance;
         T_real m_targetDistance2;
-        T_real m_targetDistanceTolerance;
-        T_real m_targetDistanceTolerance2;
-        T_real m_damping;
+        T_real m_distanceTolerance;
+        T_real m_distanceTolerance2;
+        T_real m_stiffness;
     };
 
-    template<typename T_real=double, typename T_vector=Eigen::Vector3d, typename T_matrix=Eigen::Matrix3d>
-    class CShapeMatchingConstraint: public CConstraint<T_real>
+    template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1>, typename T_matrix=Eigen::Matrix<T_real,3,3> >
+    class CShapeMatchingConstraint final: public CConstraint<T_real>
     {
     public:
         typedef std::shared_ptr< CShapeMatchingConstraint > Ptr;
 
         typedef const std::shared_ptr< CShapeMatchingConstraint > ConstPtr;
 
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
         //TODO: Make this parameters global and dependent of the timeStep
         constexpr static T_real MAX_ANGLE_MAGNITUDE = 0.05;
         constexpr static T_real MAX_AXIS_DIFF = 0.3;
 
-        explicit CShapeMatchingConstraint(const std::vector< PBD::CParticle<>* >& particles)
+        /// Method used to obtain the orientation of the deformed configuration
+        enum ERotationExtraction
         {
-            for (const auto &p:particles)
-            {
-                CConstraint<T_real>::m_particles.push_back(p);
-            }
-            CConstraint<T_real>::m_epsilon = PBD::constraintEpsilon;
+            JACOBI_SVD,         ///< Eigenvectors of the deformed covariance (SVD) with axis permutation/inversion fixes. The frame of a symmetric object (e.g. a cube) is not unique, so it may spin.
+            POLAR_QUATERNION    ///< Rotation of the rest-to-deformed covariance refined from the previous rotation (default).
+        };
+
+        CShapeMatchingConstraint(PBD::CParticleStore<T_real>* pStore, const std::vector< size_t >& particles):
+                CConstraint<T_real>(pStore),
+                m_rotationExtraction(POLAR_QUATERNION),
+                m_rotationMaxIter(10)
+        {
+            computeWeights(particles);
 
+            //The rest configuration never changes: compute its CoM, covariance and frame once
             m_restCoM = computeCenterOfMass(CConstraint<T_real>::m_particles);
             computeRestEigenVectors(CConstraint<T_real>::m_particles,m_restCovMat);
 
-            //Populate target particle positions w.r.t. initial CoM and Orientation
-            for (const auto &p:particles)
-            {
-                T_matrix wMo = m_restCovMat;                //Rotation matrix that converts world coordinates to local frame
-                T_vector pTo = p->m_position - m_restCoM;   //Translation of the point w.r.t. local frame
-                m_shapeMatchingPositions.push_back( wMo * pTo ); //Store each particle position w.r.t. local frame
-            }
+            initializeRestConfiguration();
+        }
 
-            //Update deformed configuration states
-            m_deformedCoM = computePredCenterOfMass(CConstraint<T_real>::m_particles);
-            computeEigenVectors(CConstraint<T_real>::m_particles,m_deformedCovMat);
+        /// Use a rest configuration computed beforehand (e.g. loaded from a voxel cache or a snapshot) instead of the
+        /// particle positions. Without pRestOffsets the particles are expected to be at rest.
+        CShapeMatchingConstraint(PBD::CParticleStore<T_real>* pStore, const std::vector< size_t >& particles,
+                                 const T_vector& restCoM, const T_matrix& restCovariance, const T_matrix& restCovMat,
+                                 const T_vector* pRestOffsets=nullptr):
+                CConstraint<T_real>(pStore),
+                m_rotationExtraction(POLAR_QUATERNION),
+                m_rotationMaxIter(10)
+        {
+            computeWeights(particles);
+
+            m_restCoM = restCoM;
+            m_restCovariance = restCovariance;
+            m_restCovMat = restCovMat;
+
+            initializeRestConfiguration(pRestOffsets);
         }
 
         bool isSatisfied()
         {
-            Eigen::Quaterniond restQuat(m_restCovMat);
-            Eigen::Quaterniond defQuat(m_deformedCovMat);
-            T_real dist = restQuat.angularDistance(defQuat);
+            Eigen::Quaternion<T_real> defQuat(m_deformedCovMat);
+            T_real dist = m_restOrientation.angularDistance(defQuat);
             return ( dist < CConstraint<T_real>::m_epsilon );
         }
 
         bool isPredSatisfied()
         {
-            Eigen::Quaterniond restQuat(m_restCovMat);
-            Eigen::Quaterniond defQuat(m_deformedCovMat);
-            T_real dist = restQuat.angularDistance(defQuat);
+            Eigen::Quaternion<T_real> defQuat(m_deformedCovMat);
+            T_real dist = m_restOrientation.angularDistance(defQuat);
             return ( dist < CConstraint<T_real>::m_epsilon );
         }
 
+        /// Reorder the columns of the new frame to follow the old one: the SVD sorts the axes by singular value, so
+        /// axes of close singular values swap between steps. Each new axis takes the slot of the old axis it is most
+        /// aligned with. The result is a column permutation of newMat, so it stays orthonormal.
         T_matrix checkAxisPermutation( const T_matrix& oldMat,  const T_matrix& newMat )
         {
-            T_real threshold = 0.01;
             T_matrix res;
+            bool taken[3] = {false, false, false};
 
             for (uint i=0; i<3; ++i)
             {
-                if ( (oldMat.col(0) - newMat.col(0)).norm() < threshold )
+                uint best = 0;
+                T_real bestDot = -1;
+                for (uint j=0; j<3; ++j)
                 {
-                    res.col(i) = oldMat.col(i);
-                }
-                else if ( (oldMat.col(0) - newMat.col(1)).norm() < threshold )
-                {
-                    res.col(i) = oldMat.col(i);
-                }
-                else if ( (oldMat.col(i) - newMat.col(2)).norm() < threshold )
-                {
-                    res.col(i) = oldMat.col(i);
-                }
-                else
-                {
-                    res.col(i) = newMat.col(i);
+                    const T_real dot = std::abs(oldMat.col(i).dot(newMat.col(j)));
+                    if (!taken[j] && dot > bestDot)
+                    {
+                        best = j;
+                        bestDot = dot;
+                    }
                 }
+                taken[best] = true;
+                res.col(i) = newMat.col(best);
             }
 
             return res;
         }
 
+        /// Flip the axes of the new frame that point away from the same axis of the old one: the SVD gives each axis
+        /// up to its sign.
         T_matrix checkAxisInversion( const T_matrix& oldMat,  const T_matrix& newMat )
         {
-            T_real threshold = 0.01;
             T_matrix res;
 
             for (uint i=0; i<3; ++i)
             {
-                if ( (oldMat.col(0) - newMat.col(0)).norm() > (1+threshold) )
-                {
-                    res.col(i) = oldMat.col(i);
-                }
-                else
-                {
-                    res.col(i) = newMat.col(i);
-                }
+                res.col(i) = oldMat.col(i).dot(newMat.col(i)) < 0 ? T_vector(-newMat.col(i)) : T_vector(newMat.col(i));
             }
 
             return res;
         }
 
-        bool project()
+        void updateDeformedConfiguration()
         {
-            //Update the rest configuration descriptors
-            m_restCoM = computeCenterOfMass(CConstraint<T_real>::m_particles);
-            T_matrix Q, qtmp;
-            computeRestEigenVectors(CConstraint<T_real>::m_particles,Q);
-            qtmp = checkAxisPermutation( m_restCovMat, Q );
-            m_restCovMat = checkAxisInversion  ( m_restCovMat, qtmp );
-
-            //Update the deformed configuration descriptors
             m_deformedCoM = computePredCenterOfMass(CConstraint<T_real>::m_particles);  //CoM in the deformed configuration
+
+            if (m_rotationExtraction == POLAR_QUATERNION)
+            {
+                //Rotation from the rest to the deformed configuration, warm started with the previous one
+                extractRotation<T_real>(computeDeformationMatrix(CConstraint<T_real>::m_particles), m_rotation, m_rotationMaxIter);
+                m_deformedCovMat = m_restCovMat * m_rotation.toRotationMatrix().transpose();
+                return;
+            }
+
+            T_matrix Q, qtmp;
             computeEigenVectors(CConstraint<T_real>::m_particles,Q);                    //Q component of QR decompositions of the Covariance in the deformed configuration
             qtmp = checkAxisPermutation( m_deformedCovMat, Q );
             m_deformedCovMat = checkAxisInversion  ( m_deformedCovMat, qtmp );
+        }
 
-            uint i = 0;
-            double totalDeltas = 0;
-            for (const auto& p:CConstraint<T_real>::m_particles)
-            {
-                //Compute the delta to move each particle to its shape target position in the local frame
-
-                //1 - Convert particle shape target position to world frame
-                T_vector tTw = m_deformedCovMat.inverse() * m_shapeMatchingPositions[i] + m_deformedCoM;
+        /// Target position of each particle for the current deformed configuration, written to m_targets.
+        void computeTargets()
+        {
+            updateDeformedConfiguration();
 
-                //2 - Calculate the delta
-                T_vector deltaWorld = tTw - p->m_predPosition;
+            if (m_rotationExtraction == POLAR_QUATERNION)
+            {
+                const T_matrix R = m_rotation.toRotationMatrix();
+                for (size_t i=0; i<m_restOffsets.size(); ++i)
+                {
+                    m_targets[i] = R * m_restOffsets[i] + m_deformedCoM;
+                }
+                return;
+            }
 
-                totalDeltas += deltaWorld.norm();
+            const T_matrix deformedCovMatInv = m_deformedCovMat.inverse();
+            for (size_t i=0; i<m_shapeMatchingPositions.size(); ++i)
+            {
+                //Convert particle shape target position to world frame
+                m_targets[i] = deformedCovMatInv * m_shapeMatchingPositions[i] + m_deformedCoM;
+            }
+        }
 
-                //3 - Add the delta to the predPosition
-                double stiffness = 1.0; //TODO: Make this a parameter
-                p->m_predPosition = p->m_predPosition + deltaWorld * 1.0;
-                p->m_predOrientation = Eigen::Quaterniond(m_deformedCovMat);
-                ++i;
+        bool project()
+        {
+            computeTargets();
+
+            //Move each particle to its shape target position
+            //TODO: Stiffness parameter
+            PBD::CParticleStore<T_real>& s = *CConstraint<T_real>::m_pStore;
+            const Eigen::Quaternion<T_real> orientation(m_deformedCovMat);
+            const std::vector<size_t>& particles = CConstraint<T_real>::m_particles;
+            for (size_t i=0; i<particles.size(); ++i)
+            {
+                s.m_predPosition[ particles[i] ] += m_targets[i] - s.m_predPosition[ particles[i] ];
+                s.m_predOrientation[ particles[i] ] = orientation;
+            }
 
 // POSITION DELTA FROM THE PBD PAPERS
 //                T_vector x_star = p->m_predPosition;            //particle position in the deformed configuration
@@ -366,108 +533,158 @@ public:
 //                //p->m_predPosition += posDelta;
 //                p->m_predPosition = p->m_position + posDelta;
 //                p->m_predOrientation = quat * p->m_orientation;
-            }
 
-            //return totalDeltas < 0.0001;
             return true;
         }
 
-        //TODO: HIGH Consider particles can have different mass in the com computation
-        T_vector computeCenterOfMass( const std::vector< PBD::CParticle<>* >& particles )
+        bool computeCorrections(Eigen::Matrix<T_real,3,1>* corrections)
         {
+            computeTargets();
+
+            const PBD::CParticleStore<T_real>& s = *CConstraint<T_real>::m_pStore;
+            for (size_t i=0; i<CConstraint<T_real>::m_particles.size(); ++i)
+            {
+                corrections[i] = m_targets[i] - s.m_predPosition[ CConstraint<T_real>::m_particles[i] ];
+            }
+
+            return false;
+        }
+
+        /// Largest distance of a particle to its target of the last projection.
+        T_real getPredError()
+        {
+            const PBD::CParticleStore<T_real>& s = *CConstraint<T_real>::m_pStore;
+            T_real err = 0;
+            for (size_t i=0; i<CConstraint<T_real>::m_particles.size(); ++i)
+            {
+                err = std::max(err, (m_targets[i] - s.m_predPosition[ CConstraint<T_real>::m_particles[i] ]).norm());
+            }
+            return err;
+        }
+
+        /// Mass weights normalized to 1 on average, so objects with uniform mass use the plain averages
+        void computeWeights( const std::vector< size_t >& particles )
+        {
+            const PBD::CParticleStore<T_real>& s = *CConstraint<T_real>::m_pStore;
+            CConstraint<T_real>::m_particles = particles;
+            CConstraint<T_real>::m_epsilon = PBD::constraintEpsilon;
+            m_rotation.setIdentity();
+
+            T_real totalMass = 0;
+            bool uniformMass = true;
+            for (const auto &p:particles)
+            {
+                totalMass += s.m_mass[p];
+                uniformMass = uniformMass && s.m_mass[p] == s.m_mass[particles[0]];
+            }
+            for (const auto &p:particles)
+            {
+                m_weights.push_back( uniformMass || totalMass <= 0 ? T_real(1) : s.m_mass[p] * particles.size() / totalMass );
+            }
+        }
+
+        /// Rest positions and initial deformed state. Expects m_restCoM and m_restCovMat to be set. The rest offsets
+        /// are taken from pRestOffsets if given, otherwise from the current particle positions.
+        void initializeRestConfiguration( const T_vector* pRestOffsets=nullptr )
+        {
+            const PBD::CParticleStore<T_real>& s = *CConstraint<T_real>::m_pStore;
+            m_restOrientation = Eigen::Quaternion<T_real>(m_restCovMat);
+
+            //Populate target particle positions w.r.t. initial CoM and Orientation
+            for (size_t i=0; i<CConstraint<T_real>::m_particles.size(); ++i)
+            {
+                T_matrix wMo = m_restCovMat;                        //Rotation matrix that converts world coordinates to local frame
+                T_vector pTo = pRestOffsets ? pRestOffsets[i] :
+                               T_vector(s.m_position[ CConstraint<T_real>::m_particles[i] ] - m_restCoM);   //Translation of the point w.r.t. local frame
+                m_shapeMatchingPositions.push_back( wMo * pTo ); //Store each particle position w.r.t. local frame
+                m_restOffsets.push_back( pTo );
+            }
+            m_targets.resize(CConstraint<T_real>::m_particles.size());
+
+            //Update deformed configuration states
+            m_deformedCoM = computePredCenterOfMass(CConstraint<T_real>::m_particles);
+            computeEigenVectors(CConstraint<T_real>::m_particles,m_deformedCovMat);
+        }
+
+        T_vector computeCenterOfMass( const std::vector< size_t >& particles )
+        {
+            const PBD::CParticleStore<T_real>& s = *CConstraint<T_real>::m_pStore;
             T_vector CoM (T_real(0),T_real(0),T_real(0));
 
-            for (const auto& p:particles)
+            for (size_t i=0; i<particles.size(); ++i)
             {
-                CoM += p->m_position;
+                CoM += s.m_position[ particles[i] ] * m_weights[i];
             }
             CoM /= particles.size();
             return CoM;
         }
 
-        T_vector computePredCenterOfMass( const std::vector< PBD::CParticle<>* >& particles )
+        T_vector computePredCenterOfMass( const std::vector< size_t >& particles )
         {
+            const PBD::CParticleStore<T_real>& s = *CConstraint<T_real>::m_pStore;
             T_vector CoM (T_real(0),T_real(0),T_real(0));
 
-            for (const auto& p:particles)
+            for (size_t i=0; i<particles.size(); ++i)
             {
-                CoM += p->m_predPosition;
+                CoM += s.m_predPosition[ particles[i] ] * m_weights[i];
             }
             CoM /= particles.size();
             return CoM;
         }
 
-        void computeEigenVectors( const std::vector< PBD::CParticle<>* >& particles, T_matrix& eigenvectors )
+        /// Deformation matrix Apq = sum( w_i * (x_i - c) * (x0_i - c0)^T ). Expects m_deformedCoM to be up to date.
+        T_matrix computeDeformationMatrix( const std::vector< size_t >& particles )
         {
-            T_vector c = computePredCenterOfMass(CConstraint<T_real>::m_particles);
+            const PBD::CParticleStore<T_real>& s = *CConstraint<T_real>::m_pStore;
+            T_matrix Apq;
+
+            Apq.setZero();
+            for (size_t i=0; i<particles.size(); ++i)
+            {
+                Apq += m_weights[i] * (s.m_predPosition[ particles[i] ] - m_deformedCoM) * m_restOffsets[i].transpose();
+            }
+            return Apq;
+        }
+
+        /// Frame of the deformed configuration. Expects m_deformedCoM to be up to date.
+        void computeEigenVectors( const std::vector< size_t >& particles, T_matrix& eigenvectors )
+        {
+            const PBD::CParticleStore<T_real>& s = *CConstraint<T_real>::m_pStore;
             T_matrix cov;
 
             cov.setZero();
-            for (const auto& p:particles)
+            for (size_t i=0; i<particles.size(); ++i)
             {
 //                T_matrix A = 0.2*p->getMass()*p->m_size*p->m_predOrientation.toRotationMatrix();
-                T_vector x_star = p->m_predPosition;
-                T_vector ri = x_star - m_deformedCoM;
-                cov += (x_star - c) * ri.transpose();
+                T_vector ri = s.m_predPosition[ particles[i] ] - m_deformedCoM;
+                cov += m_weights[i] * ri * ri.transpose();
 //                cov += A + (x_star - c) * ri.transpose();
             }
 
 //            Eigen::SelfAdjointEigenSolver<T_matrix> es(cov);
 //            cov = es.eigenvectors();
-            Eigen::JacobiSVD<T_matrix> svd(cov, Eigen::ComputeFullU | Eigen::ComputeFullV);
+            Eigen::JacobiSVD<T_matrix> svd(cov, Eigen::ComputeFullU);
             eigenvectors = svd.matrixU();
-
-//            //Normalize cov mat axis
-//            cov.col(0).normalize();
-//            cov.col(1).normalize();
-//            cov.col(2).normalize();
-//
-//            //Construct a right handed orthonormal basis from the covariance matrix axes
-//            eigenvectors.col(0) = cov.col(0);                   //x = first eigenvector
-//            eigenvectors.col(2) = cov.col(0).cross(cov.col(1)); //z = x*y
-//            eigenvectors.col(2).normalize();
-//            eigenvectors.col(1) = cov.col(2).cross(cov.col(0)); //y = z*x
-//            eigenvectors.col(1).normalize();
         }
 
-        void computeRestEigenVectors( const std::vector< PBD::CParticle<>* >& particles, T_matrix& eigenvectors )
+        /// Frame of the rest configuration. Expects m_restCoM to be up to date. Stores the rest covariance.
+        void computeRestEigenVectors( const std::vector< size_t >& particles, T_matrix& eigenvectors )
         {
+            const PBD::CParticleStore<T_real>& s = *CConstraint<T_real>::m_pStore;
 
-            T_matrix cov;
-            cov.setIdentity();
-
-            T_vector c = computeCenterOfMass(CConstraint<T_real>::m_particles);
-
-            for (const auto& p:particles)
+            m_restCovariance.setIdentity();
+            for (size_t i=0; i<particles.size(); ++i)
             {
-                T_matrix A = 0.2*p->getMass()*p->m_size*p->m_predOrientation.toRotationMatrix();
-                T_vector x_star = p->m_position;
-                T_vector ri = x_star - m_restCoM;
-                cov += (x_star - c) * ri.transpose();
+//                T_matrix A = 0.2*s.m_mass[p]*s.m_size[p]*s.m_predOrientation[p].toRotationMatrix();
+                T_vector ri = s.m_position[ particles[i] ] - m_restCoM;
+                m_restCovariance += m_weights[i] * ri * ri.transpose();
 //                cov += A + (x_star - c) * ri.transpose();
             }
 
 //            Eigen::EigenSolver<T_matrix> es(cov);
 //            cov = es.eigenvectors().real();
-            Eigen::JacobiSVD<T_matrix> svd(cov, Eigen::ComputeFullU | Eigen::ComputeFullV);
+            Eigen::JacobiSVD<T_matrix> svd(m_restCovariance, Eigen::ComputeFullU);
             eigenvectors = svd.matrixU();
-
-//            //Normalize cov mat axis
-//            cov.col(0).normalize();
-//            cov.col(1).normalize();
-//            cov.col(2).normalize();
-//
-//            //Make sure it is a right handed orthonormal basis
-//            eigenvectors.col(0) = cov.col(0);
-//            eigenvectors.col(0).normalize();
-//            eigenvectors.col(2) = cov.col(0).cross(cov.col(1));
-//            eigenvectors.col(2).normalize();
-//            eigenvectors.col(1) = cov.col(2).cross(cov.col(0));
-//            eigenvectors.col(1).normalize();
-
-//            Eigen::FullPivHouseholderQR<Eigen::Matrix3d> solver;
-//            solver.compute(cov);
-//            cov = solver.matrixQ();
         }
 
         T_vector getCoM()    { return m_restCoM; }
@@ -475,11 +692,37 @@ public:
         T_vector getDeformedCoM()    { return m_deformedCoM; }
         T_matrix getDeformedCovMat() { return m_deformedCovMat; }
 
-        std::vector<T_vector> m_shapeMatchingPositions;
+        T_matrix getRestCovariance() { return m_restCovariance; }
+
+        void setRotationExtraction( const ERotationExtraction& method, const unsigned int& maxIter=10 )
+        {
+            m_rotationExtraction = method;
+            m_rotationMaxIter = maxIter;
+        }
+
+        ERotationExtraction getRotationExtraction() { return m_rotationExtraction; }
+
+        unsigned int getRotationMaxIter() { return m_rotationMaxIter; }
+
+        const std::vector<T_vector>& getRestOffsets() { return m_restOffsets; }
+
+        Eigen::Quaternion<T_real> getRotation() { return m_rotation; }
+
+        void setRotation( const Eigen::Quaternion<T_real>& rotation ) { m_rotation = rotation; }
+
+        std::vector<T_vector> m_shapeMatchingPositions;     ///< Rest positions in the rest frame (computed once).
 
     protected:
+        std::vector<T_real>   m_weights;                    ///< Normalized mass of each particle.
+        std::vector<T_vector> m_targets;                    ///< Scratch target positions of the last projection.
+        std::vector<T_vector> m_restOffsets;                ///< Rest positions w.r.t. the rest CoM in world axes.
+        ERotationExtraction m_rotationExtraction;
+        unsigned int m_rotationMaxIter;
+        Eigen::Quaternion<T_real> m_rotation;                      ///< Rest to deformed rotation (POLAR_QUATERNION warm start).
         T_vector m_restCoM;
         T_matrix m_restCovMat;
+        T_matrix m_restCovariance;
+        Eigen::Quaternion<T_real> m_restOrientation;
         T_vector m_deformedCoM;
         T_matrix m_deformedCovMat;
     };
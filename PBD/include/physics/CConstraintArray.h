@@ -0,0 +1,108 @@
+#ifndef PBD_CCONSTRAINTARRAY_H
+#define PBD_CCONSTRAINTARRAY_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace PBD
+{
+
+/// Next stamp of the process wide generation counter of the constraint arrays. Never returns 0, so 0 can mean "no
+/// generation" to the caches.
+inline uint64_t nextConstraintGeneration()
+{
+    static std::atomic<uint64_t> counter(0);
+    return ++counter;
+}
+
+/**
+ * Array of the constraints of one type in a CConstraintStore: a std::vector that stamps a new generation on every
+ * change of its contents.
+ *
+ * The stamps come from one process wide counter, so two arrays never share a generation and a cache keyed on the
+ * generation of an array (like the coloring of the permanent constraints in CWorld) is invalidated by any insertion,
+ * removal or assignment, even one that leaves the size unchanged.
+ *
+ * The element accessors do not stamp: the solvers write the accumulated corrections of the constraints through them
+ * every iteration. Code that modifies the particles of a constraint in place must call touch().
+ */
+template<typename T_constraint>
+class CConstraintArray
+{
+public:
+    typedef T_constraint value_type;
+    typedef typename std::vector<T_constraint>::iterator iterator;
+    typedef typename std::vector<T_constraint>::const_iterator const_iterator;
+
+    CConstraintArray(): m_generation(nextConstraintGeneration())
+    {}
+
+    CConstraintArray(const CConstraintArray& other): m_constraints(other.m_constraints), m_generation(nextConstraintGeneration())
+    {}
+
+    CConstraintArray& operator=(const CConstraintArray& other)
+    {
+        m_constraints = other.m_constraints;
+        touch();
+        return *this;
+    }
+
+    ~CConstraintArray() = default;
+
+    template<typename... T_args>
+    void emplace_back(T_args&&... args)
+    {
+        m_constraints.emplace_back(std::forward<T_args>(args)...);
+        touch();
+    }
+
+    void push_back(const T_constraint& c)
+    {
+        m_constraints.push_back(c);
+        touch();
+    }
+
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        touch();
+        return m_constraints.erase(first, last);
+    }
+
+    void clear()
+    {
+        m_constraints.clear();
+        touch();
+    }
+
+    void reserve(const size_t& n) { m_constraints.reserve(n); }
+
+    size_t size() const { return m_constraints.size(); }
+
+    bool empty() const { return m_constraints.empty(); }
+
+    T_constraint& operator[](const size_t& i) { return m_constraints[i]; }
+    const T_constraint& operator[](const size_t& i) const { return m_constraints[i]; }
+
+    T_constraint& back() { return m_constraints.back(); }
+    const T_constraint& back() const { return m_constraints.back(); }
+
+    iterator begin() { return m_constraints.begin(); }
+    iterator end() { return m_constraints.end(); }
+    const_iterator begin() const { return m_constraints.begin(); }
+    const_iterator end() const { return m_constraints.end(); }
+
+    /// Stamp a new generation, after modifying the constraints through the element accessors.
+    void touch() { m_generation = nextConstraintGeneration(); }
+
+    uint64_t getGeneration() const { return m_generation; }
+
+protected:
+    std::vector<T_constraint> m_constraints;
+    uint64_t m_generation;
+};
+
+}
+
+#endif //PBD_CCONSTRAINTARRAY_H
@@ -0,0 +1,170 @@
+#ifndef PBD_CCONSTRAINTCOLORING_H
+#define PBD_CCONSTRAINTCOLORING_H
+
+#include <vector>
+#include <cstdint>
+#include <physics/CConstraintStore.h>
+#include <physics/CParticleStore.h>
+#include <physics/CThreadPool.h>
+
+namespace PBD
+{
+
+/**
+ * Greedy coloring of a constraint graph: two constraints that move the same particle never get the same color, so
+ * the constraints of one color can be projected concurrently while keeping Gauss-Seidel updates between colors.
+ *
+ * Static particles (mass 0) are never written by a projection, so they do not link constraints.
+ * Each particle keeps a 64 bit mask of the colors already used by its constraints. Constraints that find all 64
+ * colors taken go to an overflow batch that is projected serially after the colored batches.
+ *
+ * The colors are shared by all the arrays of a CConstraintStore. Each array keeps the indices of its constraints
+ * sorted by color, so a color batch is projected array after array with the kernels of each type.
+ */
+template<typename T_real=double>
+class CConstraintColoring
+{
+public:
+    CConstraintColoring(): m_numColors(0) {}
+
+    ~CConstraintColoring() = default;
+
+    static const size_t MAX_COLORS = 64;
+
+    void color(const PBD::CConstraintStore<T_real>& constraints, const PBD::CParticleStore<T_real>& store)
+    {
+        m_particleColors.assign(store.size(), 0);
+        m_numColors = 0;
+
+        size_t array = 0;
+        constraints.forEachArray([&](const auto& typed)
+        {
+            if (m_batches.size() <= array) m_batches.emplace_back();
+            SBatches& batches = m_batches[array++];
+
+            //Assign to each constraint the first color not used by any of its dynamic particles
+            m_constraintColor.resize(typed.size());
+            for (size_t c=0; c<typed.size(); ++c)
+            {
+                uint64_t used = 0;
+                for (const auto& p:typed[c].m_particles)
+                {
+                    if (store.m_mass[p] > 0) used |= m_particleColors[p];
+                }
+
+                size_t color = 0;
+                while (color < MAX_COLORS && (used & (uint64_t(1) << color))) ++color;
+
+                if (color < MAX_COLORS)
+                {
+                    for (const auto& p:typed[c].m_particles)
+                    {
+                        if (store.m_mass[p] > 0) m_particleColors[p] |= (uint64_t(1) << color);
+                    }
+                    m_numColors = std::max(m_numColors, color+1);
+                }
+                m_constraintColor[c] = color;
+            }
+
+            //Sort the constraints by color (stable, so each batch keeps the original order)
+            batches.m_colorStart.assign(MAX_COLORS+2, 0);
+            for (const auto& color:m_constraintColor)
+            {
+                ++batches.m_colorStart[color+1];
+            }
+            for (size_t color=0; color<MAX_COLORS+1; ++color)
+            {
+                batches.m_colorStart[color+1] += batches.m_colorStart[color];
+            }
+            m_colorFill.assign(batches.m_colorStart.begin(), batches.m_colorStart.end()-1);
+            batches.m_order.resize(typed.size());
+            for (size_t c=0; c<typed.size(); ++c)
+            {
+                batches.m_order[ m_colorFill[ m_constraintColor[c] ]++ ] = c;
+            }
+        });
+        m_batches.resize(array);
+    }
+
+    /// Project every color batch in parallel, then the overflow batch serially. Returns true if all the constraints
+    /// are satisfied after their projection. constraints must be the store given to color().
+    bool project(PBD::CConstraintStore<T_real>& constraints, PBD::CParticleStore<T_real>& store, PBD::CThreadPool& pool)
+    {
+        m_chunkOK.assign(pool.getNumThreads(), 1);
+        for (size_t color=0; color<m_numColors; ++color)
+        {
+            size_t array = 0;
+            constraints.forEachArray([&](auto& typed)
+            {
+                const SBatches& batches = m_batches[array++];
+                if (batches.m_colorStart[color] == batches.m_colorStart[color+1]) return;
+
+                pool.parallelFor(batches.m_colorStart[color], batches.m_colorStart[color+1], [&](size_t b, size_t e, size_t t)
+                {
+                    bool ok = true;
+                    for (size_t c=b; c<e; ++c)
+                    {
+                        auto& constraint = typed[ batches.m_order[c] ];
+                        constraint.project(store);
+                        ok = ok && constraint.isPredSatisfied(store);
+                    }
+                    m_chunkOK[t] = m_chunkOK[t] && ok;
+                });
+            });
+        }
+
+        bool constraintsOK = true;
+        size_t array = 0;
+        constraints.forEachArray([&](auto& typed)
+        {
+            const SBatches& batches = m_batches[array++];
+            for (size_t c=batches.m_colorStart[MAX_COLORS]; c<batches.m_colorStart[MAX_COLORS+1]; ++c)
+            {
+                auto& constraint = typed[ batches.m_order[c] ];
+                constraint.project(store);
+                constraintsOK = constraintsOK && constraint.isPredSatisfied(store);
+            }
+        });
+
+        for (const auto& ok:m_chunkOK)
+        {
+            constraintsOK = constraintsOK && ok;
+        }
+        return constraintsOK;
+    }
+
+    size_t getNumColors() const { return m_numColors; }
+
+    size_t getNumConstraints() const
+    {
+        size_t n = 0;
+        for (const auto& batches:m_batches) n += batches.m_order.size();
+        return n;
+    }
+
+    size_t getNumOverflowConstraints() const
+    {
+        size_t n = 0;
+        for (const auto& batches:m_batches) n += batches.m_colorStart[MAX_COLORS+1] - batches.m_colorStart[MAX_COLORS];
+        return n;
+    }
+
+protected:
+    /// Color batches of one constraint array
+    struct SBatches
+    {
+        std::vector<size_t> m_colorStart;                       ///< First entry of each color in m_order (overflow last).
+        std::vector<size_t> m_order;                            ///< Indices of the constraints sorted by color.
+    };
+
+    size_t m_numColors;
+    std::vector<uint64_t> m_particleColors;                     ///< Colors used by the constraints of each particle.
+    std::vector<size_t>   m_constraintColor;
+    std::vector<size_t>   m_colorFill;
+    std::vector<SBatches> m_batches;                            ///< One entry per array of the colored store.
+    std::vector<char>     m_chunkOK;
+};
+
+}
+
+#endif //PBD_CCONSTRAINTCOLORING_H
@@ -0,0 +1,105 @@
+#ifndef PBD_CCONSTRAINTSTORE_H
+#define PBD_CCONSTRAINTSTORE_H
+
+#include <vector>
+#include <algorithm>
+#include <physics/CConstraint.hpp>
+#include <physics/CConstraintArray.h>
+#include <physics/CParticleStore.h>
+
+namespace PBD
+{
+
+/**
+ * Constraints with a fixed number of particles, segregated by type: each type is a contiguous array of plain structs
+ * (see SNoPenetrationConstraint). The solvers visit the arrays with forEachArray and a generic lambda, so every
+ * array is looped with the kernels of its own type, without virtual calls or per constraint allocations.
+ *
+ * Adding a constraint type: give it the interface of SNoPenetrationConstraint (numParticles, m_particles, project,
+ * isSatisfied, isPredSatisfied, computeCorrections and getPredError), add its array and list the array in
+ * forEachArray and assignIf.
+ *
+ * Each array stamps a new generation when its contents change (see CConstraintArray); getGeneration() tells the
+ * caches derived from the store, like a coloring, whether it changed since they were built.
+ */
+template<typename T_real=double>
+class CConstraintStore
+{
+public:
+    typedef PBD::SNoPenetrationConstraint<T_real> NoPenetration;
+    typedef PBD::SDistanceConstraint<T_real> Distance;
+
+    CConstraintStore() = default;
+
+    ~CConstraintStore() = default;
+
+    /// Call f(array) on the array of each constraint type, always in the same order.
+    template<typename T_function>
+    void forEachArray(T_function f)
+    {
+        f(m_noPenetration);
+        f(m_distance);
+    }
+
+    template<typename T_function>
+    void forEachArray(T_function f) const
+    {
+        f(m_noPenetration);
+        f(m_distance);
+    }
+
+    /// Call f(constraint) on every constraint, array after array.
+    template<typename T_function>
+    void forEach(T_function f) const
+    {
+        forEachArray([&f](const auto& constraints)
+        {
+            for (const auto& c:constraints) f(c);
+        });
+    }
+
+    /// Replace the contents with the constraints of other for which keep(constraint) is true. Keeps their order.
+    template<typename T_predicate>
+    void assignIf(const CConstraintStore& other, T_predicate keep)
+    {
+        auto filter = [&keep](const auto& from, auto& to)
+        {
+            to.clear();
+            for (const auto& c:from)
+            {
+                if (keep(c)) to.push_back(c);
+            }
+        };
+        filter(other.m_noPenetration, m_noPenetration);
+        filter(other.m_distance, m_distance);
+    }
+
+    size_t size() const
+    {
+        size_t n = 0;
+        forEachArray([&n](const auto& constraints){ n += constraints.size(); });
+        return n;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    void clear()
+    {
+        forEachArray([](auto& constraints){ constraints.clear(); });
+    }
+
+    /// Latest generation of the arrays: changes whenever a constraint is added, removed or replaced.
+    uint64_t getGeneration() const
+    {
+        uint64_t generation = 0;
+        forEachArray([&generation](const auto& constraints){ generation = std::max(generation, constraints.getGeneration()); });
+        return generation;
+    }
+
+    PBD::CConstraintArray<NoPenetration> m_noPenetration;
+    PBD::CConstraintArray<Distance>      m_distance;
+};
+
+}
+
+#endif //PBD_CCONSTRAINTSTORE_H
@@ -0,0 +1,99 @@
+#ifndef PBD_CCONTACTCACHE_H
+#define PBD_CCONTACTCACHE_H
+
+#include <vector>
+#include <algorithm>
+#include <physics/CConstraint.hpp>
+#include <physics/CConstraintArray.h>
+#include <physics/CParticleStore.h>
+
+namespace PBD
+{
+
+/**
+ * Contacts of the previous step, keyed by particle pair, with the separation their projections applied.
+ *
+ * The entries are kept sorted by pair in a flat array. update() writes the contacts of the current step to a second
+ * array and swaps both, so the contacts that were not found again are evicted in bulk and, once both arrays have
+ * grown to the size of the scene contacts, no memory is allocated.
+ *
+ * warmStart() applies a fraction of the cached separation of every persisting contact before the solve. A pile
+ * then starts from close to the previous solution instead of propagating the corrections from the ground up again,
+ * and the solver loop reaches its convergence test in fewer sweeps.
+ */
+template<typename T_real=double>
+class CContactCache
+{
+public:
+    typedef PBD::SNoPenetrationConstraint<T_real> Contact;
+
+    CContactCache() = default;
+
+    ~CContactCache() = default;
+
+    /// Push apart the pairs of contacts found in the cache by factor times their cached separation, and start their
+    /// accumulated correction from it. The new contacts start cold.
+    void warmStart(PBD::CConstraintArray<Contact>& contacts, PBD::CParticleStore<T_real>& store, const T_real& factor)
+    {
+        m_numWarmStarted = 0;
+        if (m_entries.empty()) return;
+
+        for (auto& c:contacts)
+        {
+            const SEntry key = makeEntry(c);
+            auto it = std::lower_bound(m_entries.begin(), m_entries.end(), key);
+            if (it != m_entries.end() && it->m_p0 == key.m_p0 && it->m_p1 == key.m_p1)
+            {
+                c.warmStart(store, factor * it->m_correction);
+                ++m_numWarmStarted;
+            }
+        }
+    }
+
+    /// Replace the cache with the contacts that applied a separation in the solve that just ended.
+    void update(const PBD::CConstraintArray<Contact>& contacts)
+    {
+        m_next.clear();
+        for (const auto& c:contacts)
+        {
+            if (c.m_correction > 0) m_next.push_back(makeEntry(c));
+        }
+        std::sort(m_next.begin(), m_next.end());
+        m_entries.swap(m_next);
+    }
+
+    void clear()
+    {
+        m_entries.clear();
+        m_next.clear();
+        m_numWarmStarted = 0;
+    }
+
+    size_t size() const { return m_entries.size(); }
+
+    /// Contacts found in the cache by the last warmStart().
+    size_t getNumWarmStarted() const { return m_numWarmStarted; }
+
+protected:
+    struct SEntry
+    {
+        size_t m_p0;            ///< Smallest particle index of the pair.
+        size_t m_p1;
+        T_real m_correction;
+
+        bool operator<(const SEntry& e) const { return m_p0 < e.m_p0 || (m_p0 == e.m_p0 && m_p1 < e.m_p1); }
+    };
+
+    static SEntry makeEntry(const Contact& c)
+    {
+        return SEntry{ std::min(c.m_particles[0], c.m_particles[1]), std::max(c.m_particles[0], c.m_particles[1]), c.m_correction };
+    }
+
+    std::vector<SEntry> m_entries;      ///< Contacts of the previous step, sorted by particle pair.
+    std::vector<SEntry> m_next;
+    size_t m_numWarmStarted = 0;
+};
+
+}
+
+#endif //PBD_CCONTACTCACHE_H
@@ -0,0 +1,155 @@
+#ifndef PBD_CJACOBISOLVER_H
+#define PBD_CJACOBISOLVER_H
+
+#include <vector>
+#include <Eigen/Dense>
+#include <physics/CConstraintStore.h>
+#include <physics/CParticleStore.h>
+#include <physics/CThreadPool.h>
+
+namespace PBD
+{
+
+/**
+ * Parallel Jacobi constraint projection.
+ *
+ * Every constraint writes the corrections of its particles to its own slots of a shared buffer, so all the
+ * constraints of an iteration can be evaluated concurrently. The corrections are then gathered per particle, averaged
+ * by the number of constraints that moved the particle and applied scaled by the relaxation factor
+ * (Macklin et al. 2014, "Unified Particle Physics for Real-Time Applications", section 4.2).
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+class CJacobiSolver
+{
+public:
+    typedef std::vector< const PBD::CConstraintStore<T_real>* > StoreList;
+
+    CJacobiSolver() = default;
+
+    ~CJacobiSolver() = default;
+
+    /// Build the slot layout for a list of constraint stores. Must be called whenever the constraints change.
+    void setup(const StoreList& stores, const size_t& numParticles)
+    {
+        //One slot per constrained particle, contiguous per constraint array
+        m_arraySlotOffset.clear();
+        size_t numSlots = 0;
+        forEachArray(stores, [this, &numSlots](const auto& constraints)
+        {
+            m_arraySlotOffset.push_back(numSlots);
+            numSlots += constraints.size() * numParticlesOf(constraints);
+        });
+        m_corrections.resize(numSlots);
+
+        //Slots of each particle (CSR), restricted to the particles touched by the constraints
+        m_particleSlotCount.assign(numParticles, 0);
+        forEachArray(stores, [this](const auto& constraints)
+        {
+            for (const auto& c:constraints)
+            {
+                for (const auto& p:c.m_particles) ++m_particleSlotCount[p];
+            }
+        });
+
+        m_touchedParticles.clear();
+        m_touchedSlotStart.clear();
+        m_touchedSlotStart.push_back(0);
+        m_particleRow.resize(numParticles);
+        for (size_t p=0; p<numParticles; ++p)
+        {
+            if (m_particleSlotCount[p] > 0)
+            {
+                m_particleRow[p] = m_touchedSlotStart.back();
+                m_touchedParticles.push_back(p);
+                m_touchedSlotStart.push_back(m_touchedSlotStart.back() + m_particleSlotCount[p]);
+            }
+        }
+
+        m_touchedSlots.resize(numSlots);
+        size_t slot = 0;
+        forEachArray(stores, [this, &slot](const auto& constraints)
+        {
+            for (const auto& c:constraints)
+            {
+                for (const auto& p:c.m_particles) m_touchedSlots[ m_particleRow[p]++ ] = slot++;
+            }
+        });
+    }
+
+    /// One Jacobi iteration. Returns true if all the constraints were satisfied before the iteration.
+    bool iterate(const StoreList& stores,
+                 PBD::CParticleStore<T_real>& store,
+                 PBD::CThreadPool& pool,
+                 const T_real& relaxation)
+    {
+        //Evaluate the constraints, one parallel loop per constraint array
+        m_chunkOK.assign(pool.getNumThreads(), 1);
+        size_t array = 0;
+        forEachArray(stores, [&](const auto& constraints)
+        {
+            const size_t numSlots = numParticlesOf(constraints);
+            T_vector* corrections = m_corrections.data() + m_arraySlotOffset[array++];
+            pool.parallelFor(0, constraints.size(), [&](size_t b, size_t e, size_t t)
+            {
+                bool ok = true;
+                for (size_t c=b; c<e; ++c)
+                {
+                    ok = constraints[c].computeCorrections(store, corrections + c*numSlots) && ok;
+                }
+                m_chunkOK[t] = m_chunkOK[t] && ok;
+            });
+        });
+
+        //Average and apply the corrections of each particle
+        pool.parallelFor(0, m_touchedParticles.size(), [&](size_t b, size_t e, size_t)
+        {
+            for (size_t i=b; i<e; ++i)
+            {
+                T_vector delta(0,0,0);
+                size_t count = 0;
+                for (size_t k=m_touchedSlotStart[i]; k<m_touchedSlotStart[i+1]; ++k)
+                {
+                    const T_vector& d = m_corrections[ m_touchedSlots[k] ];
+                    if (!d.isZero(0))
+                    {
+                        delta += d;
+                        ++count;
+                    }
+                }
+                if (count > 0)
+                {
+                    store.m_predPosition[ m_touchedParticles[i] ] += delta * (relaxation / T_real(count));
+                }
+            }
+        });
+
+        for (const auto& ok:m_chunkOK)
+        {
+            if (!ok) return false;
+        }
+        return true;
+    }
+
+protected:
+    template<typename T_function>
+    static void forEachArray(const StoreList& stores, T_function f)
+    {
+        for (const auto& pStore:stores) pStore->forEachArray(f);
+    }
+
+    template<typename T_array>
+    static size_t numParticlesOf(const T_array&) { return T_array::value_type::numParticles; }
+
+    std::vector<size_t>   m_arraySlotOffset;     ///< First correction slot of each constraint array.
+    std::vector<T_vector> m_corrections;         ///< Correction slots written by the constraints.
+    std::vector<size_t>   m_particleSlotCount;
+    std::vector<size_t>   m_particleRow;
+    std::vector<size_t>   m_touchedParticles;    ///< Particles referenced by at least one constraint.
+    std::vector<size_t>   m_touchedSlotStart;    ///< First entry of each touched particle in m_touchedSlots.
+    std::vector<size_t>   m_touchedSlots;        ///< Correction slots of each touched particle.
+    std::vector<char>     m_chunkOK;             ///< Satisfied flag of each thread chunk.
+};
+
+}
+
+#endif //PBD_CJACOBISOLVER_H
@@ -13,7 +13,7 @@ namespace PBD {
     const static double minRotVel = 0.00001;
     const static double velDamping = 1.0;
 
-template<typename T_real=double, typename T_vector=Eigen::Vector3d, typename T_quaternion=Eigen::Quaterniond>
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1>, typename T_quaternion=Eigen::Quaternion<T_real> >
 class CParticle
 {
 public:
@@ -167,7 +167,7 @@ public:
             T_real wNorm = m_angularVelocity.norm();
             if (wNorm > minRotVel)
             {
-                T_vector axis = m_angularVelocity / wNorm * sin( wNorm * timeStep / 2.0 );
+                T_vector axis = m_angularVelocity / wNorm * sin( wNorm * timeStep / 2 );
                 T_real   angle = cos ( wNorm * timeStep / 2 );
                 T_quaternion delta;
                 delta.x() = axis.x();
@@ -189,9 +189,9 @@ public:
         if (m_mass > 0)
         {
             T_quaternion quat = m_predOrientation*m_orientation.inverse();
-            Eigen::AngleAxisd aa( quat );
+            Eigen::AngleAxis<T_real> aa( quat );
 
-            m_velocity = ((m_predPosition - m_position) / timeStep) * PBD::velDamping;
+            m_velocity = ((m_predPosition - m_position) / timeStep) * T_real(PBD::velDamping);
             m_angularVelocity = aa.axis() * aa.angle() / timeStep;
         }
     }
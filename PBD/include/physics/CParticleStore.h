@@ -0,0 +1,196 @@
+#ifndef PBD_CPARTICLESTORE_H
+#define PBD_CPARTICLESTORE_H
+
+#include <memory>
+#include <vector>
+#include <Eigen/Dense>
+#include <physics/CParticle.hpp>
+
+namespace PBD {
+
+    const static size_t noRigidBody = size_t(-1);     ///< Rigid body index of the particles that are not part of one.
+
+/**
+ * Per-particle view over a CParticleStore. Exposes the same members as CParticle as references to the store arrays,
+ * so code written against CParticle (p->m_position, p->getMass(), ...) keeps working on the SoA layout.
+ * Views are cheap to create and are invalidated when particles are added to the store.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1>, typename T_quaternion=Eigen::Quaternion<T_real> >
+class CParticleView
+{
+public:
+    CParticleView(T_vector& position, T_vector& predPosition,
+                  T_quaternion& orientation, T_quaternion& predOrientation,
+                  T_vector& velocity, T_vector& angularVelocity, T_vector& extForce,
+                  T_real& size, size_t& group, T_real& mass, T_real& massInv):
+            m_position(position),
+            m_predPosition(predPosition),
+            m_orientation(orientation),
+            m_predOrientation(predOrientation),
+            m_velocity(velocity),
+            m_angularVelocity(angularVelocity),
+            m_extForce(extForce),
+            m_size(size),
+            m_group(group),
+            m_mass(mass),
+            m_massInv(massInv)
+    {}
+
+    const CParticleView* operator->() const { return this; }
+
+    void setMass(const T_real &m) const
+    {
+        m_mass = m;
+        m_massInv = m > 0 ? 1 / m : T_real(0);
+    }
+
+    T_real getMass( ) const { return m_mass; }
+
+    T_real getMassInv( ) const { return m_massInv; }
+
+    void clearExtForces() const { m_extForce = T_vector(0,0,0); }
+
+    T_vector& m_position;
+    T_vector& m_predPosition;
+    T_quaternion& m_orientation;
+    T_quaternion& m_predOrientation;
+    T_vector& m_velocity;
+    T_vector& m_angularVelocity;
+    T_vector& m_extForce;
+    T_real& m_size;
+    size_t& m_group;
+
+protected:
+    T_real& m_mass;
+    T_real& m_massInv;
+};
+
+
+/**
+ * Structure-of-Arrays particle container. Each particle attribute is stored in its own contiguous array and particles
+ * are addressed by index. Static particles (mass 0) have an inverse mass of 0.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1>, typename T_quaternion=Eigen::Quaternion<T_real> >
+class CParticleStore
+{
+public:
+    typedef CParticleView<T_real, T_vector, T_quaternion> View;
+
+    typedef std::vector<T_quaternion, Eigen::aligned_allocator<T_quaternion> > QuaternionVector;
+
+public:
+    CParticleStore() = default;
+
+    ~CParticleStore() = default;
+
+    size_t size() const { return m_position.size(); }
+
+    bool empty() const { return m_position.empty(); }
+
+    void reserve(const size_t& n)
+    {
+        m_position.reserve(n);
+        m_predPosition.reserve(n);
+        m_velocity.reserve(n);
+        m_extForce.reserve(n);
+        m_orientation.reserve(n);
+        m_predOrientation.reserve(n);
+        m_angularVelocity.reserve(n);
+        m_mass.reserve(n);
+        m_massInv.reserve(n);
+        m_size.reserve(n);
+        m_group.reserve(n);
+        m_rigidBody.reserve(n);
+    }
+
+    void clear()
+    {
+        m_position.clear();
+        m_predPosition.clear();
+        m_velocity.clear();
+        m_extForce.clear();
+        m_orientation.clear();
+        m_predOrientation.clear();
+        m_angularVelocity.clear();
+        m_mass.clear();
+        m_massInv.clear();
+        m_size.clear();
+        m_group.clear();
+        m_rigidBody.clear();
+    }
+
+    /// Copy a particle into the store. Returns its index.
+    size_t push_back(const CParticle<T_real, T_vector, T_quaternion>& p)
+    {
+        m_position.push_back(p.m_position);
+        m_predPosition.push_back(p.m_predPosition);
+        m_velocity.push_back(p.m_velocity);
+        m_extForce.push_back(p.m_extForce);
+        m_orientation.push_back(p.m_orientation);
+        m_predOrientation.push_back(p.m_predOrientation);
+        m_angularVelocity.push_back(p.m_angularVelocity);
+        m_mass.push_back(p.getMass());
+        m_massInv.push_back(p.getMass() > 0 ? p.getMassInv() : T_real(0));
+        m_size.push_back(p.m_size);
+        m_group.push_back(p.m_group);
+        m_rigidBody.push_back(noRigidBody);
+        return size()-1;
+    }
+
+    /**
+     * Append count contiguous particles at rest with the same mass, size and group, growing every array once.
+     * Returns the index of the first one. Positions are left uninitialized: the caller sets m_position and
+     * m_predPosition of the new range.
+     */
+    size_t appendBlock(const size_t& count, const T_real& mass, const T_real& size, const size_t& group=0)
+    {
+        const size_t first = this->size();
+        const size_t n = first + count;
+        m_position.resize(n);
+        m_predPosition.resize(n);
+        m_velocity.resize(n, T_vector(0,0,0));
+        m_extForce.resize(n, T_vector(0,0,0));
+        m_orientation.resize(n, T_quaternion::Identity());
+        m_predOrientation.resize(n, T_quaternion::Identity());
+        m_angularVelocity.resize(n, T_vector(0,0,0));
+        m_mass.resize(n, mass);
+        m_massInv.resize(n, mass > 0 ? 1 / mass : T_real(0));
+        m_size.resize(n, size);
+        m_group.resize(n, group);
+        m_rigidBody.resize(n, noRigidBody);
+        return first;
+    }
+
+    /// Compatibility with the previous std::vector< CParticle<>::Ptr > storage. The particle data is copied.
+    size_t emplace_back(const typename CParticle<T_real, T_vector, T_quaternion>::Ptr& p)
+    {
+        return push_back(*p);
+    }
+
+    View operator[](const size_t& i)
+    {
+        return View(m_position[i], m_predPosition[i], m_orientation[i], m_predOrientation[i],
+                    m_velocity[i], m_angularVelocity[i], m_extForce[i],
+                    m_size[i], m_group[i], m_mass[i], m_massInv[i]);
+    }
+
+    //Hot data (touched by the integrator, the broad phase and the solvers)
+    std::vector<T_vector> m_position;
+    std::vector<T_vector> m_predPosition;
+    std::vector<T_vector> m_velocity;
+    std::vector<T_vector> m_extForce;
+    std::vector<T_real>   m_mass;
+    std::vector<T_real>   m_massInv;
+    std::vector<T_real>   m_size;
+    std::vector<size_t>   m_group;
+    std::vector<size_t>   m_rigidBody;      ///< Index of the CWorld rigid body that owns the particle, or noRigidBody.
+
+    //Cold data
+    QuaternionVector      m_orientation;
+    QuaternionVector      m_predOrientation;
+    std::vector<T_vector> m_angularVelocity;
+};
+
+}
+
+#endif //PBD_CPARTICLESTORE_H
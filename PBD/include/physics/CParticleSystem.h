@@ -3,6 +3,7 @@
 #define POSITIONBASEDDYNAMICS_CPARTICLESYSTEM_H
 
 #include <physics/CParticle.hpp>
+#include <physics/CParticleStore.h>
 #include <physics/CConstraint.hpp>
 #include <memory>
 #include <vector>
@@ -18,24 +19,30 @@ namespace PBD {
         typedef const std::shared_ptr< CParticleSystem<T_real> > ConstPtr;
 
     public:
-        CParticleSystem() = default;
+        CParticleSystem(): m_pStore( nullptr )
+        { }
+
+        explicit CParticleSystem( PBD::CParticleStore<T_real>* pStore ): m_pStore( pStore )
+        { }
 
         ~CParticleSystem() = default;
 
-        CParticleSystem( const CParticleSystem& p ): m_particles( p.m_particles )
+        CParticleSystem( const CParticleSystem& p ): m_pStore( p.m_pStore ), m_particles( p.m_particles )
         { }
 
-        CParticleSystem( CParticleSystem&& p ) noexcept : m_particles( std::move(p.m_particles) )
+        CParticleSystem( CParticleSystem&& p ) noexcept : m_pStore( p.m_pStore ), m_particles( std::move(p.m_particles) )
         { }
 
         CParticleSystem &operator=(const CParticleSystem &p)
         {
+            m_pStore = p.m_pStore;
             m_particles = p.m_particles;
             return *this;
         }
 
         CParticleSystem &operator=(CParticleSystem &&p) noexcept
         {
+            m_pStore = p.m_pStore;
             m_particles = std::move(p.m_particles);
             return *this;
         }
@@ -46,8 +53,8 @@ namespace PBD {
             {
                 for (uint i=0; i<3; ++i)
                 {
-                    min[i] = std::min(min[i] , (*it)->m_position(i));
-                    max[i] = std::max(max[i] , (*it)->m_position(i));
+                    min[i] = std::min(min[i] , m_pStore->m_position[*it](i));
+                    max[i] = std::max(max[i] , m_pStore->m_position[*it](i));
                 }
             }
         }
@@ -59,7 +66,7 @@ namespace PBD {
             {
                 for (uint i = 0; i < 3; ++i)
                 {
-                    centroid[i] += (*it)->m_position[i];
+                    centroid[i] += m_pStore->m_position[*it][i];
                 }
             }
             centroid /= m_particles.size();
@@ -73,14 +80,15 @@ namespace PBD {
             {
                 for (uint i = 0; i < 3; ++i)
                 {
-                    vel[i] += (*it)->m_velocity[i];
+                    vel[i] += m_pStore->m_velocity[*it][i];
                 }
             }
             vel /= m_particles.size();
             return vel;
         }
 
-        std::vector< PBD::CParticle<>* > m_particles;        ///< Current state of the particle system.
+        PBD::CParticleStore<T_real>* m_pStore;              ///< Store holding the particles of the system.
+        std::vector< size_t > m_particles;                  ///< Indices of the particles of the system in m_pStore.
     };
 
 }
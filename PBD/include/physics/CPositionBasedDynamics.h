@@ -15,12 +15,12 @@
 #include <physics/CParticleSystem.h>
 #include <physics/CConstraint.hpp>
 #include <physics/CWorld.h>
+#include <physics/CVoxelizer.h>
+#include <io/PointCloudReader.h>
+#include <io/CVoxelCache.h>
 #include <sstream>
 
 #include <Common.h>
-#define _HCD_ENABLE_SAFE_CHECKS_
-#include <Octree.hpp>
-#include <PointSetNode.hpp>
 
 
 namespace PBD
@@ -29,19 +29,24 @@ namespace PBD
 
 template<typename T_real=double>
 void addParticleSystemInternalConstraints(
-        PBD::CWorld* pWorld,
+        PBD::CWorld<T_real>* pWorld,
         const size_t& partIdxIni,
         const size_t& partIdxEnd
 )
 {
+    //USING A RIGID BODY
+    if (pWorld->m_rigidBodyFastPath && pWorld->addRigidBody(partIdxIni, partIdxEnd))
+    {
+        return;
+    }
 
-    //USING SHAPE MATCHING
-    std::vector< CParticle<>* > particles;
+    //USING SHAPE MATCHING (also for objects with static particles, which cannot be rigid bodies)
+    std::vector< size_t > particles;
     for (size_t i=partIdxIni; i<partIdxEnd ; ++i) {
-        particles.push_back(pWorld->m_particles[i].get());
+        particles.push_back(i);
     }
-    pWorld->m_shapeMatchingConstraints.emplace_back( PBD::CShapeMatchingConstraint<>::Ptr(
-            new PBD::CShapeMatchingConstraint<>(particles)
+    pWorld->m_shapeMatchingConstraints.emplace_back( typename PBD::CShapeMatchingConstraint<T_real>::Ptr(
+            new PBD::CShapeMatchingConstraint<T_real>(&pWorld->m_particles, particles)
     ));
 
     //USING DISTANCE CONSTRAINTS
@@ -49,17 +54,11 @@ void addParticleSystemInternalConstraints(
 //    {
 //        for (size_t j=i; j<partIdxEnd; ++j)
 //        {
-//            CParticle<>* p1 = pWorld->m_particles[i].get();
-//            CParticle<>* p2 = pWorld->m_particles[j].get();
-//            T_real distance = p1->m_size + p1->m_size + PBD::constraintEpsilon;
+//            T_real distance = pWorld->m_particles.m_size[i] + pWorld->m_particles.m_size[i] + PBD::constraintEpsilon;
 //
-//            if( (p1->m_position - p2->m_position).norm() <= distance )
+//            if( (pWorld->m_particles.m_position[i] - pWorld->m_particles.m_position[j]).norm() <= distance )
 //
-//                pWorld->m_permanentConstraints.emplace_back(
-//                        CConstantDistanceConstraint<>::Ptr(
-//                                new CConstantDistanceConstraint<T_real>(p1,p2)
-//                        )
-//                );
+//                pWorld->m_permanentConstraints.m_distance.emplace_back(pWorld->m_particles,i,j);
 //        }
 //    }
 
@@ -67,27 +66,47 @@ void addParticleSystemInternalConstraints(
 
 
 
+/// Values visited by for(double x=begin; x<end; x+=step), so the creators can count their particles before placing them.
+inline std::vector<double> gridCoordinates(const double& begin, const double& end, const double& step)
+{
+    std::vector<double> values;
+    for (double x=begin; x<end; x+=step)
+    {
+        values.push_back(x);
+    }
+    return values;
+}
+
+
+
 template<typename T_real=double>
 void createParticleSystemSolidCube(
         const vec3::Vector3<T_real>& pos,
         const vec3::Vector3<T_real>& dim,
-        PBD::CWorld* pWorld,
+        PBD::CWorld<T_real>* pWorld,
         T_real partSize=T_real(0.05),
         T_real partWeigth=T_real(0.01),
         size_t partGroup=0)
 {
     T_real epsilon = 0.001;
 
-    size_t partIdxIni = pWorld->m_particles.size();
+    //Count first, then place the particles of the object contiguously in the store
+    const std::vector<double> is = gridCoordinates(0, dim(0), partSize+epsilon);
+    const std::vector<double> js = gridCoordinates(0, dim(1), partSize+epsilon);
+    const std::vector<double> ks = gridCoordinates(0, dim(2), partSize+epsilon);
 
-    for(double i=0; i<dim(0); i+=partSize+epsilon )
+    PBD::CParticleStore<T_real>& store = pWorld->m_particles;
+    size_t partIdxIni = store.appendBlock(is.size()*js.size()*ks.size(), partWeigth, partSize*2, partGroup);
+    size_t idx = partIdxIni;
+    for (const double& i:is)
     {
-        for(double j=0; j<dim(1); j+=partSize+epsilon )
+        for (const double& j:js)
         {
-            for (double k = 0; k < dim(2); k+= partSize+epsilon)
+            for (const double& k:ks)
             {
-                pWorld->m_particles.emplace_back( PBD::CParticle<>::Ptr(
-                        new PBD::CParticle<T_real>(i+pos(0),j+pos(1),k+pos(2),partWeigth,partSize*2,partGroup)));
+                store.m_position[idx] = Eigen::Matrix<T_real,3,1>(T_real(i+pos(0)), T_real(j+pos(1)), T_real(k+pos(2)));
+                store.m_predPosition[idx] = store.m_position[idx];
+                ++idx;
             }
         }
     }
@@ -106,24 +125,44 @@ template<typename T_real=double>
 void createParticleSystemSolidSphere(
         const vec3::Vector3<T_real>& pos,
         const T_real& radius,
-        PBD::CWorld* pWorld,
+        PBD::CWorld<T_real>* pWorld,
         T_real partSize=T_real(0.05),
         T_real partWeigth=T_real(0.01),
         size_t partGroup=0)
 {
     T_real epsilon = 0.001;
 
-    size_t partIdxIni = pWorld->m_particles.size();
+    //Count first, then place the particles of the object contiguously in the store
+    const std::vector<double> cs = gridCoordinates(-radius, radius, partSize+epsilon);
+    auto inside = [&radius](const double& i, const double& j, const double& k) { return std::sqrt(i*i+j*j+k*k) <= radius; };
+
+    size_t count = 0;
+    for (const double& i:cs)
+    {
+        for (const double& j:cs)
+        {
+            for (const double& k:cs)
+            {
+                count += inside(i,j,k);
+            }
+        }
+    }
 
-    for(double i=-radius; i<radius; i+=partSize+epsilon )
+    PBD::CParticleStore<T_real>& store = pWorld->m_particles;
+    size_t partIdxIni = store.appendBlock(count, partWeigth, partSize*2, partGroup);
+    size_t idx = partIdxIni;
+    for (const double& i:cs)
     {
-        for(double j=-radius; j<radius; j+=partSize+epsilon )
+        for (const double& j:cs)
         {
-            for (double k =-radius; k < radius; k+= partSize+epsilon)
+            for (const double& k:cs)
             {
-                if (std::sqrt(i*i+j*j+k*k) <= radius)
-                pWorld->m_particles.emplace_back( PBD::CParticle<>::Ptr(
-                        new PBD::CParticle<T_real>(i+pos(0),j+pos(1),k+pos(2),partWeigth,partSize*2,partGroup)));
+                if (inside(i,j,k))
+                {
+                    store.m_position[idx] = Eigen::Matrix<T_real,3,1>(T_real(i+pos(0)), T_real(j+pos(1)), T_real(k+pos(2)));
+                    store.m_predPosition[idx] = store.m_position[idx];
+                    ++idx;
+                }
             }
         }
     }
@@ -141,76 +180,200 @@ void createParticleSystemSolidSphere(
 
 
 
+/**
+ * Voxelize a point set with cells of partSize and create one particle per solid cell (surface and enclosed interior).
+ * T_points is any random access range of 3D points with size() and operator[] (a std::vector or an in-place
+ * CStridedPointView). If pCache is given the voxels and the shape-matching rest configuration are stored in it.
+ */
+template<typename T_real=double, typename T_points>
+void createParticleSystemFromPoints(
+        const vec3::Vector3<T_real>& pos,
+        const T_points& points,
+        PBD::CWorld<T_real>* pWorld,
+        T_real partSize=T_real(0.05),
+        T_real partWeigth=T_real(0.01),
+        size_t partGroup=0,
+        const PBD::CVoxelCache* pCache=nullptr)
+{
+    PBD::CVoxelizer<T_real> voxelizer(partSize);
+    voxelizer.voxelize(points);
+
+    _GENERIC_DEBUG_("Voxels: " + std::to_string(voxelizer.size()) +
+                    " (" + std::to_string(voxelizer.getNumSurfaceVoxels()) + " on the surface)");
+
+    const Eigen::Matrix<T_real,3,1> offset(pos(0),pos(1),pos(2));
+    size_t partIdxIni = pWorld->m_particles.size();
+    voxelizer.emitParticles(pWorld->m_particles, offset, partWeigth, partSize*2, partGroup);
+    size_t partIdxEnd = pWorld->m_particles.size();
+
+    std::cout << "Loaded " << partIdxEnd -partIdxIni << " particles" << std::endl;
+
+    //Add internal distance constraints to mantain structure
+    size_t numShapeMatching = pWorld->m_shapeMatchingConstraints.size();
+    if (partWeigth != 0)
+    {
+        addParticleSystemInternalConstraints(pWorld, partIdxIni, partIdxEnd);
+    }
+
+    std::cout << "Created constraints." << std::endl;
+
+    if (pCache)
+    {
+        std::vector<double> centers;
+        centers.reserve(3 * voxelizer.size());
+        for (const auto& k:voxelizer.getVoxels())
+        {
+            const Eigen::Matrix<T_real,3,1> c = voxelizer.getCenter(k);
+            centers.insert(centers.end(), {double(c(0)), double(c(1)), double(c(2))});
+        }
+
+        if (pWorld->m_shapeMatchingConstraints.size() > numShapeMatching)
+        {
+            const auto& pShapeMatching = pWorld->m_shapeMatchingConstraints.back();
+            const Eigen::Vector3d restCoM = (pShapeMatching->getCoM() - offset).template cast<double>();
+            const Eigen::Matrix3d restCovariance = pShapeMatching->getRestCovariance().template cast<double>();
+            const Eigen::Matrix3d restCovMat = pShapeMatching->getCovMat().template cast<double>();
+            pCache->store(centers.data(), voxelizer.size(), &restCoM, &restCovariance, &restCovMat);
+        }
+        else
+        {
+            pCache->store(centers.data(), voxelizer.size());
+        }
+    }
+}
+
+
+
+/**
+ * Create a particle system from a loaded voxel cache entry. The cached shape-matching rest configuration is used
+ * when there is one, so neither the voxelization nor the rest frame are recomputed.
+ */
+template<typename T_real=double>
+void createParticleSystemFromVoxelCache(
+        const vec3::Vector3<T_real>& pos,
+        const PBD::CVoxelCache& cache,
+        PBD::CWorld<T_real>* pWorld,
+        T_real partSize=T_real(0.05),
+        T_real partWeigth=T_real(0.01),
+        size_t partGroup=0)
+{
+    const Eigen::Matrix<T_real,3,1> offset(pos(0),pos(1),pos(2));
+    PBD::CParticleStore<T_real>& store = pWorld->m_particles;
+    size_t partIdxIni = store.appendBlock(cache.getNumParticles(), partWeigth, partSize*2, partGroup);
+    for (size_t i=0; i<cache.getNumParticles(); ++i)
+    {
+        store.m_position[partIdxIni + i] = cache.getCenter(i).cast<T_real>() + offset;
+        store.m_predPosition[partIdxIni + i] = store.m_position[partIdxIni + i];
+    }
+    size_t partIdxEnd = store.size();
+
+    std::cout << "Loaded " << partIdxEnd -partIdxIni << " particles from cache " << cache.getPath() << std::endl;
+
+    if (partWeigth == 0) return;
+    if (pWorld->m_rigidBodyFastPath || !cache.hasRestData())
+    {
+        addParticleSystemInternalConstraints(pWorld, partIdxIni, partIdxEnd);
+        return;
+    }
+
+    std::vector< size_t > particles;
+    for (size_t i=partIdxIni; i<partIdxEnd ; ++i) {
+        particles.push_back(i);
+    }
+    pWorld->m_shapeMatchingConstraints.emplace_back( typename PBD::CShapeMatchingConstraint<T_real>::Ptr(
+            new PBD::CShapeMatchingConstraint<T_real>(&pWorld->m_particles, particles,
+                                                      cache.getRestCoM().cast<T_real>() + offset,
+                                                      cache.getRestCovariance().cast<T_real>(),
+                                                      cache.getRestCovMat().cast<T_real>())
+    ));
+}
+
+
+
 template<typename T_real=double>
 void createParticleSystemFromASCIIXYZPointCloud(
         const vec3::Vector3<T_real>& pos,
         const std::string& filename,
-        PBD::CWorld* pWorld,
+        PBD::CWorld<T_real>* pWorld,
         T_real partSize=T_real(0.05),
         T_real partWeigth=T_real(0.01),
         size_t partGroup=0,
         T_real scale = T_real(1.0))
 {
-    std::ifstream infile(filename);
-    if ( !infile.is_open() )
+    //Voxelized objects are cached by file content, scale and particle size
+    PBD::CVoxelCache cache(filename, scale, partSize);
+    if (cache.load())
     {
+        createParticleSystemFromVoxelCache(pos, cache, pWorld, partSize, partWeigth, partGroup);
         return;
     }
 
-    std::cout << "Creating particle system from file: " << filename << std::endl;
-
-    size_t partIdxIni = pWorld->m_particles.size();
-    std::string line;
-    HCD::TOctree< T_real , HCD::TPointSetNode< T_real > , T_real > Octree;
-    while ( std::getline(infile, line)  )
+    //Parse the whole file first (memory-mapped, multithreaded), then voxelize the points
+    std::vector< Eigen::Matrix<T_real,3,1> > points;
+    double pointsPerSecond = 0;
+    if ( !PBD::readASCIIXYZPointCloud<T_real>(filename, points, scale, &pointsPerSecond) )
     {
-        std::stringstream lineStream;
-        lineStream << line;
-        T_real x,y,z;
-        lineStream >> x;
-        lineStream >> y;
-        lineStream >> z;
-        //TODO: Solid voxelization. Add internal voxels to the tree.
-        //_GENERIC_DEBUG_("Add particle [" + std::to_string(x) + " , "+ std::to_string(y) + " , "+ std::to_string(z) + "] ");
-        //Construct and octree with the particle size
-        HCD::TVector3D<T_real> point (x * scale,y * scale,z * scale);
-        Octree.Insert(point, partSize);
-        //Octree.Insert(x,y,z, partSize);   //TODO: Tell David this does not work in the HCD version I have
+        return;
     }
 
-    std::deque< HCD::TOctreeNode< T_real , HCD::TPointSetNode< T_real > >* > Nodes = Octree.GetNodes();
+    std::cout << "Creating particle system from file: " << filename << std::endl;
+    std::cout << "Parsed " << points.size() << " points (" << pointsPerSecond << " points/s)" << std::endl;
+
+    createParticleSystemFromPoints(pos, points, pWorld, partSize, partWeigth, partGroup, &cache);
+}
 
-    _GENERIC_DEBUG_("Octree nodes loaded: " + std::to_string(Nodes.size()));
 
 
-    for (auto pOctreeNode : Nodes)
+/**
+ * Create a particle system from a binary point cloud without parsing or copying it: the file is memory-mapped and the
+ * vertex positions are read in place while voxelizing. Binary PLY files (little or big endian, any scalar type, extra
+ * vertex properties skipped by the stride) are detected by their header. Any other file is read as raw float32
+ * records of rawStride bytes, with an optional header of rawHeaderBytes and x, y, z stored consecutively at rawOffset.
+ */
+template<typename T_real=double>
+void createParticleSystemFromBinaryPointCloud(
+        const vec3::Vector3<T_real>& pos,
+        const std::string& filename,
+        PBD::CWorld<T_real>* pWorld,
+        T_real partSize=T_real(0.05),
+        T_real partWeigth=T_real(0.01),
+        size_t partGroup=0,
+        T_real scale = T_real(1.0),
+        size_t rawStride = 3*sizeof(float),
+        size_t rawOffset = 0,
+        size_t rawHeaderBytes = 0)
+{
+    uint64_t layoutKey = PBD::CVoxelCache::hashCombine(PBD::CVoxelCache::hashCombine(rawStride, rawOffset), rawHeaderBytes);
+    PBD::CVoxelCache cache(filename, scale, partSize, layoutKey);
+    if (cache.load())
     {
-        if (pOctreeNode->IsOuter())
-        {
-            T_real x = pOctreeNode->GetCenter().m_X;
-            T_real y = pOctreeNode->GetCenter().m_Y;
-            T_real z = pOctreeNode->GetCenter().m_Z;
-
-            pWorld->m_particles.emplace_back(
-                    PBD::CParticle<>::Ptr(
-                            new PBD::CParticle<T_real>(x+pos(0),y+pos(1),z+pos(2),partWeigth,partSize*2,partGroup)
-                    )
-            );
-        }
+        createParticleSystemFromVoxelCache(pos, cache, pWorld, partSize, partWeigth, partGroup);
+        return;
     }
 
-    size_t partIdxEnd = pWorld->m_particles.size();
-
-    std::cout << "Loaded " << partIdxEnd -partIdxIni << " particles" << std::endl;
+    PBD::CMappedFile file(filename);
+    if (!file.isOpen())
+    {
+        _GENERIC_ERROR_("Unable to open file: " + filename);
+        return;
+    }
 
-    //Add internal distance constraints to mantain structure
-    if (partWeigth != 0)
+    PBD::CStridedPointView<T_real> points;
+    const bool isPLY = file.size() >= 3 && std::string(file.data(), 3) == "ply";
+    bool valid = isPLY ?
+                 PBD::parseBinaryPLYHeader<T_real>(file.data(), file.size(), points) :
+                 PBD::parseRawFloat32Layout<T_real>(file.data(), file.size(), points, rawStride, rawOffset, rawHeaderBytes);
+    if (!valid)
     {
-        addParticleSystemInternalConstraints(pWorld, partIdxIni, partIdxEnd);
+        _GENERIC_ERROR_("Unsupported binary point cloud layout: " + filename);
+        return;
     }
+    points.m_scale = scale;
 
-    std::cout << "Created constraints." << std::endl;
+    std::cout << "Creating particle system from file: " << filename << std::endl;
+    std::cout << "Mapped " << points.size() << (isPLY ? " PLY" : " raw") << " points" << std::endl;
 
+    createParticleSystemFromPoints(pos, points, pWorld, partSize, partWeigth, partGroup, &cache);
 }
 
 
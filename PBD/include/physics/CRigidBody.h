@@ -0,0 +1,168 @@
+#ifndef PBD_CRIGIDBODY_H
+#define PBD_CRIGIDBODY_H
+
+#include <memory>
+#include <vector>
+#include <cmath>
+#include <Eigen/Dense>
+#include <physics/CParticle.hpp>
+#include <physics/CParticleStore.h>
+#include <physics/RotationExtraction.h>
+
+namespace PBD {
+
+/**
+ * Rigid object made of a contiguous range of particles of a CParticleStore.
+ *
+ * The body integrates a single 6-DOF state (CoM position, orientation and their velocities). Its particles are not
+ * integrated: their predicted positions are generated from the body state when something may touch them, the contact
+ * solver moves them as usual and the corrections are folded back into the body with a rigid fit (translation of the
+ * CoM plus the rotation extracted from the deformation matrix, warm started with the current orientation).
+ *
+ * The particles must all have a positive mass (see CWorld::addRigidBody): the body divides by its mass.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1>, typename T_quaternion=Eigen::Quaternion<T_real>, typename T_matrix=Eigen::Matrix<T_real,3,3> >
+class CRigidBody
+{
+public:
+    typedef std::shared_ptr< CRigidBody > Ptr;
+
+    typedef const std::shared_ptr< CRigidBody > ConstPtr;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+public:
+    CRigidBody(PBD::CParticleStore<T_real>* pStore, const size_t& partIdxIni, const size_t& partIdxEnd):
+            m_pStore(pStore),
+            m_idxIni(partIdxIni),
+            m_idxEnd(partIdxEnd),
+            m_velocity(T_vector(0,0,0)),
+            m_angularVelocity(T_vector(0,0,0)),
+            m_extForce(T_vector(0,0,0)),
+            m_mass(0),
+            m_radius(0),
+            m_isolated(false)
+    {
+        //Mass properties and CoM of the initial configuration
+        m_position = T_vector(0,0,0);
+        for (size_t i=m_idxIni; i<m_idxEnd; ++i)
+        {
+            m_mass += pStore->m_mass[i];
+            m_position += pStore->m_position[i] * pStore->m_mass[i];
+        }
+        m_position /= m_mass;
+        m_predPosition = m_position;
+        m_orientation.setIdentity();
+        m_predOrientation.setIdentity();
+
+        //The initial configuration defines the body frame
+        for (size_t i=m_idxIni; i<m_idxEnd; ++i)
+        {
+            m_localPositions.push_back(pStore->m_position[i] - m_position);
+            m_radius = std::max(m_radius, m_localPositions.back().norm() + pStore->m_size[i] * T_real(0.5));
+        }
+    }
+
+    ~CRigidBody() = default;
+
+    /// Predict the body state after timeStep under gravity and the body external force.
+    void integrate(const T_real& timeStep, const T_vector& gravity)
+    {
+        T_vector vel = m_velocity + (gravity + m_extForce / m_mass) * timeStep;
+        m_predPosition = m_position + vel * timeStep;
+
+        T_real wNorm = m_angularVelocity.norm();
+        if (wNorm > minRotVel)
+        {
+            T_quaternion delta( Eigen::AngleAxis<T_real>(wNorm * timeStep, m_angularVelocity / wNorm) );
+            m_predOrientation = delta * m_orientation;
+            m_predOrientation.normalize();
+        }
+        else
+        {
+            m_predOrientation = m_orientation;
+        }
+    }
+
+    /// Write the predicted particle positions from the predicted body state.
+    void generateParticles()
+    {
+        const T_matrix R = m_predOrientation.toRotationMatrix();
+        for (size_t i=m_idxIni; i<m_idxEnd; ++i)
+        {
+            m_pStore->m_predPosition[i] = m_predPosition + R * m_localPositions[i-m_idxIni];
+        }
+    }
+
+    /// Rigid fit of the (corrected) predicted particle positions into the predicted body state.
+    void foldCorrections(const unsigned int& maxIter=4)
+    {
+        T_vector c(0,0,0);
+        for (size_t i=m_idxIni; i<m_idxEnd; ++i)
+        {
+            c += m_pStore->m_predPosition[i] * m_pStore->m_mass[i];
+        }
+        c /= m_mass;
+
+        T_matrix Apq;
+        Apq.setZero();
+        for (size_t i=m_idxIni; i<m_idxEnd; ++i)
+        {
+            Apq += m_pStore->m_mass[i] * (m_pStore->m_predPosition[i] - c) * m_localPositions[i-m_idxIni].transpose();
+        }
+
+        m_predPosition = c;
+        extractRotation<T_real>(Apq, m_predOrientation, maxIter);
+    }
+
+    /// Derive the body velocities from the predicted state.
+    void updateVelocity(const T_real& timeStep)
+    {
+        m_velocity = ((m_predPosition - m_position) / timeStep) * T_real(PBD::velDamping);
+        Eigen::AngleAxis<T_real> aa( m_predOrientation * m_orientation.inverse() );
+        m_angularVelocity = aa.axis() * aa.angle() / timeStep;
+    }
+
+    /// Make the predicted state the current one.
+    void updatePosition()
+    {
+        m_position = m_predPosition;
+        m_orientation = m_predOrientation;
+    }
+
+    /// Write position, orientation and velocities of every particle from the current body state.
+    void syncParticles()
+    {
+        const T_matrix R = m_orientation.toRotationMatrix();
+        for (size_t i=m_idxIni; i<m_idxEnd; ++i)
+        {
+            T_vector r = R * m_localPositions[i-m_idxIni];
+            m_pStore->m_position[i] = m_position + r;
+            m_pStore->m_predPosition[i] = m_pStore->m_position[i];
+            m_pStore->m_orientation[i] = m_orientation;
+            m_pStore->m_predOrientation[i] = m_orientation;
+            m_pStore->m_velocity[i] = m_velocity + m_angularVelocity.cross(r);
+            m_pStore->m_angularVelocity[i] = m_angularVelocity;
+        }
+    }
+
+    PBD::CParticleStore<T_real>* m_pStore;
+    size_t m_idxIni;                        ///< First particle of the body.
+    size_t m_idxEnd;                        ///< One past the last particle of the body.
+    std::vector<T_vector> m_localPositions; ///< Particle positions in the body frame.
+
+    T_vector m_position;                    ///< CoM position.
+    T_vector m_predPosition;
+    T_quaternion m_orientation;
+    T_quaternion m_predOrientation;
+    T_vector m_velocity;
+    T_vector m_angularVelocity;
+    T_vector m_extForce;                    ///< External force applied at the CoM during the next step.
+    T_real m_mass;
+    T_real m_radius;                        ///< Bounding sphere radius around the CoM.
+    bool m_isolated;                        ///< No contact possible this step: particles are not generated.
+};
+
+}
+
+#endif //PBD_CRIGIDBODY_H
@@ -0,0 +1,428 @@
+#ifndef PBD_CSDFCOLLIDER_H
+#define PBD_CSDFCOLLIDER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <unistd.h>
+#include <Eigen/Dense>
+#include <Common.h>
+#include <io/CMappedFile.h>
+#include <physics/CVoxelizer.h>
+#include <physics/CSpatialHashGrid.h>
+
+namespace PBD
+{
+
+/**
+ * Static collider defined by a signed distance field sampled on a regular grid (negative inside).
+ *
+ * The field is usually built offline (see build() and pbd_sdf_build) and saved to a ".pbdsdf" file: a header followed
+ * by the float distances of the grid nodes, x fastest. load() maps the file and reads the distances in place, so a
+ * large field costs no parsing and its pages are shared by every process using it. Copies of a collider share the
+ * field: each copy only adds its own placement (m_position, m_rotation).
+ *
+ * A query is one trilinear interpolation of the 8 surrounding nodes; the normal is the gradient of the interpolant.
+ * Points outside the grid never collide, so the grid must extend past the surface by at least the particle size.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+class CSDFCollider
+{
+public:
+    typedef Eigen::Matrix<T_real,3,3> T_matrix;
+
+    const static uint32_t version = 1;
+
+    CSDFCollider():
+            m_position(T_vector::Zero()),
+            m_rotation(T_matrix::Identity()),
+            m_values(nullptr),
+            m_origin(T_vector::Zero()),
+            m_cellSize(T_real(1))
+    {
+        m_dims[0] = m_dims[1] = m_dims[2] = 0;
+    }
+
+    ~CSDFCollider() = default;
+
+    /// Map a field written by save(). Returns false (and leaves the collider unchanged) if the file is missing or invalid.
+    bool load(const std::string& filename)
+    {
+        std::shared_ptr<PBD::CMappedFile> file(new PBD::CMappedFile(filename));
+
+        SHeader h;
+        bool valid = file->isOpen() && file->size() >= sizeof(SHeader);
+        if (valid)
+        {
+            std::memcpy(&h, file->data(), sizeof(SHeader));
+            const uint64_t numValues = h.m_dims[0] * h.m_dims[1] * h.m_dims[2];
+            valid = std::memcmp(h.m_magic, "PBDSDF", 7) == 0 && h.m_version == version &&
+                    h.m_dims[0] >= 2 && h.m_dims[1] >= 2 && h.m_dims[2] >= 2 && h.m_cellSize > 0 &&
+                    h.m_valuesOffset >= sizeof(SHeader) && h.m_valuesOffset % alignof(float) == 0 &&
+                    file->size() == h.m_valuesOffset + numValues * sizeof(float);
+        }
+        if (!valid)
+        {
+            _GENERIC_ERROR_("Invalid distance field: " + filename);
+            return false;
+        }
+
+        m_file = file;
+        m_ownedValues.reset();
+        m_values = reinterpret_cast<const float*>(file->data() + h.m_valuesOffset);
+        for (size_t k=0; k<3; ++k) m_dims[k] = size_t(h.m_dims[k]);
+        m_origin = Eigen::Map<const Eigen::Vector3d>(h.m_origin).cast<T_real>();
+        m_cellSize = T_real(h.m_cellSize);
+        return true;
+    }
+
+    /// Write the field. The file is written aside and renamed, so readers never see it partial.
+    bool save(const std::string& filename) const
+    {
+        if (empty()) return false;
+
+        SHeader h;
+        std::memset(&h, 0, sizeof(SHeader));
+        std::memcpy(h.m_magic, "PBDSDF", 7);
+        h.m_version = version;
+        for (size_t k=0; k<3; ++k) h.m_dims[k] = m_dims[k];
+        Eigen::Map<Eigen::Vector3d>(h.m_origin) = m_origin.template cast<double>();
+        h.m_cellSize = double(m_cellSize);
+        h.m_valuesOffset = sizeof(SHeader);
+
+        const std::string tmpPath = filename + ".tmp" + std::to_string(::getpid());
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out) return false;
+            out.write(reinterpret_cast<const char*>(&h), sizeof(SHeader));
+            out.write(reinterpret_cast<const char*>(m_values), std::streamsize(getNumValues() * sizeof(float)));
+            if (!out)
+            {
+                out.close();
+                std::remove(tmpPath.c_str());
+                return false;
+            }
+        }
+        return std::rename(tmpPath.c_str(), filename.c_str()) == 0;
+    }
+
+    /**
+     * Build the field of a point set sampling a closed surface, with nodes at the centers of cubic cells of side
+     * cellSize. The points are voxelized (see CVoxelizer), which gives the inside and outside of the surface, and
+     * the magnitude is the distance of the node to the closest point, so the surface goes through the samples
+     * instead of following the faces of the cells. The grid extends bandCells cells past the solid cells. T_points
+     * is any random access range of 3D points (a std::vector or a CStridedPointView).
+     */
+    template<typename T_points>
+    void build(const T_points& points, const T_real& cellSize, const size_t& bandCells=4)
+    {
+        PBD::CVoxelizer<T_real,T_vector> voxelizer(cellSize);
+        voxelizer.voxelize(points);
+
+        m_file.reset();
+        m_ownedValues.reset();
+        m_values = nullptr;
+        m_dims[0] = m_dims[1] = m_dims[2] = 0;
+        m_cellSize = cellSize;
+        if (voxelizer.size() == 0) return;
+
+        //Solid cells in cell coordinates, and the grid around them
+        typedef Eigen::Matrix<int64_t,3,1> Cell;
+        std::vector<Cell> cells;
+        cells.reserve(voxelizer.size());
+        Cell cellMin = Cell::Constant(std::numeric_limits<int64_t>::max());
+        Cell cellMax = Cell::Constant(std::numeric_limits<int64_t>::min());
+        for (const auto& k:voxelizer.getVoxels())
+        {
+            const T_vector c = voxelizer.getCenter(k) / cellSize;
+            cells.emplace_back(int64_t(std::floor(c(0))), int64_t(std::floor(c(1))), int64_t(std::floor(c(2))));
+            cellMin = cellMin.cwiseMin(cells.back());
+            cellMax = cellMax.cwiseMax(cells.back());
+        }
+        const int64_t band = int64_t(std::max(bandCells, size_t(1)));
+        cellMin -= Cell::Constant(band);
+        cellMax += Cell::Constant(band);
+        for (size_t k=0; k<3; ++k) m_dims[k] = size_t(cellMax(k) - cellMin(k) + 1);
+        m_origin = (cellMin.template cast<T_real>() + T_vector::Constant(T_real(0.5))) * cellSize;
+
+        std::vector<char> solid(getNumValues(), 0);
+        for (const auto& c:cells)
+        {
+            const Cell l = c - cellMin;
+            solid[ index(size_t(l(0)), size_t(l(1)), size_t(l(2))) ] = 1;
+        }
+
+        //Squared distance (in cells) of every node to the closest solid node and to the closest empty node
+        std::vector<double> toSolid(getNumValues());
+        std::vector<double> toEmpty(getNumValues());
+        for (size_t n=0; n<solid.size(); ++n)
+        {
+            toSolid[n] = solid[n] ? 0 : farDistance;
+            toEmpty[n] = solid[n] ? farDistance : 0;
+        }
+        distanceTransform(toSolid);
+        distanceTransform(toEmpty);
+
+        //A node next to the surface is half a cell away from it
+        std::vector<float> cellField(getNumValues());
+        for (size_t n=0; n<solid.size(); ++n)
+        {
+            cellField[n] = solid[n] ? -float((std::sqrt(toEmpty[n]) - 0.5) * cellSize)
+                                    :  float((std::sqrt(toSolid[n]) - 0.5) * cellSize);
+        }
+
+        //The cell field puts the surface on the faces of the solid cells. The magnitude is replaced by the distance
+        //to the closest sample, found by a grid query near the surface and propagated to the other nodes by a
+        //forward and a backward sweep over the 26 neighbours.
+        std::vector<T_vector> samples(points.size());
+        for (size_t i=0; i<points.size(); ++i) samples[i] = points[i];
+        const size_t none = samples.size();
+        std::vector<size_t> closest(getNumValues(), none);
+        std::vector<T_real> closestDistance2(getNumValues(), std::numeric_limits<T_real>::max());
+
+        const T_real bandWidth = 2*cellSize;
+        PBD::CSpatialHashGrid<T_real,T_vector> grid;
+        grid.build(samples, bandWidth);
+        std::vector<size_t> candidates;
+        for (size_t n=0; n<solid.size(); ++n)
+        {
+            if (std::abs(cellField[n]) >= bandWidth) continue;
+
+            const T_vector position = nodePosition(n);
+            candidates.clear();
+            grid.query(position, candidates);
+            for (const auto& c:candidates)
+            {
+                const T_real d2 = (samples[c] - position).squaredNorm();
+                if (d2 < closestDistance2[n])
+                {
+                    closestDistance2[n] = d2;
+                    closest[n] = c;
+                }
+            }
+        }
+
+        auto propagate = [&](const size_t& n, const int& direction)
+        {
+            const int64_t node[3] = { int64_t(n % m_dims[0]), int64_t((n / m_dims[0]) % m_dims[1]), int64_t(n / (m_dims[0]*m_dims[1])) };
+            const T_vector position = nodePosition(n);
+            for (int64_t dz=-1; dz<=1; ++dz)
+            {
+                for (int64_t dy=-1; dy<=1; ++dy)
+                {
+                    for (int64_t dx=-1; dx<=1; ++dx)
+                    {
+                        //Neighbours already visited by the sweep
+                        const int64_t offset = dx + int64_t(m_dims[0]) * (dy + int64_t(m_dims[1]) * dz);
+                        if (offset * direction >= 0) continue;
+
+                        const int64_t x = node[0] + dx, y = node[1] + dy, z = node[2] + dz;
+                        if (x < 0 || y < 0 || z < 0 || x >= int64_t(m_dims[0]) || y >= int64_t(m_dims[1]) || z >= int64_t(m_dims[2])) continue;
+
+                        const size_t c = closest[ index(size_t(x), size_t(y), size_t(z)) ];
+                        if (c == none) continue;
+                        const T_real d2 = (samples[c] - position).squaredNorm();
+                        if (d2 < closestDistance2[n])
+                        {
+                            closestDistance2[n] = d2;
+                            closest[n] = c;
+                        }
+                    }
+                }
+            }
+        };
+        for (size_t n=0; n<solid.size(); ++n) propagate(n, 1);
+        for (size_t n=solid.size(); n-- > 0;) propagate(n, -1);
+
+        //Within a cell of the faces the occupancy does not tell the side of the surface: the node is outside if it
+        //lies on the outer side of its closest sample, along the gradient of the cell field
+        std::shared_ptr< std::vector<float> > values(new std::vector<float>(getNumValues()));
+        for (size_t n=0; n<solid.size(); ++n)
+        {
+            if (closest[n] == none)
+            {
+                (*values)[n] = cellField[n];
+                continue;
+            }
+
+            bool outside = !solid[n];
+            if (std::abs(cellField[n]) <= cellSize)
+            {
+                const size_t node[3] = { n % m_dims[0], (n / m_dims[0]) % m_dims[1], n / (m_dims[0]*m_dims[1]) };
+                T_vector gradient;
+                for (size_t k=0; k<3; ++k)
+                {
+                    size_t lower[3] = { node[0], node[1], node[2] };
+                    size_t upper[3] = { node[0], node[1], node[2] };
+                    if (lower[k] > 0) --lower[k];
+                    if (upper[k] < m_dims[k]-1) ++upper[k];
+                    gradient(k) = cellField[ index(upper[0], upper[1], upper[2]) ] - cellField[ index(lower[0], lower[1], lower[2]) ];
+                }
+                outside = (nodePosition(n) - samples[ closest[n] ]).dot(gradient) > 0;
+            }
+            const float distance = float(std::sqrt(closestDistance2[n]));
+            (*values)[n] = outside ? distance : -distance;
+        }
+        m_ownedValues = values;
+        m_values = values->data();
+    }
+
+    /// Signed distance from p to the surface (negative inside) and outward normal, in world coordinates.
+    T_real signedDistance(const T_vector& p, T_vector& normal, const T_real& /*maxDistance*/=std::numeric_limits<T_real>::max()) const
+    {
+        normal = T_vector::UnitZ();
+        if (!m_values) return std::numeric_limits<T_real>::max();
+
+        const T_vector u = (m_rotation.transpose() * (p - m_position) - m_origin) / m_cellSize;
+        if (!(u(0) >= 0 && u(1) >= 0 && u(2) >= 0 &&
+              u(0) <= T_real(m_dims[0]-1) && u(1) <= T_real(m_dims[1]-1) && u(2) <= T_real(m_dims[2]-1)))
+        {
+            return std::numeric_limits<T_real>::max();
+        }
+
+        const size_t i = std::min(size_t(u(0)), m_dims[0]-2);
+        const size_t j = std::min(size_t(u(1)), m_dims[1]-2);
+        const size_t k = std::min(size_t(u(2)), m_dims[2]-2);
+        const T_real fx = u(0) - T_real(i);
+        const T_real fy = u(1) - T_real(j);
+        const T_real fz = u(2) - T_real(k);
+
+        const size_t n = index(i, j, k);
+        const size_t dy = m_dims[0];
+        const size_t dz = m_dims[0] * m_dims[1];
+        const T_real v000 = m_values[n],         v100 = m_values[n + 1];
+        const T_real v010 = m_values[n + dy],    v110 = m_values[n + dy + 1];
+        const T_real v001 = m_values[n + dz],    v101 = m_values[n + dz + 1];
+        const T_real v011 = m_values[n + dy + dz], v111 = m_values[n + dy + dz + 1];
+
+        //Trilinear interpolation and its gradient
+        const T_real c00 = v000 + (v100 - v000)*fx;
+        const T_real c10 = v010 + (v110 - v010)*fx;
+        const T_real c01 = v001 + (v101 - v001)*fx;
+        const T_real c11 = v011 + (v111 - v011)*fx;
+        const T_real c0 = c00 + (c10 - c00)*fy;
+        const T_real c1 = c01 + (c11 - c01)*fy;
+
+        const T_real gx = ((v100 - v000)*(1-fy) + (v110 - v010)*fy)*(1-fz) + ((v101 - v001)*(1-fy) + (v111 - v011)*fy)*fz;
+        const T_real gy = (c10 - c00)*(1-fz) + (c11 - c01)*fz;
+        const T_real gz = c1 - c0;
+        const T_vector gradient(gx, gy, gz);
+        const T_real norm = gradient.norm();
+        if (norm > 0) normal = m_rotation * (gradient / norm);
+
+        return c0 + (c1 - c0)*fz;
+    }
+
+    bool empty() const { return m_values == nullptr; }
+
+    size_t getNumValues() const { return m_dims[0] * m_dims[1] * m_dims[2]; }
+
+    /// Distance stored at node (i,j,k).
+    T_real getValue(const size_t& i, const size_t& j, const size_t& k) const { return m_values[index(i,j,k)]; }
+
+    const size_t* getDims() const { return m_dims; }
+
+    /// Position of node (0,0,0) in the frame of the field.
+    const T_vector& getOrigin() const { return m_origin; }
+
+    T_real getCellSize() const { return m_cellSize; }
+
+    T_vector m_position;            ///< Placement of the field frame in the world.
+    T_matrix m_rotation;
+
+protected:
+    struct SHeader
+    {
+        char     m_magic[8];
+        uint32_t m_version;
+        uint32_t m_reserved;
+        uint64_t m_dims[3];
+        double   m_origin[3];
+        double   m_cellSize;
+        uint64_t m_valuesOffset;    ///< Offset of the distances from the beginning of the file.
+    };
+
+    static constexpr double farDistance = 1e20;
+
+    size_t index(const size_t& i, const size_t& j, const size_t& k) const
+    {
+        return i + m_dims[0] * (j + m_dims[1] * k);
+    }
+
+    /// Position of node n in the frame of the field.
+    T_vector nodePosition(const size_t& n) const
+    {
+        return m_origin + T_vector(T_real(n % m_dims[0]), T_real((n / m_dims[0]) % m_dims[1]), T_real(n / (m_dims[0]*m_dims[1]))) * m_cellSize;
+    }
+
+    /// 3D squared Euclidean distance transform in place: one 1D pass per axis (Felzenszwalb and Huttenlocher 2012,
+    /// "Distance Transforms of Sampled Functions"). Feature nodes hold 0, the others farDistance.
+    void distanceTransform(std::vector<double>& grid) const
+    {
+        const size_t strides[3] = { 1, m_dims[0], m_dims[0]*m_dims[1] };
+        std::vector<double> f, d, z;
+        std::vector<size_t> v;
+        for (size_t axis=0; axis<3; ++axis)
+        {
+            const size_t n = m_dims[axis];
+            const size_t stride = strides[axis];
+            f.resize(n);
+            d.resize(n);
+            v.resize(n);
+            z.resize(n+1);
+            for (size_t line=0; line<grid.size(); ++line)
+            {
+                //First node of each line along the axis
+                if ((line / stride) % n != 0) continue;
+
+                for (size_t q=0; q<n; ++q) f[q] = grid[line + q*stride];
+
+                //Lower envelope of the parabolas rooted at every node
+                size_t k = 0;
+                v[0] = 0;
+                z[0] = -std::numeric_limits<double>::infinity();
+                z[1] = std::numeric_limits<double>::infinity();
+                for (size_t q=1; q<n; ++q)
+                {
+                    double s;
+                    while ((s = ((f[q] + double(q*q)) - (f[v[k]] + double(v[k]*v[k]))) / (2.0*double(q) - 2.0*double(v[k]))) <= z[k])
+                    {
+                        --k;
+                    }
+                    ++k;
+                    v[k] = q;
+                    z[k] = s;
+                    z[k+1] = std::numeric_limits<double>::infinity();
+                }
+
+                k = 0;
+                for (size_t q=0; q<n; ++q)
+                {
+                    while (z[k+1] < double(q)) ++k;
+                    const double dq = double(q) - double(v[k]);
+                    d[q] = dq*dq + f[v[k]];
+                }
+
+                for (size_t q=0; q<n; ++q) grid[line + q*stride] = d[q];
+            }
+        }
+    }
+
+    std::shared_ptr<const PBD::CMappedFile> m_file;             ///< Mapping of a loaded field.
+    std::shared_ptr<const std::vector<float> > m_ownedValues;   ///< Distances of a built field.
+    const float* m_values;          ///< Distance of every node, x fastest.
+    size_t   m_dims[3];             ///< Number of nodes per axis.
+    T_vector m_origin;
+    T_real   m_cellSize;
+};
+
+}
+
+#endif //PBD_CSDFCOLLIDER_H
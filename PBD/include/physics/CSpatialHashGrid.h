@@ -0,0 +1,120 @@
+#ifndef PBD_CSPATIALHASHGRID_H
+#define PBD_CSPATIALHASHGRID_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <Eigen/Dense>
+
+namespace PBD
+{
+
+/**
+ * Uniform spatial hash (cell list) used as collision broad phase.
+ *
+ * Points are binned into cubic cells of size m_cellSize. The cells are hashed into a table with a power of two
+ * number of buckets and the point indices are stored contiguously per bucket (counting sort), so building the grid
+ * is O(n) and a neighbourhood query only visits the 27 buckets around the query point.
+ * Different cells may share a bucket, so queries can return points that are not in the neighbourhood. Callers must
+ * run their own narrow phase test on the candidates.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+class CSpatialHashGrid
+{
+public:
+    CSpatialHashGrid() : m_cellSize(T_real(1)), m_cellSizeInv(T_real(1)), m_tableMask(0) {}
+
+    ~CSpatialHashGrid() = default;
+
+    /// Bin the given points in cells of size cellSize. Buffers are reused between calls.
+    void build(const std::vector<T_vector>& points, const T_real& cellSize)
+    {
+        m_cellSize = cellSize;
+        m_cellSizeInv = T_real(1) / cellSize;
+
+        //Table size: next power of two above twice the number of points
+        size_t tableSize = 1;
+        while (tableSize < 2*points.size()) tableSize <<= 1;
+        m_tableMask = tableSize - 1;
+
+        m_bucketStart.assign(tableSize + 1, 0);
+        m_pointBucket.resize(points.size());
+        m_entries.resize(points.size());
+
+        //Count the points per bucket
+        for (size_t i=0; i<points.size(); ++i)
+        {
+            int x,y,z;
+            getCell(points[i],x,y,z);
+            size_t b = hashCell(x,y,z);
+            m_pointBucket[i] = b;
+            ++m_bucketStart[b+1];
+        }
+
+        //Prefix sum to obtain the first entry of each bucket
+        for (size_t b=0; b<tableSize; ++b)
+        {
+            m_bucketStart[b+1] += m_bucketStart[b];
+        }
+
+        //Scatter the point indices. Iterating in order keeps the indices of a bucket sorted.
+        m_bucketFill.assign(m_bucketStart.begin(), m_bucketStart.end()-1);
+        for (size_t i=0; i<points.size(); ++i)
+        {
+            m_entries[ m_bucketFill[ m_pointBucket[i] ]++ ] = i;
+        }
+    }
+
+    /// Append to candidates the indices of the points binned in the 27 cells around p. May contain duplicates.
+    void query(const T_vector& p, std::vector<size_t>& candidates) const
+    {
+        int cx,cy,cz;
+        getCell(p,cx,cy,cz);
+
+        for (int x=cx-1; x<=cx+1; ++x)
+        {
+            for (int y=cy-1; y<=cy+1; ++y)
+            {
+                for (int z=cz-1; z<=cz+1; ++z)
+                {
+                    size_t b = hashCell(x,y,z);
+                    candidates.insert(candidates.end(),
+                                      m_entries.begin() + m_bucketStart[b],
+                                      m_entries.begin() + m_bucketStart[b+1]);
+                }
+            }
+        }
+    }
+
+    void getCell(const T_vector& p, int& x, int& y, int& z) const
+    {
+        x = static_cast<int>( std::floor(p(0) * m_cellSizeInv) );
+        y = static_cast<int>( std::floor(p(1) * m_cellSizeInv) );
+        z = static_cast<int>( std::floor(p(2) * m_cellSizeInv) );
+    }
+
+    size_t hashCell(const int& x, const int& y, const int& z) const
+    {
+        //Teschner et al. 2003, "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+        uint64_t h = (uint64_t(uint32_t(x)) * 73856093u) ^
+                     (uint64_t(uint32_t(y)) * 19349663u) ^
+                     (uint64_t(uint32_t(z)) * 83492791u);
+        return size_t(h) & m_tableMask;
+    }
+
+    T_real getCellSize() const { return m_cellSize; }
+
+protected:
+    T_real m_cellSize;
+    T_real m_cellSizeInv;
+    size_t m_tableMask;
+    std::vector<size_t> m_bucketStart;      ///< First entry of each bucket (size: table size + 1).
+    std::vector<size_t> m_bucketFill;       ///< Scratch insertion cursor per bucket.
+    std::vector<size_t> m_pointBucket;      ///< Bucket of each binned point.
+    std::vector<size_t> m_entries;          ///< Point indices sorted by bucket.
+};
+
+}
+
+#endif //PBD_CSPATIALHASHGRID_H
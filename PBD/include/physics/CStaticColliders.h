@@ -0,0 +1,256 @@
+#ifndef PBD_CSTATICCOLLIDERS_H
+#define PBD_CSTATICCOLLIDERS_H
+
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <physics/CSDFCollider.h>
+#include <physics/CTriangleMeshCollider.h>
+
+namespace PBD
+{
+
+/**
+ * Infinite plane. The half space behind the normal is solid.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+struct SPlaneCollider
+{
+    SPlaneCollider(const T_vector& point, const T_vector& normal) :
+            m_normal(normal.normalized()),
+            m_offset(m_normal.dot(point))
+    {}
+
+    /// Signed distance from p to the surface (negative inside) and outward normal of the closest surface point. Shapes
+    /// may report numeric max for points farther than maxDistance; the analytic ones always answer exactly.
+    T_real signedDistance(const T_vector& p, T_vector& normal, const T_real& /*maxDistance*/=std::numeric_limits<T_real>::max()) const
+    {
+        normal = m_normal;
+        return m_normal.dot(p) - m_offset;
+    }
+
+    T_vector m_normal;
+    T_real   m_offset;          ///< Distance of the plane to the origin along the normal.
+};
+
+/**
+ * Solid oriented box.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+struct SBoxCollider
+{
+    typedef Eigen::Matrix<T_real,3,3> T_matrix;
+
+    SBoxCollider(const T_vector& center, const T_vector& halfExtents, const T_matrix& rotation = T_matrix::Identity()) :
+            m_center(center),
+            m_halfExtents(halfExtents),
+            m_rotation(rotation)
+    {}
+
+    T_real signedDistance(const T_vector& p, T_vector& normal, const T_real& /*maxDistance*/=std::numeric_limits<T_real>::max()) const
+    {
+        const T_vector local = m_rotation.transpose() * (p - m_center);
+        const T_vector q = local.cwiseAbs() - m_halfExtents;
+        const T_vector sign = local.unaryExpr([](const T_real& x){ return x < 0 ? T_real(-1) : T_real(1); });
+
+        //Outside: distance to the closest point of the surface
+        const T_vector outside = q.cwiseMax(T_real(0));
+        const T_real distance = outside.norm();
+        if (distance > 0)
+        {
+            normal = m_rotation * (outside.cwiseProduct(sign) / distance);
+            return distance;
+        }
+
+        //Inside: the closest face is the one with the largest (least negative) q
+        int axis;
+        const T_real depth = q.maxCoeff(&axis);
+        normal = m_rotation.col(axis) * sign(axis);
+        return depth;
+    }
+
+    T_vector m_center;
+    T_vector m_halfExtents;
+    T_matrix m_rotation;        ///< Box axes in world frame (columns).
+};
+
+/**
+ * Solid capsule: points within m_radius of the segment [m_p0, m_p1].
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+struct SCapsuleCollider
+{
+    SCapsuleCollider(const T_vector& p0, const T_vector& p1, const T_real& radius) :
+            m_p0(p0),
+            m_p1(p1),
+            m_radius(radius)
+    {}
+
+    T_real signedDistance(const T_vector& p, T_vector& normal, const T_real& /*maxDistance*/=std::numeric_limits<T_real>::max()) const
+    {
+        const T_vector axis = m_p1 - m_p0;
+        const T_real length2 = axis.squaredNorm();
+        const T_real t = length2 > 0 ? std::min(std::max((p - m_p0).dot(axis) / length2, T_real(0)), T_real(1)) : T_real(0);
+        const T_vector offset = p - (m_p0 + t*axis);
+        const T_real distance = offset.norm();
+        if (distance > 0)
+        {
+            normal = offset / distance;
+        }
+        else
+        {
+            //On the axis: push along any direction orthogonal to it
+            normal = length2 > 0 ? axis.unitOrthogonal() : T_vector::UnitZ();
+        }
+        return distance - m_radius;
+    }
+
+    T_vector m_p0;
+    T_vector m_p1;
+    T_real   m_radius;
+};
+
+/**
+ * Height grid over the xy plane, solid below the surface. Sample (i,j) is at m_origin + (i,j,0)*m_spacing raised by
+ * m_heights[j*m_numX + i]; heights are interpolated bilinearly. The distance is measured along the normal of the
+ * interpolated surface, which is exact on flat cells. Points outside the grid footprint never collide.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+struct SHeightfieldCollider
+{
+    SHeightfieldCollider(const T_vector& origin, const T_real& spacing, const size_t& numX, const size_t& numY,
+                         const std::vector<T_real>& heights) :
+            m_origin(origin),
+            m_spacing(spacing),
+            m_numX(numX),
+            m_numY(numY),
+            m_heights(heights)
+    {
+        m_heights.resize(numX*numY, T_real(0));
+    }
+
+    T_real signedDistance(const T_vector& p, T_vector& normal, const T_real& /*maxDistance*/=std::numeric_limits<T_real>::max()) const
+    {
+        normal = T_vector::UnitZ();
+        if (m_numX < 2 || m_numY < 2) return std::numeric_limits<T_real>::max();
+
+        const T_real x = (p(0) - m_origin(0)) / m_spacing;
+        const T_real y = (p(1) - m_origin(1)) / m_spacing;
+        if (!(x >= 0 && y >= 0 && x <= T_real(m_numX-1) && y <= T_real(m_numY-1))) return std::numeric_limits<T_real>::max();
+
+        const size_t i = std::min(size_t(x), m_numX-2);
+        const size_t j = std::min(size_t(y), m_numY-2);
+        const T_real fx = x - T_real(i);
+        const T_real fy = y - T_real(j);
+        const T_real h00 = m_heights[j*m_numX + i];
+        const T_real h10 = m_heights[j*m_numX + i+1];
+        const T_real h01 = m_heights[(j+1)*m_numX + i];
+        const T_real h11 = m_heights[(j+1)*m_numX + i+1];
+
+        const T_real height = (h00*(1-fx) + h10*fx)*(1-fy) + (h01*(1-fx) + h11*fx)*fy;
+        const T_real dhdx = ((h10 - h00)*(1-fy) + (h11 - h01)*fy) / m_spacing;
+        const T_real dhdy = ((h01 - h00)*(1-fx) + (h11 - h10)*fx) / m_spacing;
+
+        normal = T_vector(-dhdx, -dhdy, 1).normalized();
+        return (p(2) - m_origin(2) - height) * normal(2);
+    }
+
+    T_vector m_origin;
+    T_real   m_spacing;
+    size_t   m_numX;
+    size_t   m_numY;
+    std::vector<T_real> m_heights;      ///< Row major, m_numX samples per row.
+};
+
+/**
+ * Static collision geometry of a world, segregated by shape type like CConstraintStore. Particles are projected out
+ * of the shapes directly: static geometry adds no particles, no pair tests and no constraints.
+ *
+ * Adding a shape: give it a signedDistance(p, normal, maxDistance) method, add its array and list the array in
+ * forEachArray.
+ */
+template<typename T_real=double>
+class CStaticColliders
+{
+public:
+    typedef Eigen::Matrix<T_real,3,1> T_vector;
+    typedef PBD::SPlaneCollider<T_real> Plane;
+    typedef PBD::SBoxCollider<T_real> Box;
+    typedef PBD::SCapsuleCollider<T_real> Capsule;
+    typedef PBD::SHeightfieldCollider<T_real> Heightfield;
+    typedef PBD::CSDFCollider<T_real> DistanceField;
+    typedef PBD::CTriangleMeshCollider<T_real> TriangleMesh;
+
+    CStaticColliders() = default;
+
+    ~CStaticColliders() = default;
+
+    /// Call f(array) on the array of each shape type, always in the same order.
+    template<typename T_function>
+    void forEachArray(T_function f)
+    {
+        f(m_planes);
+        f(m_boxes);
+        f(m_capsules);
+        f(m_heightfields);
+        f(m_distanceFields);
+        f(m_triangleMeshes);
+    }
+
+    template<typename T_function>
+    void forEachArray(T_function f) const
+    {
+        f(m_planes);
+        f(m_boxes);
+        f(m_capsules);
+        f(m_heightfields);
+        f(m_distanceFields);
+        f(m_triangleMeshes);
+    }
+
+    /// Call f(collider) on every collider, array after array.
+    template<typename T_function>
+    void forEach(T_function f) const
+    {
+        forEachArray([&f](const auto& colliders)
+        {
+            for (const auto& c:colliders) f(c);
+        });
+    }
+
+    /// True if some collider is closer than distance to p (or contains it).
+    bool isWithin(const T_vector& p, const T_real& distance) const
+    {
+        bool within = false;
+        T_vector normal;
+        forEach([&](const auto& c){ within = within || c.signedDistance(p, normal, distance) < distance; });
+        return within;
+    }
+
+    size_t size() const
+    {
+        size_t n = 0;
+        forEachArray([&n](const auto& colliders){ n += colliders.size(); });
+        return n;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    void clear()
+    {
+        forEachArray([](auto& colliders){ colliders.clear(); });
+    }
+
+    std::vector<Plane>       m_planes;
+    std::vector<Box>         m_boxes;
+    std::vector<Capsule>     m_capsules;
+    std::vector<Heightfield> m_heightfields;
+    std::vector<DistanceField> m_distanceFields;
+    std::vector<TriangleMesh>  m_triangleMeshes;
+};
+
+}
+
+#endif //PBD_CSTATICCOLLIDERS_H
@@ -0,0 +1,51 @@
+#ifndef PBD_CSTEPSTATS_H
+#define PBD_CSTEPSTATS_H
+
+#include <cstddef>
+
+//Define _PBD_DISABLE_STEP_STATS_ to compile the step instrumentation out. CWorld::getStepStats() then stays zeroed.
+#ifndef _PBD_DISABLE_STEP_STATS_
+    #define _PBD_STEP_STATS_(statement) statement
+#else
+    #define _PBD_STEP_STATS_(statement)
+#endif
+
+namespace PBD
+{
+
+/**
+ * Timings and solver statistics of the last CWorld::step(). Times are wall clock seconds.
+ */
+struct CStepStats
+{
+    double m_preStabilizationTime = 0;          ///< Contact detection and solve on the current positions.
+    double m_integrationTime = 0;               ///< Gravity, position prediction and rigid body particles.
+    double m_collisionDetectionTime = 0;        ///< Broad and narrow phase on the predicted positions.
+    double m_contactSolveTime = 0;              ///< Contact and permanent constraint projection.
+    double m_shapeMatchingTime = 0;
+    double m_velocityUpdateTime = 0;            ///< Velocities, positions and islands.
+    double m_totalTime = 0;
+
+    size_t m_numPreStabilizationConstraints = 0;
+    size_t m_numContactConstraints = 0;
+    size_t m_numPermanentConstraints = 0;       ///< Permanent constraints solved (sleeping ones are left out).
+    size_t m_numShapeMatchingConstraints = 0;
+    size_t m_numWarmStartedContacts = 0;        ///< Contacts found in the contact cache (see CWorld::m_contactWarmStarting).
+    size_t m_numStaticContacts = 0;             ///< Particles close to a static collider (see CWorld::m_staticColliders).
+
+    unsigned int m_preStabilizationIterations = 0;
+    unsigned int m_contactIterations = 0;
+    unsigned int m_maxShapeMatchingIterations = 0;   ///< Most iterations used by a shape-matching object.
+
+    double m_maxError = 0;                      ///< Largest contact or permanent constraint violation after the solve.
+    double m_rmsError = 0;
+    bool   m_timeoutHit = false;                ///< A solver loop stopped because of the step timeout.
+
+    size_t m_numActiveParticles = 0;
+    size_t m_numObjectPairs = 0;                ///< Particle groups with overlapping bounds.
+    size_t m_numBroadPhaseParticles = 0;        ///< Particles in an overlap of their group with another one.
+};
+
+}
+
+#endif //PBD_CSTEPSTATS_H
@@ -0,0 +1,152 @@
+#ifndef PBD_CSWEEPANDPRUNE_H
+#define PBD_CSWEEPANDPRUNE_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+namespace PBD
+{
+
+/**
+ * Sweep-and-prune over a set of axis aligned boxes: reports every pair of overlapping boxes.
+ *
+ * The box endpoints on the sweep axis are kept sorted between calls. Boxes move little from one step to the next,
+ * so the insertion sort that restores the order only does a few swaps, and an update costs O(n + swaps + pairs).
+ * The sweep axis is the one along which the box centers are the most spread. A change of axis sorts from scratch.
+ * Boxes are closed: touching boxes overlap. Empty boxes never overlap.
+ */
+template<typename T_real=double>
+class CSweepAndPrune
+{
+public:
+    typedef Eigen::AlignedBox<T_real,3> Box;
+    typedef std::pair<size_t,size_t> Pair;
+
+    CSweepAndPrune() = default;
+
+    ~CSweepAndPrune() = default;
+
+    /// Replace pairs with the pairs (i,j), i<j, of overlapping boxes. boxes must keep their indices between calls.
+    void update(const std::vector<Box>& boxes, std::vector<Pair>& pairs)
+    {
+        pairs.clear();
+
+        const int axis = sweepAxis(boxes);
+        if (axis != m_axis || m_endpoints.size() != 2*boxes.size())
+        {
+            m_axis = axis;
+            m_endpoints.resize(2*boxes.size());
+            for (size_t b=0; b<boxes.size(); ++b)
+            {
+                m_endpoints[2*b] = SEndpoint{ 0, b, true };
+                m_endpoints[2*b+1] = SEndpoint{ 0, b, false };
+            }
+            refresh(boxes);
+            std::sort(m_endpoints.begin(), m_endpoints.end());
+        }
+        else
+        {
+            refresh(boxes);
+            insertionSort();
+        }
+
+        //Sweep: a box overlaps on the sweep axis the boxes still open when its min endpoint is reached
+        m_open.clear();
+        m_openSlot.resize(boxes.size());
+        for (const auto& e:m_endpoints)
+        {
+            if (boxes[e.m_box].isEmpty()) continue;
+
+            if (e.m_isMin)
+            {
+                for (const auto& o:m_open)
+                {
+                    if (overlapOtherAxes(boxes[o], boxes[e.m_box]))
+                    {
+                        pairs.emplace_back(std::min(o, e.m_box), std::max(o, e.m_box));
+                    }
+                }
+                m_openSlot[e.m_box] = m_open.size();
+                m_open.push_back(e.m_box);
+            }
+            else
+            {
+                const size_t slot = m_openSlot[e.m_box];
+                m_open[slot] = m_open.back();
+                m_openSlot[m_open[slot]] = slot;
+                m_open.pop_back();
+            }
+        }
+    }
+
+    int getAxis() const { return m_axis; }
+
+protected:
+    struct SEndpoint
+    {
+        T_real m_value;
+        size_t m_box;
+        bool   m_isMin;
+
+        //Min endpoints go first on ties, so touching boxes are reported
+        bool operator<(const SEndpoint& e) const { return m_value < e.m_value || (m_value == e.m_value && m_isMin && !e.m_isMin); }
+    };
+
+    static int sweepAxis(const std::vector<Box>& boxes)
+    {
+        Box centers;
+        for (const auto& b:boxes)
+        {
+            if (!b.isEmpty()) centers.extend(b.center());
+        }
+        if (centers.isEmpty()) return 0;
+
+        int axis;
+        centers.sizes().maxCoeff(&axis);
+        return axis;
+    }
+
+    void refresh(const std::vector<Box>& boxes)
+    {
+        for (auto& e:m_endpoints)
+        {
+            e.m_value = e.m_isMin ? boxes[e.m_box].min()(m_axis) : boxes[e.m_box].max()(m_axis);
+        }
+    }
+
+    void insertionSort()
+    {
+        for (size_t i=1; i<m_endpoints.size(); ++i)
+        {
+            const SEndpoint e = m_endpoints[i];
+            size_t j = i;
+            for (; j>0 && e < m_endpoints[j-1]; --j)
+            {
+                m_endpoints[j] = m_endpoints[j-1];
+            }
+            m_endpoints[j] = e;
+        }
+    }
+
+    bool overlapOtherAxes(const Box& a, const Box& b) const
+    {
+        for (int k=0; k<3; ++k)
+        {
+            if (k == m_axis) continue;
+            if (a.max()(k) < b.min()(k) || b.max()(k) < a.min()(k)) return false;
+        }
+        return true;
+    }
+
+    int m_axis = -1;
+    std::vector<SEndpoint> m_endpoints;     ///< Endpoints of the boxes on the sweep axis, sorted.
+    std::vector<size_t>    m_open;          ///< Boxes whose min endpoint has been swept but not their max.
+    std::vector<size_t>    m_openSlot;      ///< Position of each open box in m_open.
+};
+
+}
+
+#endif //PBD_CSWEEPANDPRUNE_H
@@ -0,0 +1,150 @@
+#ifndef PBD_CTHREADPOOL_H
+#define PBD_CTHREADPOOL_H
+
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+
+namespace PBD
+{
+
+/**
+ * Fixed size pool of worker threads used to run the data-parallel loops of the solver.
+ *
+ * parallelFor splits [begin,end) into one contiguous chunk per thread, so the work assigned to each thread only
+ * depends on the range and the number of threads. The calling thread runs the first chunk and blocks until all the
+ * chunks are done.
+ */
+class CThreadPool
+{
+public:
+    typedef std::shared_ptr< CThreadPool > Ptr;
+
+    typedef const std::shared_ptr< CThreadPool > ConstPtr;
+
+public:
+    explicit CThreadPool(size_t numThreads=1): m_numThreads(std::max(numThreads, size_t(1))), m_jobChunks(0), m_generation(0), m_pending(0), m_stop(false)
+    {
+        for (size_t t=1; t<m_numThreads; ++t)
+        {
+            m_workers.emplace_back( &CThreadPool::workerLoop, this, t );
+        }
+    }
+
+    ~CThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wakeCondition.notify_all();
+        for (auto& w:m_workers)
+        {
+            w.join();
+        }
+    }
+
+    CThreadPool(const CThreadPool&) = delete;
+
+    CThreadPool& operator=(const CThreadPool&) = delete;
+
+    size_t getNumThreads() const { return m_numThreads; }
+
+    /// Call f(chunkBegin, chunkEnd, threadIdx) on one contiguous chunk of [begin,end) per thread.
+    template<typename F>
+    void parallelFor(const size_t& begin, const size_t& end, const F& f)
+    {
+        if (end <= begin) return;
+
+        const size_t count = end - begin;
+        const size_t numChunks = std::min(m_numThreads, count);
+        if (numChunks == 1)
+        {
+            f(begin, end, size_t(0));
+            return;
+        }
+
+        auto chunk = [begin, count, numChunks, &f](size_t t)
+        {
+            size_t b = begin + (count * t) / numChunks;
+            size_t e = begin + (count * (t+1)) / numChunks;
+            f(b, e, t);
+        };
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_job = chunk;
+            m_jobChunks = numChunks;
+            m_pending = numChunks - 1;
+            ++m_generation;
+        }
+        m_wakeCondition.notify_all();
+
+        chunk(0);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_doneCondition.wait(lock, [this]{ return m_pending == 0; });
+        m_job = nullptr;
+    }
+
+    /// Call f(i, threadIdx) for every i in [begin,end). Threads pick the next index from a shared counter, so it
+    /// balances items of very different cost (e.g. objects of different size).
+    template<typename F>
+    void parallelForDynamic(const size_t& begin, const size_t& end, const F& f)
+    {
+        std::atomic<size_t> next(begin);
+        parallelFor(0, m_numThreads, [&next, end, &f](size_t, size_t, size_t t)
+        {
+            for (size_t i = next++; i < end; i = next++)
+            {
+                f(i, t);
+            }
+        });
+    }
+
+protected:
+    void workerLoop(size_t threadIdx)
+    {
+        size_t lastGeneration = 0;
+        while (true)
+        {
+            std::function<void(size_t)> job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wakeCondition.wait(lock, [this, lastGeneration]{ return m_stop || m_generation != lastGeneration; });
+                if (m_stop) return;
+                lastGeneration = m_generation;
+                if (threadIdx >= m_jobChunks) continue;
+                job = m_job;
+            }
+
+            job(threadIdx);
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (--m_pending == 0)
+            {
+                m_doneCondition.notify_one();
+            }
+        }
+    }
+
+    size_t m_numThreads;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    std::condition_variable m_doneCondition;
+    std::function<void(size_t)> m_job;
+    size_t m_jobChunks;
+    size_t m_generation;
+    size_t m_pending;
+    bool m_stop;
+};
+
+}
+
+#endif //PBD_CTHREADPOOL_H
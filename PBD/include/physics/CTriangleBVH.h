@@ -0,0 +1,519 @@
+#ifndef PBD_CTRIANGLEBVH_H
+#define PBD_CTRIANGLEBVH_H
+
+#include <array>
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+namespace PBD
+{
+
+/**
+ * Bounding volume hierarchy of a triangle mesh, answering closest point queries.
+ *
+ * The tree is built once with the surface area heuristic (binned over the triangle centroids) and never modified, so
+ * one instance can be shared by any number of colliders and threads. Nodes take 32 bytes (float bounds rounded
+ * outwards, two indices) and are stored depth first: the first child of an inner node follows it, so a query walks
+ * mostly forward in memory. Triangles and vertices are reordered so the data of a leaf is contiguous.
+ *
+ * A query keeps its traversal stack on the call stack and allocates nothing. The distance bound prunes every node
+ * farther than the best triangle found so far, the nearer child being visited first.
+ *
+ * Triangles are counter clockwise seen from outside. The side of a point is given by the angle weighted pseudo normal
+ * of the closest feature (face, edge or vertex), which is exact for closed manifold meshes.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+class CTriangleBVH
+{
+public:
+    typedef std::array<uint32_t,3> Triangle;
+
+    constexpr static uint32_t invalid = std::numeric_limits<uint32_t>::max();
+
+    constexpr static size_t maxDepth = 48;  ///< Deeper nodes are split at the median, which adds at most 32 levels.
+
+    struct SNode
+    {
+        float    m_min[3];
+        uint32_t m_index;       ///< First triangle of a leaf, second child of an inner node.
+        float    m_max[3];
+        uint32_t m_count;       ///< Triangles of a leaf, 0 for an inner node.
+    };
+
+    /// Closest point of the mesh. Features 0-2 are the vertices of the triangle, 3-5 its edges (vertex k to k+1), 6 its face.
+    struct SHit
+    {
+        T_vector m_point;
+        T_real   m_distance2;
+        uint32_t m_triangle;
+        uint32_t m_feature;
+    };
+
+    CTriangleBVH() = default;
+
+    /// Build the hierarchy of the given mesh. Triangles referencing missing vertices are dropped.
+    CTriangleBVH(const std::vector<T_vector>& vertices, const std::vector<Triangle>& triangles, const size_t& maxLeafSize=4):
+            m_vertices(vertices)
+    {
+        m_triangles.reserve(triangles.size());
+        for (const auto& t:triangles)
+        {
+            if (t[0] < vertices.size() && t[1] < vertices.size() && t[2] < vertices.size()) m_triangles.push_back(t);
+        }
+        build(std::max(maxLeafSize, size_t(1)));
+        computePseudoNormals();
+    }
+
+    ~CTriangleBVH() = default;
+
+    /**
+     * Closest point of the mesh to p, if it is within maxDistance. Returns false (hit unchanged) otherwise.
+     */
+    bool closestPoint(const T_vector& p, const T_real& maxDistance, SHit& hit) const
+    {
+        if (m_nodes.empty() || maxDistance < 0) return false;
+
+        T_real best2 = maxDistance < std::sqrt(std::numeric_limits<T_real>::max()) ? maxDistance*maxDistance : std::numeric_limits<T_real>::max();
+        bool found = false;
+
+        uint32_t stack[maxDepth + 32];
+        size_t top = 0;
+        uint32_t node = 0;
+        if (boxDistance2(m_nodes[0], p) > best2) return false;
+        while (true)
+        {
+            const SNode& n = m_nodes[node];
+            if (n.m_count > 0)
+            {
+                for (uint32_t t = n.m_index; t < n.m_index + n.m_count; ++t)
+                {
+                    uint32_t feature;
+                    const T_vector q = closestPointOnTriangle(p, t, feature);
+                    const T_real d2 = (q - p).squaredNorm();
+                    if (d2 <= best2)
+                    {
+                        best2 = d2;
+                        hit.m_point = q;
+                        hit.m_distance2 = d2;
+                        hit.m_triangle = t;
+                        hit.m_feature = feature;
+                        found = true;
+                    }
+                }
+            }
+            else
+            {
+                //Nearer child first, the other one is pushed if it may still hold a closer triangle
+                uint32_t first = node + 1;
+                uint32_t second = n.m_index;
+                T_real d1 = boxDistance2(m_nodes[first], p);
+                T_real d2 = boxDistance2(m_nodes[second], p);
+                if (d2 < d1)
+                {
+                    std::swap(first, second);
+                    std::swap(d1, d2);
+                }
+                if (d1 <= best2)
+                {
+                    if (d2 <= best2) stack[top++] = second;
+                    node = first;
+                    continue;
+                }
+            }
+
+            //Pop the next node still within the best distance
+            bool next = false;
+            while (top > 0)
+            {
+                node = stack[--top];
+                if (boxDistance2(m_nodes[node], p) <= best2)
+                {
+                    next = true;
+                    break;
+                }
+            }
+            if (!next) break;
+        }
+        return found;
+    }
+
+    /// Outward pseudo normal (not normalized) of the closest feature of a hit: a point is outside if (p - hit.m_point) points along it.
+    T_vector pseudoNormal(const SHit& hit) const
+    {
+        const Triangle& t = m_triangles[hit.m_triangle];
+        if (hit.m_feature < 3) return m_vertexNormals[ t[hit.m_feature] ];
+
+        const T_vector n = faceNormal(hit.m_triangle);
+        if (hit.m_feature < 6)
+        {
+            const uint32_t neighbour = m_neighbours[3*hit.m_triangle + hit.m_feature - 3];
+            if (neighbour != invalid) return n + faceNormal(neighbour);
+        }
+        return n;
+    }
+
+    /// Unit normal of triangle t (in the reordered numbering of the hits).
+    T_vector faceNormal(const uint32_t& t) const
+    {
+        const Triangle& v = m_triangles[t];
+        const T_vector n = (m_vertices[v[1]] - m_vertices[v[0]]).cross(m_vertices[v[2]] - m_vertices[v[0]]);
+        const T_real norm = n.norm();
+        return norm > 0 ? T_vector(n / norm) : T_vector(T_vector::Zero());
+    }
+
+    bool empty() const { return m_nodes.empty(); }
+
+    size_t getNumTriangles() const { return m_triangles.size(); }
+
+    size_t getNumNodes() const { return m_nodes.size(); }
+
+    size_t getDepth() const { return m_depth; }
+
+    const std::vector<T_vector>& getVertices() const { return m_vertices; }
+
+    const std::vector<Triangle>& getTriangles() const { return m_triangles; }
+
+    Eigen::AlignedBox<T_real,3> getBounds() const
+    {
+        Eigen::AlignedBox<T_real,3> bounds;
+        if (m_nodes.empty()) return bounds;
+        for (int k=0; k<3; ++k)
+        {
+            bounds.min()(k) = T_real(m_nodes[0].m_min[k]);
+            bounds.max()(k) = T_real(m_nodes[0].m_max[k]);
+        }
+        return bounds;
+    }
+
+protected:
+    typedef Eigen::AlignedBox<T_real,3> Box;
+
+    constexpr static size_t numBins = 16;
+
+    struct SBin
+    {
+        Box    m_bounds;
+        size_t m_count = 0;
+    };
+
+    static T_real area(const Box& b)
+    {
+        if (b.isEmpty()) return 0;
+        const T_vector s = b.sizes();
+        return s(0)*s(1) + s(1)*s(2) + s(2)*s(0);
+    }
+
+    static T_real boxDistance2(const SNode& n, const T_vector& p)
+    {
+        T_real d2 = 0;
+        for (int k=0; k<3; ++k)
+        {
+            const T_real below = T_real(n.m_min[k]) - p(k);
+            const T_real above = p(k) - T_real(n.m_max[k]);
+            const T_real d = std::max(std::max(below, above), T_real(0));
+            d2 += d*d;
+        }
+        return d2;
+    }
+
+    void build(const size_t& maxLeafSize)
+    {
+        m_nodes.clear();
+        m_depth = 0;
+        if (m_triangles.empty()) return;
+
+        m_triangleBounds.resize(m_triangles.size());
+        m_centroids.resize(m_triangles.size());
+        m_order.resize(m_triangles.size());
+        for (size_t t=0; t<m_triangles.size(); ++t)
+        {
+            Box b;
+            for (const auto& v:m_triangles[t]) b.extend(m_vertices[v]);
+            m_triangleBounds[t] = b;
+            m_centroids[t] = b.center();
+            m_order[t] = uint32_t(t);
+        }
+        m_nodes.reserve(2 * (m_triangles.size() / maxLeafSize + 1));
+        buildNode(0, m_order.size(), 0, maxLeafSize);
+
+        //Triangles in leaf order, and vertices in order of first use, so a leaf reads neighbouring memory
+        std::vector<Triangle> ordered(m_triangles.size());
+        std::vector<uint32_t> vertexIndex(m_vertices.size(), invalid);
+        std::vector<T_vector> vertices;
+        vertices.reserve(m_vertices.size());
+        for (size_t t=0; t<m_order.size(); ++t)
+        {
+            for (int k=0; k<3; ++k)
+            {
+                uint32_t& v = vertexIndex[ m_triangles[m_order[t]][k] ];
+                if (v == invalid)
+                {
+                    v = uint32_t(vertices.size());
+                    vertices.push_back(m_vertices[ m_triangles[m_order[t]][k] ]);
+                }
+                ordered[t][k] = v;
+            }
+        }
+        m_triangles.swap(ordered);
+        m_vertices.swap(vertices);
+
+        m_triangleBounds = std::vector<Box>();
+        m_centroids = std::vector<T_vector>();
+        m_order = std::vector<uint32_t>();
+    }
+
+    uint32_t buildNode(const size_t& begin, const size_t& end, const size_t& depth, const size_t& maxLeafSize)
+    {
+        const uint32_t index = uint32_t(m_nodes.size());
+        m_nodes.emplace_back();
+        m_depth = std::max(m_depth, depth + 1);
+
+        Box bounds, centroidBounds;
+        for (size_t i=begin; i<end; ++i)
+        {
+            bounds.extend(m_triangleBounds[m_order[i]]);
+            centroidBounds.extend(m_centroids[m_order[i]]);
+        }
+        setBounds(m_nodes[index], bounds);
+
+        const size_t count = end - begin;
+        size_t middle = begin;
+        if (count > maxLeafSize)
+        {
+            middle = depth < maxDepth ? splitSAH(begin, end, bounds, centroidBounds) : begin;
+            if (middle == begin || middle == end)
+            {
+                //A leaf would be cheaper, the centroids coincide or the depth is exhausted: split at the median so the
+                //leaves stay small
+                int axis;
+                centroidBounds.sizes().maxCoeff(&axis);
+                middle = begin + count/2;
+                std::nth_element(m_order.begin() + begin, m_order.begin() + middle, m_order.begin() + end,
+                                 [this, axis](const uint32_t& a, const uint32_t& b){ return m_centroids[a](axis) < m_centroids[b](axis); });
+            }
+        }
+        if (count <= maxLeafSize || middle == begin)
+        {
+            m_nodes[index].m_index = uint32_t(begin);
+            m_nodes[index].m_count = uint32_t(count);
+            return index;
+        }
+
+        buildNode(begin, middle, depth + 1, maxLeafSize);
+        const uint32_t second = buildNode(middle, end, depth + 1, maxLeafSize);
+        m_nodes[index].m_index = second;
+        m_nodes[index].m_count = 0;
+        return index;
+    }
+
+    /// Partition [begin,end) at the cheapest binned SAH plane. Returns begin when a leaf is cheaper than any split.
+    size_t splitSAH(const size_t& begin, const size_t& end, const Box& bounds, const Box& centroidBounds)
+    {
+        int bestAxis = -1;
+        size_t bestBin = 0;
+        T_real bestCost = T_real(end - begin) * area(bounds);      //Cost of a leaf, relative to a traversal step of 1
+
+        for (int axis=0; axis<3; ++axis)
+        {
+            const T_real extent = centroidBounds.max()(axis) - centroidBounds.min()(axis);
+            if (!(extent > 0)) continue;
+
+            std::array<SBin, numBins> bins;
+            const T_real scale = T_real(numBins) / extent;
+            for (size_t i=begin; i<end; ++i)
+            {
+                const uint32_t t = m_order[i];
+                const size_t b = std::min(size_t((m_centroids[t](axis) - centroidBounds.min()(axis)) * scale), numBins - 1);
+                bins[b].m_bounds.extend(m_triangleBounds[t]);
+                ++bins[b].m_count;
+            }
+
+            //Sweep from the right for the right hand side costs, then from the left
+            std::array<T_real, numBins> rightCost;
+            Box right;
+            size_t rightCount = 0;
+            for (size_t b=numBins-1; b>0; --b)
+            {
+                right.extend(bins[b].m_bounds);
+                rightCount += bins[b].m_count;
+                rightCost[b] = T_real(rightCount) * area(right);
+            }
+            Box left;
+            size_t leftCount = 0;
+            for (size_t b=1; b<numBins; ++b)
+            {
+                left.extend(bins[b-1].m_bounds);
+                leftCount += bins[b-1].m_count;
+                const T_real cost = area(bounds) + T_real(leftCount) * area(left) + rightCost[b];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+        if (bestAxis < 0) return begin;
+
+        const T_real scale = T_real(numBins) / (centroidBounds.max()(bestAxis) - centroidBounds.min()(bestAxis));
+        const T_real origin = centroidBounds.min()(bestAxis);
+        auto middle = std::partition(m_order.begin() + begin, m_order.begin() + end, [&](const uint32_t& t)
+        {
+            return std::min(size_t((m_centroids[t](bestAxis) - origin) * scale), numBins - 1) < bestBin;
+        });
+        return size_t(middle - m_order.begin());
+    }
+
+    /// Float bounds containing the box, so the pruning test stays conservative in double precision.
+    static void setBounds(SNode& n, const Box& b)
+    {
+        for (int k=0; k<3; ++k)
+        {
+            float lo = float(b.min()(k));
+            float hi = float(b.max()(k));
+            if (T_real(lo) > b.min()(k)) lo = std::nextafter(lo, -std::numeric_limits<float>::infinity());
+            if (T_real(hi) < b.max()(k)) hi = std::nextafter(hi, std::numeric_limits<float>::infinity());
+            n.m_min[k] = lo;
+            n.m_max[k] = hi;
+        }
+    }
+
+    void computePseudoNormals()
+    {
+        //Vertices: face normals weighted by the angle of the face at the vertex
+        m_vertexNormals.assign(m_vertices.size(), T_vector::Zero());
+        for (uint32_t t=0; t<m_triangles.size(); ++t)
+        {
+            const T_vector n = faceNormal(t);
+            for (int k=0; k<3; ++k)
+            {
+                const T_vector& v = m_vertices[ m_triangles[t][k] ];
+                const T_vector e1 = m_vertices[ m_triangles[t][(k+1)%3] ] - v;
+                const T_vector e2 = m_vertices[ m_triangles[t][(k+2)%3] ] - v;
+                const T_real angle = std::atan2(e1.cross(e2).norm(), e1.dot(e2));
+                m_vertexNormals[ m_triangles[t][k] ] += angle * n;
+            }
+        }
+
+        //Edges: the triangle across each edge, found by sorting the edges on their vertices. Edges shared by more
+        //than two triangles are left without neighbour.
+        struct SEdge
+        {
+            uint32_t m_v0, m_v1, m_triangle, m_edge;
+            bool operator<(const SEdge& e) const { return m_v0 < e.m_v0 || (m_v0 == e.m_v0 && m_v1 < e.m_v1); }
+        };
+        std::vector<SEdge> edges;
+        edges.reserve(3*m_triangles.size());
+        for (uint32_t t=0; t<m_triangles.size(); ++t)
+        {
+            for (uint32_t k=0; k<3; ++k)
+            {
+                const uint32_t a = m_triangles[t][k];
+                const uint32_t b = m_triangles[t][(k+1)%3];
+                edges.push_back(SEdge{ std::min(a,b), std::max(a,b), t, k });
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        m_neighbours.assign(3*m_triangles.size(), invalid);
+        for (size_t i=0; i<edges.size();)
+        {
+            size_t j = i + 1;
+            while (j < edges.size() && edges[j].m_v0 == edges[i].m_v0 && edges[j].m_v1 == edges[i].m_v1) ++j;
+            if (j - i == 2)
+            {
+                m_neighbours[3*edges[i].m_triangle + edges[i].m_edge] = edges[i+1].m_triangle;
+                m_neighbours[3*edges[i+1].m_triangle + edges[i+1].m_edge] = edges[i].m_triangle;
+            }
+            i = j;
+        }
+    }
+
+    /// Closest point of triangle t to p and its feature (Ericson, Real-Time Collision Detection, 5.1.5).
+    T_vector closestPointOnTriangle(const T_vector& p, const uint32_t& t, uint32_t& feature) const
+    {
+        const T_vector& a = m_vertices[ m_triangles[t][0] ];
+        const T_vector& b = m_vertices[ m_triangles[t][1] ];
+        const T_vector& c = m_vertices[ m_triangles[t][2] ];
+        const T_vector ab = b - a;
+        const T_vector ac = c - a;
+        const T_vector ap = p - a;
+        const T_real d1 = ab.dot(ap);
+        const T_real d2 = ac.dot(ap);
+        if (d1 <= 0 && d2 <= 0)
+        {
+            feature = 0;
+            return a;
+        }
+
+        const T_vector bp = p - b;
+        const T_real d3 = ab.dot(bp);
+        const T_real d4 = ac.dot(bp);
+        if (d3 >= 0 && d4 <= d3)
+        {
+            feature = 1;
+            return b;
+        }
+
+        const T_real vc = d1*d4 - d3*d2;
+        if (vc <= 0 && d1 >= 0 && d3 <= 0)
+        {
+            feature = 3;
+            return a + ab * (d1 / (d1 - d3));
+        }
+
+        const T_vector cp = p - c;
+        const T_real d5 = ab.dot(cp);
+        const T_real d6 = ac.dot(cp);
+        if (d6 >= 0 && d5 <= d6)
+        {
+            feature = 2;
+            return c;
+        }
+
+        const T_real vb = d5*d2 - d1*d6;
+        if (vb <= 0 && d2 >= 0 && d6 <= 0)
+        {
+            feature = 5;
+            return a + ac * (d2 / (d2 - d6));
+        }
+
+        const T_real va = d3*d6 - d5*d4;
+        if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+        {
+            feature = 4;
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        }
+
+        const T_real sum = va + vb + vc;
+        if (!(sum > 0))
+        {
+            //Degenerate triangle: its vertices are the only features
+            feature = 0;
+            return a;
+        }
+        feature = 6;
+        return a + ab * (vb / sum) + ac * (vc / sum);
+    }
+
+    std::vector<SNode>      m_nodes;            ///< Depth first, the root first.
+    std::vector<T_vector>   m_vertices;         ///< Used vertices, in order of first use by the leaves.
+    std::vector<Triangle>   m_triangles;        ///< In leaf order.
+    std::vector<uint32_t>   m_neighbours;       ///< Triangle across each edge of each triangle, or invalid.
+    std::vector<T_vector>   m_vertexNormals;    ///< Angle weighted pseudo normals.
+    size_t                  m_depth = 0;
+
+    //Build temporaries, released once the tree is built
+    std::vector<Box>        m_triangleBounds;
+    std::vector<T_vector>   m_centroids;
+    std::vector<uint32_t>   m_order;
+};
+
+}
+
+#endif //PBD_CTRIANGLEBVH_H
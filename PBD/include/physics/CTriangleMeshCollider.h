@@ -0,0 +1,111 @@
+#ifndef PBD_CTRIANGLEMESHCOLLIDER_H
+#define PBD_CTRIANGLEMESHCOLLIDER_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cmath>
+#include <Eigen/Dense>
+#include <Common.h>
+#include <io/MeshReader.h>
+#include <physics/CTriangleBVH.h>
+
+namespace PBD
+{
+
+/**
+ * Static collider defined by a triangle mesh, for geometry too large or too detailed to be sampled in a distance field.
+ *
+ * The mesh is held by a CTriangleBVH built once when the mesh is loaded and never modified afterwards. Copies of a
+ * collider share it: each copy only adds its own placement (m_position, m_rotation), so one mesh can be placed in
+ * many worlds and queried by all their threads.
+ *
+ * A query looks for the closest triangle within maxDistance only (the particle size for the contacts), so particles
+ * away from the mesh cost one box test. Beyond that distance the mesh reports no collision. Open meshes are
+ * one-sided: a point within maxDistance behind a triangle is inside.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+class CTriangleMeshCollider
+{
+public:
+    typedef Eigen::Matrix<T_real,3,3> T_matrix;
+    typedef PBD::CTriangleBVH<T_real,T_vector> BVH;
+    typedef typename BVH::Triangle Triangle;
+
+    CTriangleMeshCollider():
+            m_position(T_vector::Zero()),
+            m_rotation(T_matrix::Identity())
+    {}
+
+    explicit CTriangleMeshCollider(const std::shared_ptr<const BVH>& bvh):
+            m_position(T_vector::Zero()),
+            m_rotation(T_matrix::Identity()),
+            m_bvh(bvh)
+    {}
+
+    CTriangleMeshCollider(const std::vector<T_vector>& vertices, const std::vector<Triangle>& triangles):
+            m_position(T_vector::Zero()),
+            m_rotation(T_matrix::Identity()),
+            m_bvh(new BVH(vertices, triangles))
+    {}
+
+    ~CTriangleMeshCollider() = default;
+
+    /// Read a binary PLY mesh and build its hierarchy. Returns false (and leaves the collider unchanged) on failure.
+    bool load(const std::string& filename, const T_real& scale=1)
+    {
+        std::vector<T_vector> vertices;
+        std::vector<Triangle> triangles;
+        if (!PBD::readBinaryPLYMesh<T_real,T_vector>(filename, vertices, triangles, scale) || triangles.empty())
+        {
+            _GENERIC_ERROR_("Invalid triangle mesh: " + filename);
+            return false;
+        }
+        m_bvh.reset(new BVH(vertices, triangles));
+        return true;
+    }
+
+    /**
+     * Signed distance from p to the mesh (negative inside) and outward normal, if the mesh is within maxDistance of
+     * p. Numeric max otherwise.
+     */
+    T_real signedDistance(const T_vector& p, T_vector& normal,
+                          const T_real& maxDistance=std::numeric_limits<T_real>::max()) const
+    {
+        normal = T_vector::UnitZ();
+        typename BVH::SHit hit;
+        const T_vector local = m_rotation.transpose() * (p - m_position);
+        if (!m_bvh || !m_bvh->closestPoint(local, maxDistance, hit)) return std::numeric_limits<T_real>::max();
+
+        //The direction to the closest point is the normal, on the side given by the pseudo normal of its feature
+        const T_vector pseudoNormal = m_bvh->pseudoNormal(hit);
+        const T_vector offset = local - hit.m_point;
+        const T_real distance = std::sqrt(hit.m_distance2);
+        const T_real sign = offset.dot(pseudoNormal) < 0 ? T_real(-1) : T_real(1);
+        if (distance > 0)
+        {
+            normal = m_rotation * (offset * (sign / distance));
+        }
+        else if (pseudoNormal.squaredNorm() > 0)
+        {
+            normal = m_rotation * pseudoNormal.normalized();
+        }
+        return sign * distance;
+    }
+
+    bool empty() const { return !m_bvh || m_bvh->empty(); }
+
+    const std::shared_ptr<const BVH>& getBVH() const { return m_bvh; }
+
+    T_vector m_position;        ///< Placement of the mesh frame in the world.
+    T_matrix m_rotation;
+
+protected:
+    std::shared_ptr<const BVH> m_bvh;
+};
+
+}
+
+#endif //PBD_CTRIANGLEMESHCOLLIDER_H
@@ -0,0 +1,62 @@
+#ifndef PBD_CUNIONFIND_H
+#define PBD_CUNIONFIND_H
+
+#include <vector>
+#include <utility>
+
+namespace PBD
+{
+
+/**
+ * Disjoint-set forest (union by size, path halving) used to find the islands of the constraint graph.
+ * Buffers are reused between calls to reset().
+ */
+class CUnionFind
+{
+public:
+    CUnionFind() = default;
+
+    ~CUnionFind() = default;
+
+    /// n singleton sets.
+    void reset(const size_t& n)
+    {
+        m_parent.resize(n);
+        m_setSize.assign(n, 1);
+        for (size_t i=0; i<n; ++i)
+        {
+            m_parent[i] = i;
+        }
+    }
+
+    size_t find(size_t i)
+    {
+        while (m_parent[i] != i)
+        {
+            m_parent[i] = m_parent[ m_parent[i] ];
+            i = m_parent[i];
+        }
+        return i;
+    }
+
+    void join(const size_t& a, const size_t& b)
+    {
+        size_t ra = find(a);
+        size_t rb = find(b);
+        if (ra == rb) return;
+
+        if (m_setSize[ra] < m_setSize[rb]) std::swap(ra, rb);
+        m_parent[rb] = ra;
+        m_setSize[ra] += m_setSize[rb];
+    }
+
+    size_t size() const { return m_parent.size(); }
+
+protected:
+    std::vector<size_t> m_parent;
+    std::vector<size_t> m_setSize;
+};
+
+}
+
+#endif //PBD_CUNIONFIND_H
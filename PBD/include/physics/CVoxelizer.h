@@ -0,0 +1,227 @@
+#ifndef PBD_CVOXELIZER_H
+#define PBD_CVOXELIZER_H
+
+#include <memory>
+#include <vector>
+#include <thread>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <Eigen/Dense>
+#include <Common.h>
+#include <physics/CParticleStore.h>
+#include <physics/CThreadPool.h>
+
+namespace PBD
+{
+
+/**
+ * Point set voxelizer on a flat grid of cubic cells of side voxelSize, aligned to the world origin.
+ *
+ * The cell of every point is computed in parallel. Cells are then marked in a dense byte grid over the bounding box
+ * (padded with one empty cell per side) and the empty cells reachable from the padding are flood filled, so the cells
+ * enclosed by the surface become solid. A surface with holes wider than one cell leaks and yields only the surface
+ * cells, as does an open scan. If the bounding box has more than maxDenseCells cells the sorted unique surface cells
+ * are used instead and no interior is added.
+ */
+template<typename T_real=double, typename T_vector=Eigen::Matrix<T_real,3,1> >
+class CVoxelizer
+{
+public:
+    typedef std::shared_ptr< CVoxelizer<T_real,T_vector> > Ptr;
+
+    typedef const std::shared_ptr< CVoxelizer<T_real,T_vector> > ConstPtr;
+
+    explicit CVoxelizer(const T_real& voxelSize, size_t numThreads=0, const size_t& maxDenseCells=size_t(1)<<28):
+            m_voxelSize(voxelSize),
+            m_numThreads(numThreads),
+            m_maxDenseCells(maxDenseCells),
+            m_numSurfaceVoxels(0)
+    {
+        if (m_numThreads == 0) m_numThreads = std::max(1u, std::thread::hardware_concurrency());
+        m_dims.setZero();
+        m_minCell.setZero();
+    }
+
+    ~CVoxelizer() = default;
+
+    /**
+     * Voxelize points. T_points is any random access range of 3D points with size() and operator[] (a std::vector
+     * or an in-place CStridedPointView). Replaces the result of a previous call.
+     */
+    template<typename T_points>
+    void voxelize(const T_points& points, const bool& fillInterior=true)
+    {
+        m_voxels.clear();
+        m_numSurfaceVoxels = 0;
+        const size_t numPoints = points.size();
+        if (numPoints == 0) return;
+
+        PBD::CThreadPool pool(std::min(m_numThreads, std::max(size_t(1), numPoints / 4096)));
+        const size_t numThreads = pool.getNumThreads();
+
+        //Bounding box of the point cells
+        const int64_t maxInt = std::numeric_limits<int64_t>::max();
+        std::vector<Eigen::Matrix<int64_t,3,1> > threadMin(numThreads, Eigen::Matrix<int64_t,3,1>::Constant(maxInt));
+        std::vector<Eigen::Matrix<int64_t,3,1> > threadMax(numThreads, Eigen::Matrix<int64_t,3,1>::Constant(-maxInt));
+        pool.parallelFor(0, numPoints, [&](size_t b, size_t e, size_t t)
+        {
+            for (size_t i=b; i<e; ++i)
+            {
+                const Eigen::Matrix<int64_t,3,1> c = cellOf(points[i]);
+                threadMin[t] = threadMin[t].cwiseMin(c);
+                threadMax[t] = threadMax[t].cwiseMax(c);
+            }
+        });
+        Eigen::Matrix<int64_t,3,1> cellMin = threadMin[0];
+        Eigen::Matrix<int64_t,3,1> cellMax = threadMax[0];
+        for (size_t t=1; t<numThreads; ++t)
+        {
+            cellMin = cellMin.cwiseMin(threadMin[t]);
+            cellMax = cellMax.cwiseMax(threadMax[t]);
+        }
+
+        //One empty cell of padding per side so the outside is connected
+        m_minCell = cellMin - Eigen::Matrix<int64_t,3,1>::Ones();
+        m_dims = cellMax - cellMin + Eigen::Matrix<int64_t,3,1>::Constant(3);
+        const double numCells = double(m_dims(0)) * double(m_dims(1)) * double(m_dims(2));
+
+        //Linear cell index of every point
+        std::vector<uint64_t> keys(numPoints);
+        pool.parallelFor(0, numPoints, [&](size_t b, size_t e, size_t)
+        {
+            for (size_t i=b; i<e; ++i)
+            {
+                keys[i] = linearIndex( cellOf(points[i]) - m_minCell );
+            }
+        });
+
+        if (numCells > double(m_maxDenseCells))
+        {
+            _GENERIC_WARNING_("Voxel grid too large for a dense fill, using the surface voxels only");
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+            m_voxels.swap(keys);
+            m_numSurfaceVoxels = m_voxels.size();
+            return;
+        }
+
+        std::vector<uint8_t> grid(size_t(numCells), EMPTY);
+        for (const auto& k:keys)
+        {
+            grid[k] = SURFACE;
+        }
+
+        if (fillInterior)
+        {
+            floodFillOutside(grid);
+        }
+
+        for (size_t k=0; k<grid.size(); ++k)
+        {
+            if (grid[k] == SURFACE) ++m_numSurfaceVoxels;
+            if (grid[k] == SURFACE || (fillInterior && grid[k] == EMPTY))
+            {
+                m_voxels.push_back(k);
+            }
+        }
+    }
+
+    /// Append one particle at rest per voxel center, displaced by offset, to store as one contiguous block.
+    /// Returns the number of particles.
+    size_t emitParticles(PBD::CParticleStore<T_real>& store, const T_vector& offset,
+                         const T_real& mass, const T_real& size, const size_t& group=0) const
+    {
+        const size_t first = store.appendBlock(m_voxels.size(), mass, size, group);
+        for (size_t i=0; i<m_voxels.size(); ++i)
+        {
+            store.m_position[first + i] = getCenter(m_voxels[i]) + offset;
+            store.m_predPosition[first + i] = store.m_position[first + i];
+        }
+        return m_voxels.size();
+    }
+
+    /// Center of the voxel with linear index k.
+    T_vector getCenter(const uint64_t& k) const
+    {
+        const int64_t x = int64_t(k % uint64_t(m_dims(0)));
+        const int64_t y = int64_t((k / uint64_t(m_dims(0))) % uint64_t(m_dims(1)));
+        const int64_t z = int64_t(k / (uint64_t(m_dims(0)) * uint64_t(m_dims(1))));
+        return T_vector( (T_real(m_minCell(0) + x) + T_real(0.5)) * m_voxelSize,
+                         (T_real(m_minCell(1) + y) + T_real(0.5)) * m_voxelSize,
+                         (T_real(m_minCell(2) + z) + T_real(0.5)) * m_voxelSize );
+    }
+
+    /// Linear indices of the solid voxels, in ascending order (x fastest).
+    const std::vector<uint64_t>& getVoxels() const { return m_voxels; }
+
+    size_t size() const { return m_voxels.size(); }
+
+    size_t getNumSurfaceVoxels() const { return m_numSurfaceVoxels; }
+
+    T_real getVoxelSize() const { return m_voxelSize; }
+
+protected:
+    enum ECellState : uint8_t { EMPTY = 0, SURFACE = 1, OUTSIDE = 2 };
+
+    Eigen::Matrix<int64_t,3,1> cellOf(const T_vector& p) const
+    {
+        return Eigen::Matrix<int64_t,3,1>( int64_t(std::floor(p(0) / m_voxelSize)),
+                                           int64_t(std::floor(p(1) / m_voxelSize)),
+                                           int64_t(std::floor(p(2) / m_voxelSize)) );
+    }
+
+    uint64_t linearIndex(const Eigen::Matrix<int64_t,3,1>& c) const
+    {
+        return uint64_t(c(0)) + uint64_t(m_dims(0)) * ( uint64_t(c(1)) + uint64_t(m_dims(1)) * uint64_t(c(2)) );
+    }
+
+    /// Mark OUTSIDE every EMPTY cell 6-connected to the padding corner. The cells left EMPTY are enclosed.
+    void floodFillOutside(std::vector<uint8_t>& grid) const
+    {
+        const int64_t dx = m_dims(0);
+        const int64_t dy = m_dims(1);
+        const int64_t dz = m_dims(2);
+        const int64_t sliceSize = dx * dy;
+
+        std::vector<uint64_t> stack;
+        stack.push_back(0);
+        grid[0] = OUTSIDE;
+        while (!stack.empty())
+        {
+            const uint64_t k = stack.back();
+            stack.pop_back();
+
+            const int64_t x = int64_t(k) % dx;
+            const int64_t y = (int64_t(k) / dx) % dy;
+            const int64_t z = int64_t(k) / sliceSize;
+            auto visit = [&](const int64_t& n)
+            {
+                if (grid[n] == EMPTY)
+                {
+                    grid[n] = OUTSIDE;
+                    stack.push_back(uint64_t(n));
+                }
+            };
+            if (x > 0)      visit(int64_t(k) - 1);
+            if (x < dx-1)   visit(int64_t(k) + 1);
+            if (y > 0)      visit(int64_t(k) - dx);
+            if (y < dy-1)   visit(int64_t(k) + dx);
+            if (z > 0)      visit(int64_t(k) - sliceSize);
+            if (z < dz-1)   visit(int64_t(k) + sliceSize);
+        }
+    }
+
+    T_real m_voxelSize;
+    size_t m_numThreads;
+    size_t m_maxDenseCells;
+    size_t m_numSurfaceVoxels;
+    Eigen::Matrix<int64_t,3,1> m_minCell;     ///< Cell coordinates of the grid origin (including the padding).
+    Eigen::Matrix<int64_t,3,1> m_dims;        ///< Grid size in cells (including the padding).
+    std::vector<uint64_t> m_voxels;           ///< Linear indices of the solid cells.
+};
+
+}
+
+#endif //PBD_CVOXELIZER_H
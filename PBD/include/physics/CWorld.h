@@ -7,9 +7,23 @@
 
 #include <chrono>
 #include <iostream>
+#include <algorithm>
 #include <physics/CParticle.hpp>
+#include <physics/CParticleStore.h>
 #include <physics/CParticleSystem.h>
 #include <physics/CConstraint.hpp>
+#include <physics/CConstraintStore.h>
+#include <physics/CContactCache.h>
+#include <physics/CStaticColliders.h>
+#include <physics/CSpatialHashGrid.h>
+#include <physics/CSweepAndPrune.h>
+#include <physics/CThreadPool.h>
+#include <physics/CJacobiSolver.h>
+#include <physics/CConstraintColoring.h>
+#include <physics/CRigidBody.h>
+#include <physics/CUnionFind.h>
+#include <physics/CStepStats.h>
+#include <io/CWorldSnapshot.h>
 
 
 //TODO: HIGH Approximate shock propagation to increase convergence of rigid stacks
@@ -22,44 +36,167 @@
 namespace PBD
 {
 
+    const static size_t noIsland = size_t(-1);        ///< Island index of the static particles.
+
+template<typename T_real=double>
 class CWorld
 {
 public:
+    typedef std::shared_ptr< CWorld<T_real> > Ptr;
+
+    typedef const std::shared_ptr< CWorld<T_real> > ConstPtr;
+
+    typedef Eigen::Matrix<T_real,3,1> T_vector;
+    typedef Eigen::Matrix<T_real,3,3> T_matrix;
+    typedef Eigen::Quaternion<T_real> T_quaternion;
+
+    enum ESolverMode
+    {
+        GAUSS_SEIDEL,           ///< Serial, constraints are projected one after the other.
+        JACOBI,                 ///< Parallel, corrections are accumulated and averaged per particle.
+        COLORED_GAUSS_SEIDEL    ///< Parallel, batches of constraints that share no dynamic particle are projected concurrently.
+    };
+
     CWorld() = default;
     ~CWorld() = default;
 
-    bool collision(CParticle<>* p1, CParticle<>* p2);
+    bool collision(const size_t& p1, const size_t& p2);
     void getIJFromIdx(size_t idx, const std::vector<size_t> &layout, size_t &i, size_t &j);
 
-    void step(const double & timeStep, const double & timeout);
+    void step(const T_real & timeStep, const double & timeout);
     void applyGravity();
-    void symplecticEulerUpdate(double timeStep);
+    void symplecticEulerUpdate(T_real timeStep);
     void createCollisionConstraints();
+    void createCollisionConstraintsBruteForce();
+    void updateBroadPhaseObjects();
+    void invalidateBroadPhaseObjects();
+    void createStaticColliderContacts();
+    void projectStaticColliders();
+    void warmStartContacts();
+    void updateContactCache();
+    void clearContactCache();
     void clearExternalForces();
-    bool gaussSeidelSolver();
+    void setupConstraintSolver(bool withPermanentConstraints);
+    bool constraintSolverIteration(bool withPermanentConstraints);
+    bool gaussSeidelSolver(PBD::CConstraintStore<T_real>& constraints);
+    bool jacobiSolver();
+    bool coloredGaussSeidelSolver(bool withPermanentConstraints);
+    bool shapeMatchingSolver(const uint& maxIter,
+                             const std::chrono::high_resolution_clock::time_point& start,
+                             const double& timeout);
+    void invalidatePermanentConstraintsColoring();
+    bool addRigidBody(const size_t& partIdxIni, const size_t& partIdxEnd);
+    void updateRigidBodyParticles();
+    void foldRigidBodyCorrections();
+    void syncRigidBodyParticles();
+    void updateIslands();
+    void wakeIsland(const size_t& island);
+    bool wakeContactIslands(const size_t& firstConstraint);
+    void wakeExternalForceIslands();
+    void updateActivePermanentConstraints();
+    bool isSleeping(const size_t& p) const;
+    size_t getNumActiveParticles() const;
+    size_t getNumSleepingParticles() const;
+    size_t getNumIslands() const;
+    void computeConstraintErrors();
+    const PBD::CStepStats& getStepStats() const;
+    bool saveSnapshot(const std::string& filename) const;
+    bool loadSnapshot(const std::string& filename);
     void updatePositionsWithPredPositions();
-    void updateVelocities(double timeStep);
+    void updateVelocities(T_real timeStep);
+
+    void setNumThreads(const size_t& numThreads);
+    size_t getNumThreads();
+
 
+    PBD::CParticleStore<T_real>                     m_particles;
+    std::vector<typename PBD::CParticleSystem<T_real>::Ptr>  m_particleSystems;
+    PBD::CConstraintStore<T_real>   m_constraints;          ///< Contacts, recreated every step.
+    PBD::CConstraintStore<T_real>   m_permanentConstraints;
+    std::vector<typename PBD::CShapeMatchingConstraint<T_real>::Ptr>      m_shapeMatchingConstraints;
+    std::vector<typename PBD::CRigidBody<T_real>::Ptr>       m_rigidBodies;
+    PBD::CStaticColliders<T_real>   m_staticColliders;      ///< Static geometry the particles are projected out of.
+    T_vector m_gravity;
 
+    ESolverMode m_solverMode = GAUSS_SEIDEL;
+    T_real m_jacobiRelaxation = 1.0;                ///< Over-relaxation factor applied to the averaged Jacobi corrections.
+    bool m_rigidBodyFastPath = false;               ///< Objects with internal constraints are created as rigid bodies instead of shape matching.
+    bool m_sleepingEnabled = false;                 ///< Islands at rest are put to sleep and skipped by the simulation.
+    double m_sleepEnergyThreshold = 1e-2;           ///< Island kinetic energy per unit mass under which it may sleep. Resting contacts keep about (g*dt)^2/2.
+    unsigned int m_sleepSteps = 60;                 ///< Consecutive steps under the threshold before an island sleeps.
+    T_real m_contactWarmStarting = 0;               ///< Fraction of the previous separation of a persisting contact applied before the solve (0 disables the contact cache).
 
-    std::vector<PBD::CParticle<>::Ptr>        m_particles;
-    std::vector<PBD::CParticleSystem<>::Ptr>  m_particleSystems;
-    std::vector<PBD::CConstraint<>::Ptr>      m_constraints;
-    std::vector<PBD::CConstraint<>::Ptr>      m_permanentConstraints;
-    std::vector<PBD::CShapeMatchingConstraint<>::Ptr>      m_shapeMatchingConstraints;
-    Eigen::Vector3d m_gravity;
+protected:
+    PBD::CThreadPool::Ptr           m_threadPool;
+    PBD::CSpatialHashGrid<T_real>         m_broadPhaseGrid;
+    std::vector<size_t>             m_broadPhaseCandidates;
+    PBD::CJacobiSolver<T_real>            m_jacobiSolver;
+    typename PBD::CJacobiSolver<T_real>::StoreList m_jacobiConstraints;  ///< Constraint stores of the current Jacobi solve.
+    PBD::CConstraintColoring<T_real>      m_contactColoring;      ///< Recomputed every time the contacts are created.
+    PBD::CConstraintColoring<T_real>      m_permanentColoring;    ///< Computed once and reused while m_permanentConstraints is unchanged.
+    uint64_t                        m_permanentColoringGeneration = 0;  ///< Generation of the colored store (0 if invalid).
+    std::vector<char>               m_shapeMatchingOK;      ///< Convergence flag of each shape-matching object.
+    std::vector<unsigned int>       m_shapeMatchingIterations;
+    size_t                          m_shapeMatchingCheckedSize = 0;
+    bool                            m_shapeMatchingDisjoint = false;  ///< Objects share no particle and can run concurrently.
+    std::vector<char>               m_broadPhaseActive;     ///< Particles taken into account by the broad phase.
+    size_t                          m_broadPhaseNumInactive = 0;
+    std::vector<size_t>             m_broadPhaseParticles;  ///< Active particles, when some are inactive.
+    std::vector<T_vector>    m_broadPhasePoints;     ///< Predicted positions of the active particles.
+    bool                            m_objectsValid = false; ///< m_objectOf matches the particle groups.
+    size_t                          m_objectsSize = 0;
+    std::vector<size_t>             m_objectGroups;         ///< Group of each object, sorted.
+    std::vector<size_t>             m_objectOf;             ///< Object of each particle.
+    std::vector<size_t>             m_objectStart;          ///< First entry of each object in m_objectParticles.
+    std::vector<size_t>             m_objectParticles;      ///< Particles sorted by object.
+    std::vector< Eigen::AlignedBox<T_real,3> > m_objectBounds;   ///< Bounds of the particle spheres of each object.
+    PBD::CSweepAndPrune<T_real>     m_objectSweep;
+    std::vector< typename PBD::CSweepAndPrune<T_real>::Pair > m_objectPairs;  ///< Objects with overlapping bounds.
+    std::vector<char>               m_objectAwake;          ///< Objects with particles that search for contacts.
+    std::vector<size_t>             m_objectRegionCount;
+    std::vector<size_t>             m_objectRegionFill;
+    std::vector<size_t>             m_objectRegionStart;    ///< First entry of each object in m_objectRegions.
+    std::vector< Eigen::AlignedBox<T_real,3> > m_objectRegions;  ///< Overlaps of each object with the other objects.
+    std::vector<size_t>             m_staticContactStart;   ///< First entry of each static collider in m_staticContactParticles.
+    std::vector<size_t>             m_staticContactParticles;   ///< Particles close to each static collider.
+    std::vector<char>               m_staticContactFlags;   ///< Particles close to the collider being processed.
+    PBD::CSpatialHashGrid<T_real>         m_rigidBodyGrid;        ///< Broad phase of the rigid body bounding spheres.
+    std::vector<T_vector>    m_rigidBodyCenters;
+    std::vector<size_t>             m_rigidBodyCandidates;
+    std::vector<char>               m_rigidBodyTouched;     ///< Rigid bodies with particles in the current constraints.
+    PBD::CUnionFind                 m_islands;
+    std::vector<char>               m_sleeping;             ///< Sleep flag of each particle.
+    std::vector<unsigned int>       m_sleepCounter;         ///< Consecutive steps each particle spent in a slow island.
+    std::vector<size_t>             m_islandOf;             ///< Island of each particle at the last update (noIsland if static).
+    std::vector<size_t>             m_islandRoot;
+    std::vector<size_t>             m_islandStart;          ///< First entry of each island in m_islandParticles.
+    std::vector<size_t>             m_islandParticles;      ///< Particles sorted by island.
+    std::vector<double>             m_islandEnergy;
+    std::vector<double>             m_islandMass;
+    std::vector<char>               m_islandAwake;
+    size_t                          m_numIslands = 0;
+    size_t                          m_numActiveParticles = 0;
+    size_t                          m_numSleepingParticles = 0;
+    bool                            m_sleepStateChanged = false;
+    bool                            m_permanentConstraintsFiltered = false;  ///< Some permanent constraints are asleep.
+    uint64_t                        m_activePermanentGeneration = 0;    ///< Generation of m_permanentConstraints when filtered.
+    PBD::CConstraintStore<T_real>   m_activePermanentConstraints;   ///< Copy of the permanent constraints of awake islands.
+    PBD::CStepStats                 m_stepStats;            ///< Filled by step() unless _PBD_DISABLE_STEP_STATS_ is defined.
+    PBD::CContactCache<T_real>      m_contactCache;         ///< Contacts of the last contact solve, for warm starting.
 };
 
-bool CWorld::collision(CParticle<>* p1, CParticle<>* p2)
+template<typename T_real>
+bool CWorld<T_real>::collision(const size_t& p1, const size_t& p2)
 {
-    if (p1->m_group == p2->m_group) return false;
+    if (m_particles.m_group[p1] == m_particles.m_group[p2]) return false;
 
-    double distance = (p1->m_predPosition- p2->m_predPosition).norm();
-    double partSize = (p1->m_size+p2->m_size)*0.5;
+    T_real distance = (m_particles.m_predPosition[p1] - m_particles.m_predPosition[p2]).norm();
+    T_real partSize = (m_particles.m_size[p1] + m_particles.m_size[p2])*T_real(0.5);
     return distance <= partSize;
 }
 
-void CWorld::getIJFromIdx(size_t idx, const std::vector<size_t> &layout, size_t &i, size_t &j)
+template<typename T_real>
+void CWorld<T_real>::getIJFromIdx(size_t idx, const std::vector<size_t> &layout, size_t &i, size_t &j)
 {
     size_t lidx = 0;
     while(idx > layout[lidx])
@@ -72,139 +209,1436 @@ void CWorld::getIJFromIdx(size_t idx, const std::vector<size_t> &layout, size_t
     j=idx;
 }
 
-void CWorld::createCollisionConstraints()
+template<typename T_real>
+void CWorld<T_real>::createCollisionConstraints()
 {
-    //TODO: Broad phase (use particle system bounding boxes)
+    //Broad phase: bin the predicted positions in a uniform hash grid. Two particles can only be in contact if their
+    //distance is below (size1+size2)/2 <= max size, so with that cell size only the 27 neighbouring cells are visited.
+    T_real maxSize = 0;
+    for (size_t i=0; i<m_particles.size(); ++i)
+    {
+        maxSize = std::max(maxSize, m_particles.m_size[i]);
+    }
+    if (maxSize <= 0)
+    {
+        createCollisionConstraintsBruteForce();
+        return;
+    }
+
+    //Object broad phase: the particles of an object can only touch the particles of the objects whose bounds
+    //overlap its own
+    updateBroadPhaseObjects();
+    const size_t numObjects = m_objectBounds.size();
+    const size_t maxObjectRegions = 8;
+
+    //With sleeping, static and sleeping particles are passive: they do not search for contacts, the awake particles
+    //look for them in both directions. A contact between an awake and a sleeping particle wakes the sleeping island
+    //and the narrow phase is run again with it awake.
+    const bool withSleeping = m_sleepingEnabled && m_sleeping.size() == m_particles.size();
+    auto passive = [this, withSleeping](const size_t& p)
+    {
+        return withSleeping && (m_particles.m_mass[p] <= 0 || m_sleeping[p]);
+    };
 
+    const bool rigidBodiesFiltered = (m_broadPhaseNumInactive > 0 && m_broadPhaseActive.size() == m_particles.size());
+    const size_t firstConstraint = m_constraints.m_noPenetration.size();
+    do
+    {
+        m_constraints.m_noPenetration.erase(m_constraints.m_noPenetration.begin() + firstConstraint, m_constraints.m_noPenetration.end());
+
+        //A contact between two objects lies in the intersection of their bounds. Each overlapping pair with an awake
+        //object adds that region to both objects. Objects with too many pairs keep the union of their regions.
+        m_objectAwake.assign(numObjects, 0);
+        for (size_t o=0; o<numObjects; ++o)
+        {
+            for (size_t k=m_objectStart[o]; k<m_objectStart[o+1] && !m_objectAwake[o]; ++k)
+            {
+                m_objectAwake[o] = !passive(m_objectParticles[k]);
+            }
+        }
+
+        m_objectRegionCount.assign(numObjects, 0);
+        for (const auto& pair:m_objectPairs)
+        {
+            if (m_objectAwake[pair.first] || m_objectAwake[pair.second])
+            {
+                ++m_objectRegionCount[pair.first];
+                ++m_objectRegionCount[pair.second];
+            }
+        }
+        m_objectRegionStart.resize(numObjects + 1);
+        m_objectRegionStart[0] = 0;
+        for (size_t o=0; o<numObjects; ++o)
+        {
+            m_objectRegionStart[o+1] = m_objectRegionStart[o] + (m_objectRegionCount[o] > maxObjectRegions ? 1 : m_objectRegionCount[o]);
+        }
+        m_objectRegions.assign(m_objectRegionStart.back(), Eigen::AlignedBox<T_real,3>());
+        m_objectRegionFill.assign(m_objectRegionStart.begin(), m_objectRegionStart.end()-1);
+        auto addRegion = [this, maxObjectRegions](const size_t& o, const Eigen::AlignedBox<T_real,3>& region)
+        {
+            if (m_objectRegionCount[o] > maxObjectRegions) m_objectRegions[ m_objectRegionStart[o] ].extend(region);
+            else m_objectRegions[ m_objectRegionFill[o]++ ] = region;
+        };
+        for (const auto& pair:m_objectPairs)
+        {
+            if (m_objectAwake[pair.first] || m_objectAwake[pair.second])
+            {
+                const Eigen::AlignedBox<T_real,3> region = m_objectBounds[pair.first].intersection(m_objectBounds[pair.second]);
+                addRegion(pair.first, region);
+                addRegion(pair.second, region);
+            }
+        }
+
+        //Only the particles whose sphere reaches a region of their object are binned. Particles of isolated rigid
+        //bodies are left out. The grid indexes the compacted list of particles, which keeps them in increasing order.
+        m_broadPhaseParticles.clear();
+        m_broadPhasePoints.clear();
+        for (size_t i=0; i<m_particles.size(); ++i)
+        {
+            if (rigidBodiesFiltered && !m_broadPhaseActive[i]) continue;
+
+            const size_t o = m_objectOf[i];
+            const T_real radius = m_particles.m_size[i] * T_real(0.5);
+            for (size_t r=m_objectRegionStart[o]; r<m_objectRegionStart[o+1]; ++r)
+            {
+                if (m_objectRegions[r].squaredExteriorDistance(m_particles.m_predPosition[i]) <= radius*radius)
+                {
+                    m_broadPhaseParticles.push_back(i);
+                    m_broadPhasePoints.push_back(m_particles.m_predPosition[i]);
+                    break;
+                }
+            }
+        }
+        m_broadPhaseGrid.build(m_broadPhasePoints, maxSize);
+        _PBD_STEP_STATS_( m_stepStats.m_numObjectPairs = m_objectPairs.size(); )
+        _PBD_STEP_STATS_( m_stepStats.m_numBroadPhaseParticles = m_broadPhaseParticles.size(); )
+
+        //Narrow phase. Candidates are sorted so the constraints are created in the same order as the brute force search.
+        for (size_t k=0; k<m_broadPhaseParticles.size(); ++k)
+        {
+            const size_t i = m_broadPhaseParticles[k];
+            if (passive(i)) continue;
+
+            m_broadPhaseCandidates.clear();
+            m_broadPhaseGrid.query(m_particles.m_predPosition[i], m_broadPhaseCandidates);
+
+            auto last = std::remove_if(m_broadPhaseCandidates.begin(), m_broadPhaseCandidates.end(),
+                                       [&](const size_t& l){ return l == k || (l < k && !passive(m_broadPhaseParticles[l])); });
+            std::sort(m_broadPhaseCandidates.begin(), last);
+            last = std::unique(m_broadPhaseCandidates.begin(), last);
+
+            for (auto it = m_broadPhaseCandidates.begin(); it < last; ++it)
+            {
+                const size_t j = m_broadPhaseParticles[*it];
+
+                //Create a non-penetration constraint if the particles are in contact
+                if (collision(i,j))
+                {
+                    m_constraints.m_noPenetration.emplace_back(i,j);
+                }
+            }
+        }
+    } while (withSleeping && wakeContactIslands(firstConstraint));
+}
+
+template<typename T_real>
+void CWorld<T_real>::updateBroadPhaseObjects()
+{
+    //The objects are the particle groups, since particles of the same group never collide. They are only rebuilt
+    //when the number of particles changes: call invalidateBroadPhaseObjects() after editing m_group.
+    if (!m_objectsValid || m_objectsSize != m_particles.size())
+    {
+        m_objectGroups = m_particles.m_group;
+        std::sort(m_objectGroups.begin(), m_objectGroups.end());
+        m_objectGroups.erase(std::unique(m_objectGroups.begin(), m_objectGroups.end()), m_objectGroups.end());
+
+        m_objectOf.resize(m_particles.size());
+        m_objectStart.assign(m_objectGroups.size() + 1, 0);
+        for (size_t i=0; i<m_particles.size(); ++i)
+        {
+            m_objectOf[i] = std::lower_bound(m_objectGroups.begin(), m_objectGroups.end(), m_particles.m_group[i]) - m_objectGroups.begin();
+            ++m_objectStart[ m_objectOf[i] + 1 ];
+        }
+        for (size_t o=0; o<m_objectGroups.size(); ++o)
+        {
+            m_objectStart[o+1] += m_objectStart[o];
+        }
+        m_objectRegionFill.assign(m_objectStart.begin(), m_objectStart.end()-1);
+        m_objectParticles.resize(m_particles.size());
+        for (size_t i=0; i<m_particles.size(); ++i)
+        {
+            m_objectParticles[ m_objectRegionFill[ m_objectOf[i] ]++ ] = i;
+        }
 
-    //Narrow phase (detect collisions between particle systems that might be in contact)
-    //Create non-penetration constraints among each penetrating point-pair
-    std::vector< size_t > numParticles(m_particles.size());
+        m_objectsValid = true;
+        m_objectsSize = m_particles.size();
+    }
 
-    for (uint i=0; i<m_particles.size(); ++i)
+    //Refit the bounds around the spheres of the particles. Isolated rigid bodies did not generate their particles,
+    //their bounding sphere is used instead.
+    m_objectBounds.resize(m_objectGroups.size());
+    auto refit = [this](size_t o, size_t)
     {
-        for(uint j=i+1; j<m_particles.size(); ++j)
+        Eigen::AlignedBox<T_real,3>& bounds = m_objectBounds[o];
+        bounds.setEmpty();
+        for (size_t k=m_objectStart[o]; k<m_objectStart[o+1]; ++k)
         {
-            //Obtain the pointer to the indexed particles
-            CParticle<>* p1 = m_particles[i].get();
-            CParticle<>* p2 = m_particles[j].get();
+            const size_t p = m_objectParticles[k];
+            const size_t b = m_particles.m_rigidBody[p];
+            if (b != noRigidBody && m_rigidBodies[b]->m_isolated)
+            {
+                const T_vector radius = T_vector::Constant(m_rigidBodies[b]->m_radius);
+                bounds.extend(m_rigidBodies[b]->m_predPosition - radius);
+                bounds.extend(m_rigidBodies[b]->m_predPosition + radius);
+            }
+            else
+            {
+                const T_vector radius = T_vector::Constant(m_particles.m_size[p] * T_real(0.5));
+                bounds.extend(m_particles.m_predPosition[p] - radius);
+                bounds.extend(m_particles.m_predPosition[p] + radius);
+            }
+        }
+    };
+    if (getNumThreads() > 1)
+    {
+        m_threadPool->parallelForDynamic(0, m_objectBounds.size(), refit);
+    }
+    else
+    {
+        for (size_t o=0; o<m_objectBounds.size(); ++o) refit(o, 0);
+    }
+
+    m_objectSweep.update(m_objectBounds, m_objectPairs);
+}
 
+template<typename T_real>
+void CWorld<T_real>::invalidateBroadPhaseObjects()
+{
+    m_objectsValid = false;
+}
+
+template<typename T_real>
+void CWorld<T_real>::createCollisionConstraintsBruteForce()
+{
+    //Test every particle pair. Reference implementation for the hash grid broad phase.
+    for (size_t i=0; i<m_particles.size(); ++i)
+    {
+        for(size_t j=i+1; j<m_particles.size(); ++j)
+        {
             //Create a non-penetration constraint if the particles are in contact
-            if (collision(p1,p2))
+            if (collision(i,j))
             {
-                m_constraints.emplace_back( CConstraint<>::Ptr( new CNoPenetrationConstraint<>(p1,p2) ) );
+                m_constraints.m_noPenetration.emplace_back(i,j);
             }
         }
     }
 }
 
-void CWorld::step(const double & timeStep, const double & timeout)
+template<typename T_real>
+void CWorld<T_real>::createStaticColliderContacts()
+{
+    //One pass over the predicted positions per collider. The particles closer to the surface than their size are
+    //kept, so the ones the contacts push towards it during the solve are projected too. The queries are flagged
+    //concurrently (a mesh query is a tree traversal) and the flagged particles are gathered in order.
+    m_staticContactStart.clear();
+    m_staticContactParticles.clear();
+    m_staticContactStart.push_back(0);
+
+    const bool rigidBodiesFiltered = (m_broadPhaseNumInactive > 0 && m_broadPhaseActive.size() == m_particles.size());
+    m_staticContactFlags.resize(m_particles.size());
+    m_staticColliders.forEach([this, rigidBodiesFiltered](const auto& collider)
+    {
+        auto flag = [this, rigidBodiesFiltered, &collider](size_t b, size_t e, size_t)
+        {
+            T_vector normal;
+            for (size_t i=b; i<e; ++i)
+            {
+                m_staticContactFlags[i] = 0;
+                if (m_particles.m_mass[i] <= 0 || isSleeping(i) || (rigidBodiesFiltered && !m_broadPhaseActive[i])) continue;
+
+                const T_real size = m_particles.m_size[i];
+                m_staticContactFlags[i] = collider.signedDistance(m_particles.m_predPosition[i], normal, size) < size;
+            }
+        };
+        if (getNumThreads() > 1)
+        {
+            m_threadPool->parallelFor(0, m_particles.size(), flag);
+        }
+        else
+        {
+            flag(0, m_particles.size(), 0);
+        }
+
+        for (size_t i=0; i<m_particles.size(); ++i)
+        {
+            if (m_staticContactFlags[i]) m_staticContactParticles.push_back(i);
+        }
+        m_staticContactStart.push_back(m_staticContactParticles.size());
+    });
+    _PBD_STEP_STATS_( m_stepStats.m_numStaticContacts = m_staticContactParticles.size(); )
+}
+
+template<typename T_real>
+void CWorld<T_real>::projectStaticColliders()
+{
+    if (m_staticContactStart.size() != m_staticColliders.size() + 1) return;
+
+    //Move the particles that penetrate a collider to its surface along the normal. Each collider touches a particle
+    //at most once, so its particles are projected concurrently.
+    size_t c = 0;
+    m_staticColliders.forEach([this, &c](const auto& collider)
+    {
+        auto project = [this, &collider](size_t b, size_t e, size_t)
+        {
+            T_vector normal;
+            for (size_t k=b; k<e; ++k)
+            {
+                const size_t p = m_staticContactParticles[k];
+                const T_real radius = m_particles.m_size[p] * T_real(0.5);
+                const T_real distance = collider.signedDistance(m_particles.m_predPosition[p], normal, radius);
+                if (distance < radius) m_particles.m_predPosition[p] += normal * (radius - distance);
+            }
+        };
+        const size_t begin = m_staticContactStart[c];
+        const size_t end = m_staticContactStart[c+1];
+        ++c;
+        if (getNumThreads() > 1)
+        {
+            m_threadPool->parallelFor(begin, end, project);
+        }
+        else
+        {
+            project(begin, end, 0);
+        }
+    });
+}
+
+template<typename T_real>
+void CWorld<T_real>::warmStartContacts()
+{
+    //The Jacobi solver averages the corrections, so the separation of a contact is not known. Shape matching and
+    //rigid bodies move the particles again after the contact solve, so their cached separations overshoot: warm
+    //starting pays off on free particles (piles, granular material).
+    if (m_contactWarmStarting <= 0 || m_solverMode == JACOBI) return;
+
+    m_contactCache.warmStart(m_constraints.m_noPenetration, m_particles, m_contactWarmStarting);
+    _PBD_STEP_STATS_( m_stepStats.m_numWarmStartedContacts = m_contactCache.getNumWarmStarted(); )
+}
+
+template<typename T_real>
+void CWorld<T_real>::updateContactCache()
+{
+    if (m_contactWarmStarting <= 0 || m_solverMode == JACOBI)
+    {
+        if (m_contactCache.size() > 0) m_contactCache.clear();
+        return;
+    }
+
+    m_contactCache.update(m_constraints.m_noPenetration);
+}
+
+template<typename T_real>
+void CWorld<T_real>::clearContactCache()
+{
+    m_contactCache.clear();
+}
+
+template<typename T_real>
+void CWorld<T_real>::step(const T_real & timeStep, const double & timeout)
 {
     // TIMING VARIABLES
     auto start = std::chrono::high_resolution_clock::now();
-    auto elapsed = std::chrono::high_resolution_clock::now() - start;
-    double elapsed_seconds = (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) / double(1000.0);
+    auto elapsedSeconds = [&start]()
+    {
+        auto elapsed = std::chrono::high_resolution_clock::now() - start;
+        return (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) / double(1000.0);
+    };
+    double elapsed_seconds = elapsedSeconds();
+
+    _PBD_STEP_STATS_( m_stepStats = CStepStats(); )
+    _PBD_STEP_STATS_( auto lap = start; )
+    _PBD_STEP_STATS_( auto phaseSeconds = [&lap]()
+    {
+        auto now = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(now - lap).count();
+        lap = now;
+        return seconds;
+    }; )
 
     // SOLVE CONTACTS FIRST TO PRE-STABILIZE
+    wakeExternalForceIslands();
+    updateRigidBodyParticles();
     m_constraints.clear();
     createCollisionConstraints();
+    createStaticColliderContacts();
+    setupConstraintSolver(false);
     bool constraintsOK = true;
     uint i = 0;
     uint maxIter = 5;
     do
     {
-
-        for (auto it = m_constraints.begin(); it < m_constraints.end(); ++it)
-        {
-            (*it)->project();
-            constraintsOK = constraintsOK && (*it)->isPredSatisfied();
-        }
+        constraintsOK = constraintSolverIteration(false);
+        elapsed_seconds = elapsedSeconds();
         ++i;
     } while(elapsed_seconds < timeout && !constraintsOK && i<maxIter);
+    foldRigidBodyCorrections();
     updatePositionsWithPredPositions();
+    _PBD_STEP_STATS_( m_stepStats.m_preStabilizationIterations = i; )
+    _PBD_STEP_STATS_( m_stepStats.m_numPreStabilizationConstraints = m_constraints.size(); )
+    _PBD_STEP_STATS_( m_stepStats.m_timeoutHit = !constraintsOK && i<maxIter; )
+    _PBD_STEP_STATS_( m_stepStats.m_preStabilizationTime = phaseSeconds(); )
 
     // ADD GRAVITY AND PREDICT NEW POSITIONS
     applyGravity();
     symplecticEulerUpdate(timeStep);
     clearExternalForces();
+    updateRigidBodyParticles();
+    _PBD_STEP_STATS_( m_stepStats.m_integrationTime = phaseSeconds(); )
 
-    // SOLVE CONTACT CONSTRAINTS
+    // SOLVE CONTACT AND PERMANENT CONSTRAINTS
     m_constraints.clear();
     createCollisionConstraints();
+    createStaticColliderContacts();
+    warmStartContacts();
+    setupConstraintSolver(true);
+    _PBD_STEP_STATS_( m_stepStats.m_collisionDetectionTime = phaseSeconds(); )
     constraintsOK = true;
     i = 0;
     maxIter = 5;
     do
     {
-
-        for (auto it = m_constraints.begin(); it < m_constraints.end(); ++it)
-        {
-            (*it)->project();
-            constraintsOK = constraintsOK && (*it)->isPredSatisfied();
-        }
+        constraintsOK = constraintSolverIteration(true);
+        elapsed_seconds = elapsedSeconds();
         ++i;
     } while(elapsed_seconds < timeout && !constraintsOK && i<maxIter);
+    foldRigidBodyCorrections();
+    updateContactCache();
+    _PBD_STEP_STATS_( m_stepStats.m_contactIterations = i; )
+    _PBD_STEP_STATS_( m_stepStats.m_timeoutHit = m_stepStats.m_timeoutHit || (!constraintsOK && i<maxIter); )
+    _PBD_STEP_STATS_( computeConstraintErrors(); )
+    _PBD_STEP_STATS_( m_stepStats.m_contactSolveTime = phaseSeconds(); )
 
     // SOLVE SHAPE-MATCHING CONSTRAINTS
-    i = 0;
     maxIter = 5000;
-    do
+    constraintsOK = shapeMatchingSolver(maxIter, start, timeout);
+    _PBD_STEP_STATS_( m_stepStats.m_shapeMatchingTime = phaseSeconds(); )
+
+    updateVelocities(timeStep);
+    updatePositionsWithPredPositions();
+
+    // PUT ISLANDS AT REST TO SLEEP
+    updateIslands();
+    _PBD_STEP_STATS_( m_stepStats.m_numActiveParticles = getNumActiveParticles(); )
+    _PBD_STEP_STATS_( m_stepStats.m_velocityUpdateTime = phaseSeconds(); )
+    _PBD_STEP_STATS_( m_stepStats.m_totalTime = std::chrono::duration<double>(lap - start).count(); )
+}
+
+template<typename T_real>
+void CWorld<T_real>::computeConstraintErrors()
+{
+    //Violation left by the contact solve on the contact and permanent constraints
+    const PBD::CConstraintStore<T_real>& permanentConstraints =
+            m_permanentConstraintsFiltered ? m_activePermanentConstraints : m_permanentConstraints;
+
+    double maxError = 0;
+    double sumError2 = 0;
+    auto accumulate = [this, &maxError, &sumError2](const auto& c)
     {
-        constraintsOK = true;
-        for( auto it = m_shapeMatchingConstraints.begin(); it<m_shapeMatchingConstraints.end(); ++it)
+        double err = c.getPredError(m_particles);
+        maxError = std::max(maxError, err);
+        sumError2 += err*err;
+    };
+    m_constraints.forEach(accumulate);
+    permanentConstraints.forEach(accumulate);
+
+    const size_t numConstraints = m_constraints.size() + permanentConstraints.size();
+    m_stepStats.m_numContactConstraints = m_constraints.size();
+    m_stepStats.m_numPermanentConstraints = permanentConstraints.size();
+    m_stepStats.m_maxError = maxError;
+    m_stepStats.m_rmsError = numConstraints > 0 ? std::sqrt(sumError2 / numConstraints) : 0.0;
+}
+
+template<typename T_real>
+const PBD::CStepStats& CWorld<T_real>::getStepStats() const
+{
+    return m_stepStats;
+}
+
+template<typename T_real>
+void CWorld<T_real>::setupConstraintSolver(bool withPermanentConstraints)
+{
+    if (withPermanentConstraints) updateActivePermanentConstraints();
+    const PBD::CConstraintStore<T_real>& permanentConstraints =
+            m_permanentConstraintsFiltered ? m_activePermanentConstraints : m_permanentConstraints;
+
+    if (m_solverMode == COLORED_GAUSS_SEIDEL && getNumThreads() > 1)
+    {
+        m_contactColoring.color(m_constraints, m_particles);
+        if (withPermanentConstraints &&
+            m_permanentColoringGeneration != permanentConstraints.getGeneration())
         {
-            constraintsOK = (*it)->project();
+            m_permanentColoring.color(permanentConstraints, m_particles);
+            m_permanentColoringGeneration = permanentConstraints.getGeneration();
         }
+        return;
+    }
 
-        elapsed = std::chrono::high_resolution_clock::now() - start;
-        elapsed_seconds = (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) / double(1000.0);
-        ++i;
-    } while(elapsed_seconds < timeout && !constraintsOK && i<maxIter);
+    if (m_solverMode != JACOBI) return;
 
-    updateVelocities(timeStep);
-    updatePositionsWithPredPositions();
+    m_jacobiConstraints.clear();
+    m_jacobiConstraints.push_back(&m_constraints);
+    if (withPermanentConstraints)
+    {
+        m_jacobiConstraints.push_back(&permanentConstraints);
+    }
+    m_jacobiSolver.setup(m_jacobiConstraints, m_particles.size());
+}
+
+template<typename T_real>
+bool CWorld<T_real>::constraintSolverIteration(bool withPermanentConstraints)
+{
+    bool constraintsOK = true;
+    if (m_solverMode == JACOBI)
+    {
+        constraintsOK = jacobiSolver();
+    }
+    else if (m_solverMode == COLORED_GAUSS_SEIDEL && getNumThreads() > 1)
+    {
+        constraintsOK = coloredGaussSeidelSolver(withPermanentConstraints);
+    }
+    else
+    {
+        //Single threaded colored Gauss-Seidel runs the serial loop, so it gives the same results as GAUSS_SEIDEL
+        constraintsOK = gaussSeidelSolver(m_constraints);
+        if (withPermanentConstraints)
+        {
+            constraintsOK = gaussSeidelSolver(m_permanentConstraintsFiltered ? m_activePermanentConstraints : m_permanentConstraints) && constraintsOK;
+        }
+    }
+
+    //Static colliders last, so no particle is left inside the static geometry. Their projection is exact and does
+    //not take part in the convergence test.
+    projectStaticColliders();
+    return constraintsOK;
+}
+
+template<typename T_real>
+bool CWorld<T_real>::gaussSeidelSolver(PBD::CConstraintStore<T_real>& constraints)
+{
+    bool constraintsOK = true;
+    constraints.forEachArray([this, &constraintsOK](auto& typed)
+    {
+        for (auto& c:typed)
+        {
+            c.project(m_particles);
+            constraintsOK = constraintsOK && c.isPredSatisfied(m_particles);
+        }
+    });
+    return constraintsOK;
+}
+
+template<typename T_real>
+bool CWorld<T_real>::jacobiSolver()
+{
+    if (!m_threadPool) setNumThreads(1);
+    return m_jacobiSolver.iterate(m_jacobiConstraints, m_particles, *m_threadPool.get(), m_jacobiRelaxation);
+}
+
+template<typename T_real>
+bool CWorld<T_real>::coloredGaussSeidelSolver(bool withPermanentConstraints)
+{
+    bool constraintsOK = m_contactColoring.project(m_constraints, m_particles, *m_threadPool.get());
+    if (withPermanentConstraints)
+    {
+        constraintsOK = m_permanentColoring.project(m_permanentConstraintsFiltered ? m_activePermanentConstraints : m_permanentConstraints,
+                                                    m_particles, *m_threadPool.get()) && constraintsOK;
+    }
+    return constraintsOK;
+}
+
+template<typename T_real>
+bool CWorld<T_real>::shapeMatchingSolver(const uint& maxIter,
+                                 const std::chrono::high_resolution_clock::time_point& start,
+                                 const double& timeout)
+{
+    const size_t numObjects = m_shapeMatchingConstraints.size();
+
+    //Objects can only be solved concurrently if their particle sets are disjoint
+    if (m_shapeMatchingCheckedSize != numObjects)
+    {
+        std::vector<char> owned(m_particles.size(), 0);
+        m_shapeMatchingDisjoint = true;
+        for (const auto& c:m_shapeMatchingConstraints)
+        {
+            for (const auto& p:c->m_particles)
+            {
+                m_shapeMatchingDisjoint = m_shapeMatchingDisjoint && !owned[p];
+                owned[p] = 1;
+            }
+        }
+        m_shapeMatchingCheckedSize = numObjects;
+    }
+
+    //Each object iterates until its own convergence, the iteration cap or the step timeout
+    m_shapeMatchingOK.assign(numObjects, 1);
+    m_shapeMatchingIterations.assign(numObjects, 0);
+    const bool withSleeping = m_sleepingEnabled && m_sleeping.size() == m_particles.size();
+    auto solveObject = [this, &maxIter, &start, &timeout, withSleeping](size_t c, size_t)
+    {
+        if (withSleeping && !m_shapeMatchingConstraints[c]->m_particles.empty() &&
+            m_sleeping[ m_shapeMatchingConstraints[c]->m_particles[0] ]) return;
+
+        uint i = 0;
+        bool constraintsOK;
+        double elapsed_seconds;
+        do
+        {
+            constraintsOK = m_shapeMatchingConstraints[c]->project();
+            auto elapsed = std::chrono::high_resolution_clock::now() - start;
+            elapsed_seconds = (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) / double(1000.0);
+            ++i;
+        } while(elapsed_seconds < timeout && !constraintsOK && i<maxIter);
+        m_shapeMatchingOK[c] = constraintsOK;
+        m_shapeMatchingIterations[c] = i;
+    };
+
+    if (m_shapeMatchingDisjoint && getNumThreads() > 1)
+    {
+        m_threadPool->parallelForDynamic(0, numObjects, solveObject);
+    }
+    else
+    {
+        for (size_t c=0; c<numObjects; ++c)
+        {
+            solveObject(c, 0);
+        }
+    }
+
+    //Global convergence: every object must be satisfied
+    bool constraintsOK = true;
+    for (const auto& ok:m_shapeMatchingOK)
+    {
+        constraintsOK = constraintsOK && ok;
+    }
+
+#ifndef _PBD_DISABLE_STEP_STATS_
+    m_stepStats.m_numShapeMatchingConstraints = numObjects;
+    for (size_t c=0; c<numObjects; ++c)
+    {
+        m_stepStats.m_maxShapeMatchingIterations = std::max(m_stepStats.m_maxShapeMatchingIterations, m_shapeMatchingIterations[c]);
+        m_stepStats.m_timeoutHit = m_stepStats.m_timeoutHit || (!m_shapeMatchingOK[c] && m_shapeMatchingIterations[c] < maxIter);
+    }
+#endif
+    return constraintsOK;
+}
+
+template<typename T_real>
+void CWorld<T_real>::invalidatePermanentConstraintsColoring()
+{
+    m_permanentColoringGeneration = 0;
+}
+
+/**
+ * Make the particles [partIdxIni, partIdxEnd) a rigid body. The body state is mass weighted and a body is
+ * represented by its first particle in the islands, so every particle must be dynamic: returns false, and leaves the
+ * particles as they are, if the range is empty or holds a particle without mass.
+ */
+template<typename T_real>
+bool CWorld<T_real>::addRigidBody(const size_t& partIdxIni, const size_t& partIdxEnd)
+{
+    if (partIdxIni >= partIdxEnd || partIdxEnd > m_particles.size()) return false;
+    for (size_t i=partIdxIni; i<partIdxEnd; ++i)
+    {
+        if (!(m_particles.m_mass[i] > 0))
+        {
+            _GENERIC_WARNING_("Rigid bodies need particles with mass, the particles are not made a rigid body");
+            return false;
+        }
+    }
+
+    std::fill(m_particles.m_rigidBody.begin() + partIdxIni, m_particles.m_rigidBody.begin() + partIdxEnd, m_rigidBodies.size());
+    m_rigidBodies.emplace_back( typename PBD::CRigidBody<T_real>::Ptr( new PBD::CRigidBody<T_real>(&m_particles, partIdxIni, partIdxEnd) ) );
+    return true;
+}
+
+template<typename T_real>
+void CWorld<T_real>::updateRigidBodyParticles()
+{
+    if (m_rigidBodies.empty()) return;
+
+    //Bounds of the particles that are not part of a rigid body
+    Eigen::AlignedBox<T_real,3> freeBounds;
+    T_real freeSize = 0;
+    T_real rigidSize = 0;
+    for (size_t i=0; i<m_particles.size(); ++i)
+    {
+        if (m_particles.m_rigidBody[i] == noRigidBody)
+        {
+            freeBounds.extend(m_particles.m_predPosition[i]);
+            freeSize = std::max(freeSize, m_particles.m_size[i]);
+        }
+        else
+        {
+            rigidSize = std::max(rigidSize, m_particles.m_size[i]);
+        }
+    }
+
+    //Bounding spheres of the bodies binned in a grid of twice the largest radius
+    T_real maxRadius = 0;
+    m_rigidBodyCenters.resize(m_rigidBodies.size());
+    for (size_t b=0; b<m_rigidBodies.size(); ++b)
+    {
+        m_rigidBodyCenters[b] = m_rigidBodies[b]->m_predPosition;
+        maxRadius = std::max(maxRadius, m_rigidBodies[b]->m_radius);
+    }
+    m_rigidBodyGrid.build(m_rigidBodyCenters, std::max(2*maxRadius, T_real(1e-6)));
+
+    //A body is isolated if its sphere overlaps neither the free particles nor another body, and its particles cannot
+    //get closer to a static collider than their size (see createStaticColliderContacts)
+    m_broadPhaseActive.resize(m_particles.size(), 1);
+    m_broadPhaseNumInactive = 0;
+    for (size_t b=0; b<m_rigidBodies.size(); ++b)
+    {
+        PBD::CRigidBody<T_real>& body = *m_rigidBodies[b];
+        bool isolated = freeBounds.isEmpty() ||
+                        freeBounds.exteriorDistance(body.m_predPosition) > body.m_radius + freeSize*0.5;
+
+        m_rigidBodyCandidates.clear();
+        m_rigidBodyGrid.query(body.m_predPosition, m_rigidBodyCandidates);
+        for (auto it = m_rigidBodyCandidates.begin(); isolated && it < m_rigidBodyCandidates.end(); ++it)
+        {
+            isolated = *it == b || (m_rigidBodyCenters[*it] - body.m_predPosition).norm() > body.m_radius + m_rigidBodies[*it]->m_radius;
+        }
+
+        isolated = isolated && !m_staticColliders.isWithin(body.m_predPosition, body.m_radius + rigidSize*T_real(0.5));
+
+        body.m_isolated = isolated;
+        std::fill(m_broadPhaseActive.begin() + body.m_idxIni, m_broadPhaseActive.begin() + body.m_idxEnd, !isolated);
+        if (isolated) m_broadPhaseNumInactive += body.m_idxEnd - body.m_idxIni;
+    }
+
+    //Particles are only generated where contacts may need them
+    auto generate = [this](size_t b, size_t)
+    {
+        if (!m_rigidBodies[b]->m_isolated && !isSleeping(m_rigidBodies[b]->m_idxIni)) m_rigidBodies[b]->generateParticles();
+    };
+    if (getNumThreads() > 1)
+    {
+        m_threadPool->parallelForDynamic(0, m_rigidBodies.size(), generate);
+    }
+    else
+    {
+        for (size_t b=0; b<m_rigidBodies.size(); ++b) generate(b, 0);
+    }
+}
+
+template<typename T_real>
+void CWorld<T_real>::foldRigidBodyCorrections()
+{
+    if (m_rigidBodies.empty()) return;
+
+    //Only the bodies referenced by a constraint may have been moved by the solver
+    m_rigidBodyTouched.assign(m_rigidBodies.size(), 0);
+    auto touch = [this](const auto& c)
+    {
+        for (const auto& p:c.m_particles)
+        {
+            if (m_particles.m_rigidBody[p] != noRigidBody) m_rigidBodyTouched[ m_particles.m_rigidBody[p] ] = 1;
+        }
+    };
+    m_constraints.forEach(touch);
+    (m_permanentConstraintsFiltered ? m_activePermanentConstraints : m_permanentConstraints).forEach(touch);
+    for (const auto& p:m_staticContactParticles)
+    {
+        if (m_particles.m_rigidBody[p] != noRigidBody) m_rigidBodyTouched[ m_particles.m_rigidBody[p] ] = 1;
+    }
+
+    auto fold = [this](size_t b, size_t)
+    {
+        if (m_rigidBodyTouched[b])
+        {
+            m_rigidBodies[b]->foldCorrections();
+            m_rigidBodies[b]->generateParticles();
+        }
+    };
+    if (getNumThreads() > 1)
+    {
+        m_threadPool->parallelForDynamic(0, m_rigidBodies.size(), fold);
+    }
+    else
+    {
+        for (size_t b=0; b<m_rigidBodies.size(); ++b) fold(b, 0);
+    }
+}
+
+template<typename T_real>
+void CWorld<T_real>::syncRigidBodyParticles()
+{
+    //step() only generates the particles of rigid bodies that may be in contact and does not keep their velocities
+    //and orientations. Call this before reading every particle (e.g. for rendering).
+    for (auto& body:m_rigidBodies)
+    {
+        body->syncParticles();
+    }
+}
+
+template<typename T_real>
+void CWorld<T_real>::updateIslands()
+{
+    if (!m_sleepingEnabled) return;
+
+    const size_t n = m_particles.size();
+    m_sleeping.resize(n, 0);
+    m_sleepCounter.resize(n, 0);
+
+    //Islands: dynamic particles linked by contacts, permanent constraints, shape-matching objects and rigid bodies
+    m_islands.reset(n);
+    auto link = [this](const auto& particles)
+    {
+        size_t first = noIsland;
+        for (const auto& p:particles)
+        {
+            if (m_particles.m_mass[p] <= 0) continue;
+            if (first == noIsland) first = p;
+            else m_islands.join(first, p);
+        }
+    };
+    auto linkConstraint = [&link](const auto& c){ link(c.m_particles); };
+    m_constraints.forEach(linkConstraint);
+    m_permanentConstraints.forEach(linkConstraint);
+    for (const auto& c:m_shapeMatchingConstraints) link(c->m_particles);
+    for (const auto& body:m_rigidBodies)
+    {
+        for (size_t i=body->m_idxIni+1; i<body->m_idxEnd; ++i) m_islands.join(body->m_idxIni, i);
+    }
+
+    //Number the islands and sort their particles (counting sort)
+    m_islandRoot.assign(n, noIsland);
+    m_islandOf.assign(n, noIsland);
+    m_numIslands = 0;
+    for (size_t i=0; i<n; ++i)
+    {
+        if (m_particles.m_mass[i] <= 0) continue;
+        size_t root = m_islands.find(i);
+        if (m_islandRoot[root] == noIsland) m_islandRoot[root] = m_numIslands++;
+        m_islandOf[i] = m_islandRoot[root];
+    }
+    m_islandStart.assign(m_numIslands+1, 0);
+    for (size_t i=0; i<n; ++i)
+    {
+        if (m_islandOf[i] != noIsland) ++m_islandStart[ m_islandOf[i]+1 ];
+    }
+    for (size_t k=0; k<m_numIslands; ++k)
+    {
+        m_islandStart[k+1] += m_islandStart[k];
+    }
+    m_islandParticles.resize(m_islandStart.back());
+    std::vector<size_t>& fill = m_islandRoot;
+    fill.assign(m_islandStart.begin(), m_islandStart.end()-1);
+    for (size_t i=0; i<n; ++i)
+    {
+        if (m_islandOf[i] != noIsland) m_islandParticles[ fill[ m_islandOf[i] ]++ ] = i;
+    }
+
+    //Kinetic energy and mass of each island. Rigid body particles do not keep their velocities, their body does.
+    m_islandEnergy.assign(m_numIslands, 0);
+    m_islandMass.assign(m_numIslands, 0);
+    m_islandAwake.assign(m_numIslands, 0);
+    for (size_t i=0; i<n; ++i)
+    {
+        const size_t k = m_islandOf[i];
+        if (k == noIsland) continue;
+        if (!m_sleeping[i]) m_islandAwake[k] = 1;
+        if (m_particles.m_rigidBody[i] == noRigidBody)
+        {
+            m_islandEnergy[k] += 0.5 * m_particles.m_mass[i] * m_particles.m_velocity[i].squaredNorm();
+            m_islandMass[k] += m_particles.m_mass[i];
+        }
+    }
+    for (const auto& body:m_rigidBodies)
+    {
+        const size_t k = m_islandOf[body->m_idxIni];
+        double rotVel = body->m_radius * body->m_angularVelocity.norm();
+        m_islandEnergy[k] += 0.5 * body->m_mass * (body->m_velocity.squaredNorm() + rotVel*rotVel);
+        m_islandMass[k] += body->m_mass;
+    }
+
+    //An island sleeps after m_sleepSteps slow steps. Islands linked to an awake particle are awake.
+    m_numActiveParticles = 0;
+    m_numSleepingParticles = 0;
+    for (size_t k=0; k<m_numIslands; ++k)
+    {
+        const size_t b = m_islandStart[k];
+        const size_t e = m_islandStart[k+1];
+        if (m_islandAwake[k])
+        {
+            const bool slow = m_islandEnergy[k] < m_sleepEnergyThreshold * m_islandMass[k];
+            unsigned int minCounter = m_sleepSteps;
+            for (size_t l=b; l<e; ++l)
+            {
+                const size_t i = m_islandParticles[l];
+                if (m_sleeping[i]) m_sleepStateChanged = true;
+                m_sleeping[i] = 0;
+                m_sleepCounter[i] = slow ? m_sleepCounter[i]+1 : 0;
+                minCounter = std::min(minCounter, m_sleepCounter[i]);
+            }
+
+            if (minCounter < m_sleepSteps)
+            {
+                m_numActiveParticles += e - b;
+                continue;
+            }
+
+            for (size_t l=b; l<e; ++l)
+            {
+                const size_t i = m_islandParticles[l];
+                m_sleeping[i] = 1;
+                m_particles.m_velocity[i] = T_vector(0,0,0);
+                m_particles.m_angularVelocity[i] = T_vector(0,0,0);
+
+                //Sleeping bodies are not generated, so their particles must be up to date when they fall asleep
+                const size_t body = m_particles.m_rigidBody[i];
+                if (body != noRigidBody && m_rigidBodies[body]->m_idxIni == i)
+                {
+                    m_rigidBodies[body]->m_velocity = T_vector(0,0,0);
+                    m_rigidBodies[body]->m_angularVelocity = T_vector(0,0,0);
+                    m_rigidBodies[body]->syncParticles();
+                }
+            }
+            m_sleepStateChanged = true;
+        }
+        m_numSleepingParticles += e - b;
+    }
 }
 
-void CWorld::clearExternalForces()
+template<typename T_real>
+void CWorld<T_real>::wakeIsland(const size_t& island)
 {
-    for( auto it = m_particles.begin(); it<m_particles.end(); ++it)
+    for (size_t l=m_islandStart[island]; l<m_islandStart[island+1]; ++l)
     {
-        (*it)->clearExtForces();
+        const size_t i = m_islandParticles[l];
+        if (m_sleeping[i])
+        {
+            m_sleeping[i] = 0;
+            --m_numSleepingParticles;
+            ++m_numActiveParticles;
+        }
+        m_sleepCounter[i] = 0;
     }
+    m_sleepStateChanged = true;
 }
 
-void CWorld::symplecticEulerUpdate( double timeStep )
+template<typename T_real>
+bool CWorld<T_real>::wakeContactIslands(const size_t& firstConstraint)
 {
-    for( auto it = m_particles.begin(); it<m_particles.end(); ++it)
+    //A sleeping particle in contact with an awake dynamic particle wakes its island
+    bool woken = false;
+    for (size_t c=firstConstraint; c<m_constraints.m_noPenetration.size(); ++c)
     {
-        (*it)->symplecticEulerUpdate(timeStep);
+        const auto& particles = m_constraints.m_noPenetration[c].m_particles;
+        bool awake = false;
+        for (const auto& p:particles)
+        {
+            awake = awake || (m_particles.m_mass[p] > 0 && !isSleeping(p));
+        }
+        if (!awake) continue;
+
+        for (const auto& p:particles)
+        {
+            if (isSleeping(p) && p < m_islandOf.size() && m_islandOf[p] != noIsland)
+            {
+                wakeIsland(m_islandOf[p]);
+                woken = true;
+            }
+        }
     }
+    return woken;
 }
 
-void CWorld::updatePositionsWithPredPositions( )
+template<typename T_real>
+void CWorld<T_real>::wakeExternalForceIslands()
 {
-    for( auto it = m_particles.begin(); it<m_particles.end(); ++it)
+    if (!m_sleepingEnabled || m_numSleepingParticles == 0) return;
+
+    //Particles added since the last island update are awake
+    m_sleeping.resize(m_particles.size(), 0);
+    m_sleepCounter.resize(m_particles.size(), 0);
+
+    for (size_t i=0; i<m_islandOf.size(); ++i)
+    {
+        if (m_sleeping[i] && !m_particles.m_extForce[i].isZero(0)) wakeIsland(m_islandOf[i]);
+    }
+    for (const auto& body:m_rigidBodies)
     {
-        (*it)->updatePositionsWithPredPositions();
+        if (isSleeping(body->m_idxIni) && !body->m_extForce.isZero(0)) wakeIsland(m_islandOf[body->m_idxIni]);
     }
 }
 
-void CWorld::updateVelocities( double timeStep )
+template<typename T_real>
+void CWorld<T_real>::updateActivePermanentConstraints()
 {
-    for( auto it = m_particles.begin(); it<m_particles.end(); ++it)
+    const bool filtered = m_sleepingEnabled && m_numSleepingParticles > 0;
+    if (filtered == m_permanentConstraintsFiltered && !m_sleepStateChanged &&
+        m_activePermanentGeneration == m_permanentConstraints.getGeneration()) return;
+
+    //The constraints of sleeping islands are left out of the solver loops
+    m_activePermanentConstraints.clear();
+    if (filtered)
     {
-        (*it)->updateVelocity(timeStep);
+        m_activePermanentConstraints.assignIf(m_permanentConstraints, [this](const auto& c)
+        {
+            bool asleep = false;
+            for (const auto& p:c.m_particles)
+            {
+                asleep = asleep || isSleeping(p);
+            }
+            return !asleep;
+        });
     }
+    m_permanentConstraintsFiltered = filtered;
+    m_activePermanentGeneration = m_permanentConstraints.getGeneration();
+    m_sleepStateChanged = false;
 }
 
-void CWorld::applyGravity()
+template<typename T_real>
+bool CWorld<T_real>::isSleeping(const size_t& p) const
 {
-    for( auto it = m_particles.begin(); it<m_particles.end(); ++it)
+    return m_sleepingEnabled && p < m_sleeping.size() && m_sleeping[p];
+}
+
+template<typename T_real>
+size_t CWorld<T_real>::getNumActiveParticles() const
+{
+    if (m_sleepingEnabled) return m_numActiveParticles;
+
+    //Without sleeping every dynamic particle is simulated
+    return m_particles.size() - std::count(m_particles.m_mass.begin(), m_particles.m_mass.end(), 0.0);
+}
+
+template<typename T_real>
+size_t CWorld<T_real>::getNumSleepingParticles() const
+{
+    return m_sleepingEnabled ? m_numSleepingParticles : 0;
+}
+
+template<typename T_real>
+size_t CWorld<T_real>::getNumIslands() const
+{
+    return m_numIslands;
+}
+
+template<typename T_real>
+void CWorld<T_real>::setNumThreads(const size_t& numThreads)
+{
+    if (!m_threadPool || m_threadPool->getNumThreads() != numThreads)
     {
-        (*it)->m_extForce += m_gravity * ( (*it)->getMass() );
+        m_threadPool = PBD::CThreadPool::Ptr( new PBD::CThreadPool(numThreads) );
     }
 }
 
+template<typename T_real>
+size_t CWorld<T_real>::getNumThreads()
+{
+    if (!m_threadPool) setNumThreads(1);
+    return m_threadPool->getNumThreads();
+}
+
+template<typename T_real>
+void CWorld<T_real>::clearExternalForces()
+{
+    std::fill(m_particles.m_extForce.begin(), m_particles.m_extForce.end(), T_vector(0,0,0));
+    for (auto& body:m_rigidBodies)
+    {
+        body->m_extForce = T_vector(0,0,0);
+    }
+}
+
+template<typename T_real>
+void CWorld<T_real>::symplecticEulerUpdate( T_real timeStep )
+{
+    const size_t n = m_particles.size();
+
+    const bool withSleeping = m_sleepingEnabled && m_sleeping.size() == n;
+
+    //Rigid bodies integrate their own state, their particles are generated from it
+    for (auto& body:m_rigidBodies)
+    {
+        if (!isSleeping(body->m_idxIni)) body->integrate(timeStep, m_gravity);
+    }
+
+    //Linear part
+    for (size_t i=0; i<n; ++i)
+    {
+        if (m_particles.m_rigidBody[i] != noRigidBody) continue;
+
+        if (m_particles.m_mass[i] <= 0 || (withSleeping && m_sleeping[i]))
+        {
+            m_particles.m_predPosition[i] = m_particles.m_position[i];
+        }
+        else
+        {
+            T_vector vel = m_particles.m_velocity[i] + m_particles.m_extForce[i] * timeStep * m_particles.m_massInv[i];
+            m_particles.m_predPosition[i] = m_particles.m_position[i] + vel * timeStep;
+        }
+    }
+
+    //Angular part
+    for (size_t i=0; i<n; ++i)
+    {
+        if (m_particles.m_rigidBody[i] != noRigidBody) continue;
+
+        const T_vector& w = m_particles.m_angularVelocity[i];
+        T_real wNorm = w.norm();
+        if (m_particles.m_mass[i] > 0 && wNorm > minRotVel && !(withSleeping && m_sleeping[i]))
+        {
+            T_vector axis = w / wNorm * sin( wNorm * timeStep / 2 );
+            T_quaternion delta;
+            delta.x() = axis.x();
+            delta.y() = axis.y();
+            delta.z() = axis.z();
+            delta.w() = cos( wNorm * timeStep / 2 );
+            m_particles.m_predOrientation[i] = delta * m_particles.m_orientation[i];
+        }
+        else
+        {
+            m_particles.m_predOrientation[i] = m_particles.m_orientation[i];
+        }
+    }
+}
+
+template<typename T_real>
+void CWorld<T_real>::updatePositionsWithPredPositions( )
+{
+    const size_t n = m_particles.size();
+    for (size_t i=0; i<n; ++i)
+    {
+        if (m_particles.m_mass[i] > 0)
+        {
+            m_particles.m_position[i] = m_particles.m_predPosition[i];
+            m_particles.m_orientation[i] = m_particles.m_predOrientation[i];
+        }
+    }
+
+    for (auto& body:m_rigidBodies)
+    {
+        body->updatePosition();
+    }
+}
+
+template<typename T_real>
+void CWorld<T_real>::updateVelocities( T_real timeStep )
+{
+    const size_t n = m_particles.size();
+    const bool withSleeping = m_sleepingEnabled && m_sleeping.size() == n;
+    for (size_t i=0; i<n; ++i)
+    {
+        if (m_particles.m_mass[i] > 0 && m_particles.m_rigidBody[i] == noRigidBody && !(withSleeping && m_sleeping[i]))
+        {
+            m_particles.m_velocity[i] = ((m_particles.m_predPosition[i] - m_particles.m_position[i]) / timeStep) * T_real(PBD::velDamping);
+        }
+    }
+
+    for (size_t i=0; i<n; ++i)
+    {
+        if (m_particles.m_mass[i] > 0 && m_particles.m_rigidBody[i] == noRigidBody && !(withSleeping && m_sleeping[i]))
+        {
+            Eigen::AngleAxis<T_real> aa( m_particles.m_predOrientation[i] * m_particles.m_orientation[i].inverse() );
+            m_particles.m_angularVelocity[i] = aa.axis() * aa.angle() / timeStep;
+        }
+    }
+
+    for (auto& body:m_rigidBodies)
+    {
+        if (!isSleeping(body->m_idxIni)) body->updateVelocity(timeStep);
+    }
+}
+
+template<typename T_real>
+void CWorld<T_real>::applyGravity()
+{
+    const size_t n = m_particles.size();
+    for (size_t i=0; i<n; ++i)
+    {
+        m_particles.m_extForce[i] += m_gravity * m_particles.m_mass[i];
+    }
+}
+
+/**
+ * Write the simulation state to a versioned binary snapshot (see SWorldSnapshotHeader): world settings, particle state,
+ * permanent distance constraints, shape-matching rest data and rigid bodies. Contacts are not saved, they are
+ * recreated by the next step. Permanent constraints of other types are skipped with a warning. Static colliders are
+ * part of the scene setup and are not saved either: loadSnapshot keeps those of the world.
+ */
+template<typename T_real>
+bool CWorld<T_real>::saveSnapshot(const std::string& filename) const
+{
+    typedef PBD::SWorldSnapshotHeader Header;
+
+    PBD::CWorldSnapshotWriter writer(filename);
+    if (!writer.isOpen())
+    {
+        _GENERIC_ERROR_("Unable to write snapshot: " + filename);
+        return false;
+    }
+
+    Header& h = writer.header();
+    h.m_solverMode = uint32_t(m_solverMode);
+    h.m_flags = (m_rigidBodyFastPath ? Header::RIGID_BODY_FAST_PATH : 0) | (m_sleepingEnabled ? Header::SLEEPING_ENABLED : 0) |
+                (sizeof(T_real) == sizeof(float) ? Header::SINGLE_PRECISION : 0);
+    h.m_sleepSteps = m_sleepSteps;
+    h.m_sleepEnergyThreshold = m_sleepEnergyThreshold;
+    h.m_jacobiRelaxation = m_jacobiRelaxation;
+    Eigen::Map<Eigen::Vector3d>(h.m_gravity) = m_gravity.template cast<double>();
+
+    //Particles
+    const size_t n = m_particles.size();
+    h.m_numParticles = n;
+    std::vector<uint64_t> groups(m_particles.m_group.begin(), m_particles.m_group.end());
+    writer.section(Header::POSITION, m_particles.m_position.data(), n);
+    writer.section(Header::PRED_POSITION, m_particles.m_predPosition.data(), n);
+    writer.section(Header::VELOCITY, m_particles.m_velocity.data(), n);
+    writer.section(Header::EXT_FORCE, m_particles.m_extForce.data(), n);
+    writer.section(Header::MASS, m_particles.m_mass.data(), n);
+    writer.section(Header::MASS_INV, m_particles.m_massInv.data(), n);
+    writer.section(Header::SIZE, m_particles.m_size.data(), n);
+    writer.section(Header::GROUP, groups.data(), n);
+    writer.section(Header::ORIENTATION, m_particles.m_orientation.data(), n);
+    writer.section(Header::PRED_ORIENTATION, m_particles.m_predOrientation.data(), n);
+    writer.section(Header::ANGULAR_VELOCITY, m_particles.m_angularVelocity.data(), n);
+
+    //Permanent distance constraints
+    std::vector<uint64_t> distanceParticles;
+    std::vector<double> distanceParameters;
+    if (m_permanentConstraints.size() != m_permanentConstraints.m_distance.size())
+    {
+        _GENERIC_WARNING_("Only distance constraints are saved in snapshots, skipping the other permanent constraints");
+    }
+    for (const auto& c:m_permanentConstraints.m_distance)
+    {
+        distanceParticles.insert(distanceParticles.end(), {c.m_particles[0], c.m_particles[1]});
+        distanceParameters.insert(distanceParameters.end(), {c.getTargetDistance(), c.getDistanceTolerance(), c.getConstraintStiffness()});
+    }
+    h.m_numDistanceConstraints = distanceParticles.size() / 2;
+    writer.section(Header::DISTANCE_PARTICLES, distanceParticles.data(), distanceParticles.size());
+    writer.section(Header::DISTANCE_PARAMETERS, distanceParameters.data(), distanceParameters.size());
+
+    //Shape matching rest data
+    std::vector<uint64_t> shapeMatchingBounds(1, 0);
+    std::vector<uint64_t> shapeMatchingParticles;
+    std::vector<T_vector> restOffsets;
+    std::vector<double> frames;
+    for (const auto& c:m_shapeMatchingConstraints)
+    {
+        shapeMatchingParticles.insert(shapeMatchingParticles.end(), c->m_particles.begin(), c->m_particles.end());
+        shapeMatchingBounds.push_back(shapeMatchingParticles.size());
+        restOffsets.insert(restOffsets.end(), c->getRestOffsets().begin(), c->getRestOffsets().end());
+
+        const T_vector restCoM = c->getCoM();
+        const T_matrix restCovariance = c->getRestCovariance();
+        const T_matrix restCovMat = c->getCovMat();
+        const T_quaternion rotation = c->getRotation();
+        frames.insert(frames.end(), restCoM.data(), restCoM.data() + 3);
+        frames.insert(frames.end(), restCovariance.data(), restCovariance.data() + 9);
+        frames.insert(frames.end(), restCovMat.data(), restCovMat.data() + 9);
+        frames.insert(frames.end(), rotation.coeffs().data(), rotation.coeffs().data() + 4);
+        frames.insert(frames.end(), {double(c->getRotationExtraction()), double(c->getRotationMaxIter())});
+    }
+    h.m_numShapeMatchingConstraints = m_shapeMatchingConstraints.size();
+    writer.section(Header::SHAPE_MATCHING_BOUNDS, shapeMatchingBounds.data(), shapeMatchingBounds.size());
+    writer.section(Header::SHAPE_MATCHING_PARTICLES, shapeMatchingParticles.data(), shapeMatchingParticles.size());
+    writer.section(Header::SHAPE_MATCHING_REST_OFFSETS, restOffsets.data(), restOffsets.size());
+    writer.section(Header::SHAPE_MATCHING_FRAMES, frames.data(), frames.size());
+
+    //Rigid bodies
+    std::vector<uint64_t> ranges;
+    std::vector<double> states;
+    std::vector<T_vector> localPositions;
+    for (const auto& body:m_rigidBodies)
+    {
+        ranges.insert(ranges.end(), {body->m_idxIni, body->m_idxEnd});
+        states.insert(states.end(), body->m_position.data(), body->m_position.data() + 3);
+        states.insert(states.end(), body->m_orientation.coeffs().data(), body->m_orientation.coeffs().data() + 4);
+        states.insert(states.end(), body->m_velocity.data(), body->m_velocity.data() + 3);
+        states.insert(states.end(), body->m_angularVelocity.data(), body->m_angularVelocity.data() + 3);
+        states.insert(states.end(), {body->m_mass, body->m_radius});
+        localPositions.insert(localPositions.end(), body->m_localPositions.begin(), body->m_localPositions.end());
+    }
+    h.m_numRigidBodies = m_rigidBodies.size();
+    writer.section(Header::RIGID_BODY_RANGES, ranges.data(), ranges.size());
+    writer.section(Header::RIGID_BODY_STATES, states.data(), states.size());
+    writer.section(Header::RIGID_BODY_LOCAL_POSITIONS, localPositions.data(), localPositions.size());
+
+    if (!writer.close())
+    {
+        _GENERIC_ERROR_("Unable to write snapshot: " + filename);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Replace the simulation state with a snapshot written by saveSnapshot. The particle arrays are copied from the
+ * mapped file in one block each; constraints and rigid bodies are rebuilt with their saved rest data. All islands
+ * start awake. m_particleSystems is not saved and is cleared, its particle indices belong to the previous contents.
+ * Returns false (and leaves the world unchanged) if the file is missing or invalid, including rigid bodies with
+ * overlapping or out of range particles, or with particles without mass.
+ */
+template<typename T_real>
+bool CWorld<T_real>::loadSnapshot(const std::string& filename)
+{
+    typedef PBD::SWorldSnapshotHeader Header;
+
+    PBD::CWorldSnapshotReader reader(filename);
+    if (!reader.isValid())
+    {
+        _GENERIC_ERROR_("Invalid snapshot: " + filename);
+        return false;
+    }
+    const Header& h = reader.header();
+    if (((h.m_flags & Header::SINGLE_PRECISION) != 0) != (sizeof(T_real) == sizeof(float)))
+    {
+        _GENERIC_ERROR_("Snapshot precision does not match the world: " + filename);
+        return false;
+    }
+
+    //Everything is read before the world is modified
+    const size_t n = h.m_numParticles;
+    PBD::CParticleStore<T_real> particles;
+    std::vector<uint64_t> groups;
+    std::vector<uint64_t> distanceParticles, shapeMatchingBounds, shapeMatchingParticles, ranges;
+    std::vector<double> distanceParameters, frames, states;
+    std::vector<T_vector> restOffsets, localPositions;
+
+    const size_t numSMParticles = reader.count<uint64_t>(Header::SHAPE_MATCHING_PARTICLES);
+    const size_t numLocalPositions = reader.count<T_vector>(Header::RIGID_BODY_LOCAL_POSITIONS);
+    bool ok = reader.read(Header::POSITION, particles.m_position, n) &&
+              reader.read(Header::PRED_POSITION, particles.m_predPosition, n) &&
+              reader.read(Header::VELOCITY, particles.m_velocity, n) &&
+              reader.read(Header::EXT_FORCE, particles.m_extForce, n) &&
+              reader.read(Header::MASS, particles.m_mass, n) &&
+              reader.read(Header::MASS_INV, particles.m_massInv, n) &&
+              reader.read(Header::SIZE, particles.m_size, n) &&
+              reader.read(Header::GROUP, groups, n) &&
+              reader.read(Header::ORIENTATION, particles.m_orientation, n) &&
+              reader.read(Header::PRED_ORIENTATION, particles.m_predOrientation, n) &&
+              reader.read(Header::ANGULAR_VELOCITY, particles.m_angularVelocity, n) &&
+              reader.read(Header::DISTANCE_PARTICLES, distanceParticles, 2 * h.m_numDistanceConstraints) &&
+              reader.read(Header::DISTANCE_PARAMETERS, distanceParameters, 3 * h.m_numDistanceConstraints) &&
+              reader.read(Header::SHAPE_MATCHING_BOUNDS, shapeMatchingBounds, h.m_numShapeMatchingConstraints + 1) &&
+              reader.read(Header::SHAPE_MATCHING_PARTICLES, shapeMatchingParticles, numSMParticles) &&
+              reader.read(Header::SHAPE_MATCHING_REST_OFFSETS, restOffsets, numSMParticles) &&
+              reader.read(Header::SHAPE_MATCHING_FRAMES, frames, Header::shapeMatchingFrameSize * h.m_numShapeMatchingConstraints) &&
+              reader.read(Header::RIGID_BODY_RANGES, ranges, 2 * h.m_numRigidBodies) &&
+              reader.read(Header::RIGID_BODY_STATES, states, Header::rigidBodyStateSize * h.m_numRigidBodies) &&
+              reader.read(Header::RIGID_BODY_LOCAL_POSITIONS, localPositions, numLocalPositions);
+
+    //Indices and bounds must stay inside the arrays
+    for (size_t i=0; ok && i<distanceParticles.size(); ++i) ok = distanceParticles[i] < n;
+    for (size_t i=0; ok && i<shapeMatchingParticles.size(); ++i) ok = shapeMatchingParticles[i] < n;
+    for (size_t c=0; ok && c<h.m_numShapeMatchingConstraints; ++c)
+    {
+        ok = shapeMatchingBounds[c] <= shapeMatchingBounds[c+1] && shapeMatchingBounds[c+1] <= numSMParticles;
+    }
+    size_t numBodyParticles = 0;
+    std::vector< std::pair<uint64_t,uint64_t> > sortedRanges;
+    for (size_t b=0; ok && b<h.m_numRigidBodies; ++b)
+    {
+        ok = ranges[2*b] < ranges[2*b+1] && ranges[2*b+1] <= n && states[Header::rigidBodyStateSize * b + 13] > 0;
+        for (size_t i=ranges[2*b]; ok && i<ranges[2*b+1]; ++i) ok = particles.m_mass[i] > 0;
+        numBodyParticles += ok ? ranges[2*b+1] - ranges[2*b] : 0;
+        sortedRanges.emplace_back(ranges[2*b], ranges[2*b+1]);
+    }
+    std::sort(sortedRanges.begin(), sortedRanges.end());
+    for (size_t b=1; ok && b<sortedRanges.size(); ++b) ok = sortedRanges[b-1].second <= sortedRanges[b].first;
+    if (!ok || numBodyParticles != numLocalPositions)
+    {
+        _GENERIC_ERROR_("Corrupted snapshot: " + filename);
+        return false;
+    }
+
+    particles.m_group.assign(groups.begin(), groups.end());
+    particles.m_rigidBody.assign(n, noRigidBody);
+    m_particles = std::move(particles);
+    m_particleSystems.clear();
+
+    m_solverMode = ESolverMode(h.m_solverMode);
+    m_rigidBodyFastPath = (h.m_flags & Header::RIGID_BODY_FAST_PATH) != 0;
+    m_sleepingEnabled = (h.m_flags & Header::SLEEPING_ENABLED) != 0;
+    m_sleepSteps = h.m_sleepSteps;
+    m_sleepEnergyThreshold = h.m_sleepEnergyThreshold;
+    m_jacobiRelaxation = h.m_jacobiRelaxation;
+    m_gravity = Eigen::Map<const Eigen::Vector3d>(h.m_gravity).cast<T_real>();
+
+    m_constraints.clear();
+    m_permanentConstraints.clear();
+    for (size_t c=0; c<h.m_numDistanceConstraints; ++c)
+    {
+        m_permanentConstraints.m_distance.emplace_back(m_particles, distanceParticles[2*c], distanceParticles[2*c+1]);
+        m_permanentConstraints.m_distance.back().setTargetDistance(distanceParameters[3*c]);
+        m_permanentConstraints.m_distance.back().setDistanceTolerance(distanceParameters[3*c+1]);
+        m_permanentConstraints.m_distance.back().setConstraintStiffness(distanceParameters[3*c+2]);
+    }
+
+    m_shapeMatchingConstraints.clear();
+    for (size_t c=0; c<h.m_numShapeMatchingConstraints; ++c)
+    {
+        const double* f = &frames[Header::shapeMatchingFrameSize * c];
+        std::vector<size_t> objectParticles(shapeMatchingParticles.begin() + shapeMatchingBounds[c],
+                                            shapeMatchingParticles.begin() + shapeMatchingBounds[c+1]);
+        typename PBD::CShapeMatchingConstraint<T_real>::Ptr pShapeMatching( new PBD::CShapeMatchingConstraint<T_real>(
+                &m_particles, objectParticles,
+                T_vector(Eigen::Map<const Eigen::Vector3d>(f).cast<T_real>()),
+                T_matrix(Eigen::Map<const Eigen::Matrix3d>(f + 3).cast<T_real>()),
+                T_matrix(Eigen::Map<const Eigen::Matrix3d>(f + 12).cast<T_real>()),
+                restOffsets.data() + shapeMatchingBounds[c]) );
+        pShapeMatching->setRotation(T_quaternion(T_real(f[24]), T_real(f[21]), T_real(f[22]), T_real(f[23])));
+        pShapeMatching->setRotationExtraction(typename PBD::CShapeMatchingConstraint<T_real>::ERotationExtraction(int(f[25])),
+                                              (unsigned int)(f[26]));
+        m_shapeMatchingConstraints.push_back(pShapeMatching);
+    }
+
+    m_rigidBodies.clear();
+    size_t localIdx = 0;
+    for (size_t b=0; b<h.m_numRigidBodies; ++b)
+    {
+        addRigidBody(ranges[2*b], ranges[2*b+1]);
+        auto& body = m_rigidBodies.back();
+        const double* state = &states[Header::rigidBodyStateSize * b];
+        body->m_position = body->m_predPosition = Eigen::Map<const Eigen::Vector3d>(state).cast<T_real>();
+        body->m_orientation.coeffs() = Eigen::Map<const Eigen::Vector4d>(state + 3).cast<T_real>();
+        body->m_predOrientation = body->m_orientation;
+        body->m_velocity = Eigen::Map<const Eigen::Vector3d>(state + 7).cast<T_real>();
+        body->m_angularVelocity = Eigen::Map<const Eigen::Vector3d>(state + 10).cast<T_real>();
+        body->m_mass = state[13];
+        body->m_radius = state[14];
+        body->m_localPositions.assign(localPositions.begin() + localIdx,
+                                      localPositions.begin() + localIdx + body->m_localPositions.size());
+        localIdx += body->m_localPositions.size();
+    }
+
+    //Caches sized or keyed on the previous contents
+    invalidatePermanentConstraintsColoring();
+    clearContactCache();
+    m_shapeMatchingCheckedSize = 0;
+    m_shapeMatchingOK.clear();
+    m_shapeMatchingIterations.clear();
+    m_broadPhaseActive.clear();
+    m_broadPhaseNumInactive = 0;
+    invalidateBroadPhaseObjects();
+    m_sleeping.clear();
+    m_sleepCounter.clear();
+    m_islandOf.clear();
+    m_numIslands = 0;
+    m_numActiveParticles = 0;
+    m_numSleepingParticles = 0;
+    m_sleepStateChanged = false;
+    m_permanentConstraintsFiltered = false;
+    m_activePermanentGeneration = 0;
+    m_activePermanentConstraints.clear();
+    m_stepStats = PBD::CStepStats();
+    return true;
+}
+
 
 }
 
@@ -0,0 +1,42 @@
+#ifndef PBD_ROTATIONEXTRACTION_H
+#define PBD_ROTATIONEXTRACTION_H
+
+#include <cmath>
+#include <Eigen/Dense>
+
+namespace PBD
+{
+
+/**
+ * Rotational part of a deformation matrix A, refined in place from the rotation q of the previous frame.
+ * Müller et al. 2016, "A Robust Method to Extract the Rotational Part of Deformations".
+ *
+ * Each iteration rotates q by the average torque that pulls its axes towards the columns of A, which removes about
+ * two thirds of the remaining angle. A warm start only has the motion since the previous frame left to cover, and
+ * with a capped number of iterations the result lags behind by a bounded angle but stays continuous in time (no axis
+ * flips or permutations). Returns the number of iterations performed. The default epsilon is above the rounding
+ * noise of T_real (single precision stops at 1e-6 instead of 1e-9).
+ */
+template<typename T_real=double, typename T_matrix=Eigen::Matrix<T_real,3,3>, typename T_quaternion=Eigen::Quaternion<T_real> >
+unsigned int extractRotation(const T_matrix& A, T_quaternion& q, const unsigned int& maxIter=10, const T_real& epsilon=T_real(sizeof(T_real) < sizeof(double) ? 1e-6 : 1e-9))
+{
+    typedef Eigen::Matrix<T_real,3,1> T_vector;
+
+    unsigned int iter = 0;
+    for (; iter < maxIter; ++iter)
+    {
+        T_matrix R = q.matrix();
+        T_vector omega = (R.col(0).cross(A.col(0)) + R.col(1).cross(A.col(1)) + R.col(2).cross(A.col(2))) *
+                         (T_real(1) / (std::fabs(R.col(0).dot(A.col(0)) + R.col(1).dot(A.col(1)) + R.col(2).dot(A.col(2))) + epsilon));
+        T_real w = omega.norm();
+        if (w < epsilon) break;
+
+        q = T_quaternion( Eigen::AngleAxis<T_real>(w, omega / w) ) * q;
+        q.normalize();
+    }
+    return iter;
+}
+
+}
+
+#endif //PBD_ROTATIONEXTRACTION_H
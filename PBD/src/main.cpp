@@ -2,54 +2,72 @@
 #include <physics/CPositionBasedDynamics.h>
 #include <iostream>
 #include <physics/CWorld.h>
+#include <io/CTrajectoryRecorder.h>
+#ifdef _PBD_SINGLE_PRECISION_
+typedef float T_real;
+#else
 typedef double T_real;
+#endif
 typedef vec3::Vector3<T_real> Vector3;
 
 
 
-void PBDCreateObjects( PBD::CWorld* pWorld );
+void PBDCreateObjects( PBD::CWorld<T_real>* pWorld );
 
 int main( int argc, char** argv)
 {
     T_real simStep = 0.005;
     T_real simTimeSeconds = 5.0;
 
-    PBD::CWorld PBDWorld;
-    PBDWorld.m_gravity = Eigen::Vector3d(0,0,-9.81);
+    PBD::CWorld<T_real> PBDWorld;
+    PBDWorld.m_gravity = Eigen::Matrix<T_real,3,1>(0,0,-9.81);
 
     std::cout<<"Creating objects"<<std::endl;
     PBDCreateObjects(&PBDWorld);
 
+    //Optional trajectory output: PBD [trajectory file]
+    std::unique_ptr<PBD::CTrajectoryRecorder> pRecorder;
+    if (argc > 1)
+    {
+        pRecorder.reset( new PBD::CTrajectoryRecorder(argv[1], 8, PBD::STrajectoryFormat::DELTA | PBD::STrajectoryFormat::ORIENTATION) );
+    }
+
     std::cout<<"Simulation started"<<std::endl;
     for (uint i=0; i<simTimeSeconds/simStep; ++i)
     {
         PBDWorld.step(simStep,0.1);
+        if (pRecorder) pRecorder->record(PBDWorld.m_particles, i, i*simStep);
         std::cout<< "t="<< i*simStep << " particles: "<< PBDWorld.m_particles.size() << std::endl;
     }
+
+    if (pRecorder)
+    {
+        pRecorder->close();
+        std::cout<< "Recorded "<< pRecorder->getNumWritten() << " frames to " << argv[1]
+                 << " (" << pRecorder->getNumBackpressured() << " waited for the writer)" << std::endl;
+    }
     std::cout<<"DONE!"<<std::endl;
 }
 
 
-void PBDCreateObjects( PBD::CWorld* pWorld )
+void PBDCreateObjects( PBD::CWorld<T_real>* pWorld )
 {
 
     std::cout<<"Creating objects"<<std::endl;
 
     //Create cube objects                         position              dimensions             partSize partWeight groupId
     PBD::createParticleSystemSolidCube<T_real>(Vector3(0.5,0.5,4) , Vector3(0.3,0.5,0.2), pWorld, 0.1, 0.02, 2);
-    PBD::createParticleSystemFromASCIIXYZPointCloud(Vector3(0.5,0.5,5) , std::string("/home/labuser/workspace/data/bun_zipper.xyz"), pWorld, 0.1, 0.02, 1);
+    PBD::createParticleSystemFromASCIIXYZPointCloud<T_real>(Vector3(0.5,0.5,5) , std::string("/home/labuser/workspace/data/bun_zipper.xyz"), pWorld, 0.1, 0.02, 1);
 
-    //Create a cube 5x5x0.05 m size with 5cm particles centered at 0,0,0 (This will be the floor)
-    PBD::createParticleSystemSolidCube<T_real>(Vector3(-1.5,-1.5,0) , Vector3(3,3,0.1), pWorld, 0.1, 0, 0);
+    //Floor: static plane at the top of the former 3x3 m particle slab
+    pWorld->m_staticColliders.m_planes.emplace_back(Eigen::Matrix<T_real,3,1>(0,0,0.1), Eigen::Matrix<T_real,3,1>(0,0,1));
 
     //Hang one object with a distance constraint from a point
     PBD::createParticleSystemSolidCube<T_real>(Vector3(0.5,0.5,4.5) , Vector3(0.1,0.1,0.1), pWorld, 0.1, 0, 3);   //Object to hang from
-    PBD::CConstantDistanceConstraint<>::Ptr hangConstraint (
-            new PBD::CConstantDistanceConstraint<>(
-                    pWorld->m_particles[0].get(),
-                    pWorld->m_particles[pWorld->m_particles.size()-1].get()
-            )
+    pWorld->m_permanentConstraints.m_distance.emplace_back(
+            pWorld->m_particles,
+            0,
+            pWorld->m_particles.size()-1
     );
-    pWorld->m_permanentConstraints.push_back(hangConstraint);
 
 }
\ No newline at end of file
@@ -0,0 +1,415 @@
+#include <physics/CPositionBasedDynamics.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+// Headless throughput benchmark of CWorld::step() on standard scenarios. Every run (scenario x scale x threads) is
+// executed in its own process so the reported peak memory belongs to that run only. Results are written to stdout as
+// JSON or CSV, scene creation messages are discarded.
+// Every step is followed by a check of the particle and rigid body positions. A run whose positions become non-finite
+// (NaN or Inf) stops there: its non_finite_step column gives the step (warmup included, -1 if none), its timings cover
+// the measured steps run before, and pbd_bench exits with a non-zero status.
+//
+// Usage: pbd_bench [--scenario all|cubes|chains|spheres|pointcloud] [--scales 1,2,4] [--threads 1,2,4]
+//                  [--steps 200] [--warmup 20] [--dt 0.005] [--solver gs|jacobi|colored] [--rigid] [--sleep]
+//                  [--warm-start 0.8] [--floor particles|plane|mesh] [--floor-triangles 1000000] [--format json|csv]
+//                  [--no-fork]
+
+typedef double T_real;
+typedef vec3::Vector3<T_real> Vector3;
+
+struct SBenchOptions
+{
+    std::vector<std::string> scenarios {"cubes", "chains", "spheres", "pointcloud"};
+    std::vector<size_t> scales {1, 2, 4};
+    std::vector<size_t> threads {1};
+    size_t steps = 200;
+    size_t warmup = 20;
+    double timeStep = 0.005;
+    std::string solver = "colored";
+    bool rigid = false;
+    bool sleep = false;
+    double warmStart = 0;
+    std::string floor = "particles";
+    size_t floorTriangles = 1000000;
+    bool csv = false;
+    bool fork = true;
+};
+
+const std::vector<std::string> columns {
+        "scenario", "scale", "threads", "solver", "rigid", "sleep", "warm_start", "floor", "particles", "dynamic_particles", "steps",
+        "steps_per_second", "ms_per_step", "ms_pre_stabilization", "ms_integration", "ms_collision_detection",
+        "ms_contact_solve", "ms_shape_matching", "ms_velocity_update", "contacts_per_step", "static_contacts_per_step", "contact_iterations",
+        "warm_started_contacts", "active_particles", "object_pairs", "broad_phase_particles", "max_error", "rms_error", "timeouts",
+        "non_finite_step", "peak_rss_kb" };
+
+bool g_planeFloor = false;     ///< createFloor adds a static plane instead of a particle slab.
+size_t g_meshFloorTriangles = 0;    ///< createFloor adds a static mesh of about this many triangles instead of a particle slab.
+
+void createCubePile( PBD::CWorld<>* pWorld, size_t scale );
+void createHangingChains( PBD::CWorld<>* pWorld, size_t scale );
+void createFallingSpheres( PBD::CWorld<>* pWorld, size_t scale );
+void createPointCloudObject( PBD::CWorld<>* pWorld, size_t scale );
+std::vector<std::string> runBenchmark( const SBenchOptions& options, const std::string& scenario, size_t scale, size_t threads );
+void printRecord( const SBenchOptions& options, const std::vector<std::string>& values, bool first );
+bool isFinite( const std::vector<std::string>& values );
+
+std::vector<size_t> parseList( const char* arg )
+{
+    std::vector<size_t> values;
+    std::stringstream stream(arg);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        values.push_back(std::strtoul(item.c_str(), nullptr, 10));
+    }
+    return values;
+}
+
+int main( int argc, char** argv )
+{
+    SBenchOptions options;
+    for (int a=1; a<argc; ++a)
+    {
+        std::string arg(argv[a]);
+        bool hasValue = a+1 < argc;
+        if      (arg == "--scenario" && hasValue)
+        {
+            std::string s(argv[++a]);
+            if (s != "all") options.scenarios = {s};
+        }
+        else if (arg == "--scales"  && hasValue) options.scales  = parseList(argv[++a]);
+        else if (arg == "--threads" && hasValue) options.threads = parseList(argv[++a]);
+        else if (arg == "--steps"   && hasValue) options.steps   = std::strtoul(argv[++a], nullptr, 10);
+        else if (arg == "--warmup"  && hasValue) options.warmup  = std::strtoul(argv[++a], nullptr, 10);
+        else if (arg == "--dt"      && hasValue) options.timeStep = std::strtod(argv[++a], nullptr);
+        else if (arg == "--solver"  && hasValue) options.solver  = argv[++a];
+        else if (arg == "--warm-start" && hasValue) options.warmStart = std::strtod(argv[++a], nullptr);
+        else if (arg == "--floor"   && hasValue) options.floor   = argv[++a];
+        else if (arg == "--floor-triangles" && hasValue) options.floorTriangles = std::strtoul(argv[++a], nullptr, 10);
+        else if (arg == "--format"  && hasValue) options.csv     = std::string(argv[++a]) == "csv";
+        else if (arg == "--rigid")   options.rigid = true;
+        else if (arg == "--sleep")   options.sleep = true;
+        else if (arg == "--no-fork") options.fork  = false;
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (options.csv)
+    {
+        for (size_t c=0; c<columns.size(); ++c) std::cout << (c ? "," : "") << columns[c];
+        std::cout << std::endl;
+    }
+    else
+    {
+        std::cout << "[" << std::endl;
+    }
+
+    bool first = true;
+    bool failed = false;
+    for (const auto& scenario:options.scenarios)
+    {
+        for (const auto& scale:options.scales)
+        {
+            for (const auto& threads:options.threads)
+            {
+                if (!options.fork)
+                {
+                    const std::vector<std::string> values = runBenchmark(options, scenario, scale, threads);
+                    printRecord(options, values, first);
+                    failed = failed || !isFinite(values);
+                    first = false;
+                    continue;
+                }
+
+                //Run in a child process: its peak RSS only accounts for this run
+                if (!options.csv && !first) std::cout << "," << std::endl;
+                std::cout << std::flush;
+                pid_t pid = fork();
+                if (pid == 0)
+                {
+                    const std::vector<std::string> values = runBenchmark(options, scenario, scale, threads);
+                    printRecord(options, values, true);
+                    std::cout << std::flush;
+                    _exit(isFinite(values) ? 0 : 2);
+                }
+                int status = 0;
+                waitpid(pid, &status, 0);
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                {
+                    std::cerr << "Run " << scenario << " scale " << scale << " threads " << threads << " failed" << std::endl;
+                    failed = true;
+                }
+                first = false;
+            }
+        }
+    }
+
+    if (!options.csv) std::cout << std::endl << "]" << std::endl;
+    return failed ? 2 : 0;
+}
+
+/// True if every particle and rigid body position of the world is finite.
+bool positionsFinite( const PBD::CWorld<>& world )
+{
+    for (size_t i=0; i<world.m_particles.size(); ++i)
+    {
+        if (!world.m_particles.m_position[i].allFinite()) return false;
+    }
+    for (const auto& body:world.m_rigidBodies)
+    {
+        if (!body->m_position.allFinite() || !body->m_orientation.coeffs().allFinite()) return false;
+    }
+    return true;
+}
+
+bool isFinite( const std::vector<std::string>& values )
+{
+    const size_t column = std::find(columns.begin(), columns.end(), "non_finite_step") - columns.begin();
+    return values[column] == "-1";
+}
+
+std::vector<std::string> runBenchmark( const SBenchOptions& options, const std::string& scenario, size_t scale, size_t threads )
+{
+    PBD::CWorld<> world;
+    world.m_gravity = Eigen::Vector3d(0,0,-9.81);
+    world.m_rigidBodyFastPath = options.rigid;
+    world.m_sleepingEnabled = options.sleep;
+    world.m_contactWarmStarting = options.warmStart;
+    world.m_solverMode = options.solver == "jacobi" ? PBD::CWorld<>::JACOBI :
+                         options.solver == "gs"     ? PBD::CWorld<>::GAUSS_SEIDEL :
+                                                      PBD::CWorld<>::COLORED_GAUSS_SEIDEL;
+    world.setNumThreads(threads);
+    g_planeFloor = options.floor == "plane";
+    g_meshFloorTriangles = options.floor == "mesh" ? options.floorTriangles : 0;
+
+    //The scene creators print their progress, keep stdout machine readable
+    std::ostringstream discard;
+    std::streambuf* coutBuffer = std::cout.rdbuf(discard.rdbuf());
+    if      (scenario == "cubes")      createCubePile(&world, scale);
+    else if (scenario == "chains")     createHangingChains(&world, scale);
+    else if (scenario == "spheres")    createFallingSpheres(&world, scale);
+    else if (scenario == "pointcloud") createPointCloudObject(&world, scale);
+    std::cout.rdbuf(coutBuffer);
+
+    long nonFiniteStep = -1;
+    for (size_t i=0; i<options.warmup && nonFiniteStep < 0; ++i)
+    {
+        world.step(options.timeStep, 1.0);
+        if (!positionsFinite(world)) nonFiniteStep = long(i);
+    }
+
+    PBD::CStepStats sum;
+    size_t contacts = 0;
+    size_t staticContacts = 0;
+    size_t timeouts = 0;
+    double maxError = 0;
+    double seconds = 0;
+    size_t measured = 0;
+    for (; measured<options.steps && nonFiniteStep < 0; ++measured)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        world.step(options.timeStep, 1.0);
+        seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        if (!positionsFinite(world)) nonFiniteStep = long(options.warmup + measured);
+
+        const PBD::CStepStats& stats = world.getStepStats();
+        sum.m_preStabilizationTime   += stats.m_preStabilizationTime;
+        sum.m_integrationTime        += stats.m_integrationTime;
+        sum.m_collisionDetectionTime += stats.m_collisionDetectionTime;
+        sum.m_contactSolveTime       += stats.m_contactSolveTime;
+        sum.m_shapeMatchingTime      += stats.m_shapeMatchingTime;
+        sum.m_velocityUpdateTime     += stats.m_velocityUpdateTime;
+        sum.m_numActiveParticles     += stats.m_numActiveParticles;
+        sum.m_contactIterations      += stats.m_contactIterations;
+        sum.m_numWarmStartedContacts += stats.m_numWarmStartedContacts;
+        sum.m_numObjectPairs         += stats.m_numObjectPairs;
+        sum.m_numBroadPhaseParticles += stats.m_numBroadPhaseParticles;
+        sum.m_rmsError               += stats.m_rmsError;
+        contacts += stats.m_numContactConstraints;
+        staticContacts += stats.m_numStaticContacts;
+        timeouts += stats.m_timeoutHit ? 1 : 0;
+        maxError = std::max(maxError, stats.m_maxError);
+    }
+    if (nonFiniteStep >= 0)
+    {
+        std::cerr << "Run " << scenario << " scale " << scale << " threads " << threads
+                  << ": non-finite particle positions at step " << nonFiniteStep << std::endl;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    const double steps = double(std::max(measured, size_t(1)));
+    auto ms = [&steps](double s) { std::ostringstream o; o << std::setprecision(4) << s * 1000.0 / steps; return o.str(); };
+    auto num = [](double v) { std::ostringstream o; o << std::setprecision(6) << v; return o.str(); };
+
+    return {
+            scenario, std::to_string(scale), std::to_string(threads), options.solver,
+            options.rigid ? "1" : "0", options.sleep ? "1" : "0", num(options.warmStart), options.floor,
+            std::to_string(world.m_particles.size()), std::to_string(world.getNumActiveParticles() + world.getNumSleepingParticles()),
+            std::to_string(measured), num(seconds > 0 ? steps / seconds : 0), ms(seconds),
+            ms(sum.m_preStabilizationTime), ms(sum.m_integrationTime), ms(sum.m_collisionDetectionTime),
+            ms(sum.m_contactSolveTime), ms(sum.m_shapeMatchingTime), ms(sum.m_velocityUpdateTime),
+            num(contacts / steps), num(staticContacts / steps), num(sum.m_contactIterations / steps), num(sum.m_numWarmStartedContacts / steps),
+            num(sum.m_numActiveParticles / steps), num(sum.m_numObjectPairs / steps),
+            num(sum.m_numBroadPhaseParticles / steps), num(maxError), num(sum.m_rmsError / steps), std::to_string(timeouts),
+            std::to_string(nonFiniteStep), std::to_string(usage.ru_maxrss) };
+}
+
+void printRecord( const SBenchOptions& options, const std::vector<std::string>& values, bool first )
+{
+    if (options.csv)
+    {
+        for (size_t c=0; c<values.size(); ++c) std::cout << (c ? "," : "") << values[c];
+        std::cout << std::endl;
+        return;
+    }
+
+    //Text columns are quoted, everything else is numeric
+    if (!first) std::cout << "," << std::endl;
+    std::cout << "  {";
+    for (size_t c=0; c<values.size(); ++c)
+    {
+        bool text = columns[c] == "scenario" || columns[c] == "solver" || columns[c] == "floor";
+        std::cout << (c ? ", " : "") << "\"" << columns[c] << "\": " << (text ? "\"" : "") << values[c] << (text ? "\"" : "");
+    }
+    std::cout << "}";
+}
+
+void createFloor( PBD::CWorld<>* pWorld, T_real halfSize )
+{
+    //Static slab of two particle layers under z=0, or the plane of its top surface, or that plane as a triangle grid
+    if (g_planeFloor)
+    {
+        pWorld->m_staticColliders.m_planes.emplace_back(Eigen::Vector3d(0,0,0.001), Eigen::Vector3d(0,0,1));
+        return;
+    }
+    if (g_meshFloorTriangles > 0)
+    {
+        const size_t side = std::max(size_t(std::ceil(std::sqrt(g_meshFloorTriangles * 0.5))), size_t(1));
+        std::vector<Eigen::Vector3d> vertices;
+        std::vector< std::array<uint32_t,3> > triangles;
+        for (size_t i=0; i<=side; ++i)
+        {
+            for (size_t j=0; j<=side; ++j)
+            {
+                vertices.emplace_back(-halfSize + 2*halfSize*i/side, -halfSize + 2*halfSize*j/side, 0.001);
+            }
+        }
+        for (size_t i=0; i<side; ++i)
+        {
+            for (size_t j=0; j<side; ++j)
+            {
+                const uint32_t v = uint32_t(i*(side+1) + j);
+                const uint32_t right = v + uint32_t(side+1);
+                triangles.push_back({ v, right, right + 1 });
+                triangles.push_back({ v, right + 1, v + 1 });
+            }
+        }
+        pWorld->m_staticColliders.m_triangleMeshes.emplace_back(vertices, triangles);
+        return;
+    }
+    PBD::createParticleSystemSolidCube<T_real>(Vector3(-halfSize,-halfSize,-0.1), Vector3(2*halfSize,2*halfSize,0.1), pWorld, 0.05, 0, 0);
+}
+
+void createCubePile( PBD::CWorld<>* pWorld, size_t scale )
+{
+    //Three layers of (2*scale)^2 cubes, odd layers shifted so the pile tumbles
+    const size_t side = 2 * scale;
+    const T_real cubeSize = 0.2;
+    const T_real pitch = 0.3;
+    size_t group = 1;
+    for (size_t layer=0; layer<3; ++layer)
+    {
+        for (size_t i=0; i<side; ++i)
+        {
+            for (size_t j=0; j<side; ++j)
+            {
+                T_real offset = layer % 2 ? 0.07 : 0.0;
+                PBD::createParticleSystemSolidCube<T_real>(Vector3(i*pitch + offset, j*pitch + offset, 0.05 + layer*pitch),
+                                                           Vector3(cubeSize,cubeSize,cubeSize), pWorld, 0.05, 0.02, group++);
+            }
+        }
+    }
+    createFloor(pWorld, side*pitch + 0.5);
+}
+
+void createHangingChains( PBD::CWorld<>* pWorld, size_t scale )
+{
+    //Grid of chains released horizontally from a static anchor, so they swing into each other
+    const size_t side = 4 * scale;
+    const size_t length = 20;
+    const T_real partSize = 0.05;
+    const T_real pitch = 0.3;
+    for (size_t i=0; i<side; ++i)
+    {
+        for (size_t j=0; j<side; ++j)
+        {
+            size_t group = 1 + i*side + j;
+            size_t previous = pWorld->m_particles.push_back( PBD::CParticle<T_real>(i*pitch, j*pitch, 2.0, 0, partSize, group) );
+            for (size_t k=1; k<length; ++k)
+            {
+                size_t current = pWorld->m_particles.push_back(
+                        PBD::CParticle<T_real>(i*pitch + k*partSize*1.05, j*pitch + (k%2)*0.01, 2.0, 0.01, partSize, group) );
+                pWorld->m_permanentConstraints.m_distance.emplace_back(pWorld->m_particles, previous, current);
+                previous = current;
+            }
+        }
+    }
+}
+
+void createFallingSpheres( PBD::CWorld<>* pWorld, size_t scale )
+{
+    //Large static floor with a grid of spheres dropped from different heights
+    const size_t side = 3 * scale;
+    const T_real radius = 0.15;
+    const T_real pitch = 0.4;
+    size_t group = 1;
+    for (size_t i=0; i<side; ++i)
+    {
+        for (size_t j=0; j<side; ++j)
+        {
+            PBD::createParticleSystemSolidSphere<T_real>(Vector3(i*pitch, j*pitch, 0.3 + ((i+j)%3)*0.2), radius, pWorld, 0.05, 0.02, group++);
+        }
+    }
+    createFloor(pWorld, side*pitch + 1.0);
+}
+
+void createPointCloudObject( PBD::CWorld<>* pWorld, size_t scale )
+{
+    //Torus surface sampled with 5000*scale points, written as an ASCII XYZ file and loaded as a point cloud object
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<T_real> angle(0, 2*M_PI);
+    const T_real R = 0.4;
+    const T_real r = 0.15;
+    const std::string filename = "pbd_bench_cloud_" + std::to_string(getpid()) + ".xyz";
+    {
+        std::ofstream cloud(filename);
+        for (size_t p=0; p<5000*scale; ++p)
+        {
+            T_real u = angle(rng);
+            T_real v = angle(rng);
+            cloud << (R + r*std::cos(v))*std::cos(u) << " " << (R + r*std::cos(v))*std::sin(u) << " " << r*std::sin(v) << "\n";
+        }
+    }
+    //The file is different on every run: do not leave voxel cache entries behind
+    PBD::CVoxelCache::setEnabled(false);
+    PBD::createParticleSystemFromASCIIXYZPointCloud<T_real>(Vector3(0,0,0.5), filename, pWorld, 0.05, 0.02, 1);
+    PBD::CVoxelCache::setEnabled(true);
+    std::remove(filename.c_str());
+    createFloor(pWorld, 1.0);
+}
@@ -0,0 +1,261 @@
+#include <physics/CPositionBasedDynamics.h>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+
+// Single against double precision benchmark. Every scenario is created twice, in a CWorld<double> and a CWorld<float>,
+// and both worlds are stepped in lockstep. Each step is timed separately for both precisions, and after every step the
+// float particle positions are compared with the double ones. The drift is the distance between the two positions of
+// a particle: its maximum over the run, its RMS over the particles at the last step and the first step at which it
+// exceeds 1 mm. Scenes with contacts are chaotic, so the drift grows once the rounding differences change a contact.
+// Shape matching uses POLAR_QUATERNION by default: the JACOBI_SVD frame of a symmetric object is not unique, so the
+// two precisions may pick different frames from the first step. Results are written to stdout as JSON.
+//
+// Usage: pbd_precision_bench [--scenario all|cubes|chains|spheres] [--scales 1,2] [--threads 1] [--steps 200]
+//                            [--dt 0.005] [--solver gs|jacobi|colored] [--rotation polar|svd] [--rigid]
+
+struct SBenchOptions
+{
+    std::vector<std::string> scenarios {"cubes", "chains", "spheres"};
+    std::vector<size_t> scales {1, 2};
+    std::vector<size_t> threads {1};
+    size_t steps = 200;
+    double timeStep = 0.005;
+    std::string solver = "colored";
+    std::string rotation = "polar";
+    bool rigid = false;
+};
+
+const std::vector<std::string> columns {
+        "scenario", "scale", "threads", "solver", "rigid", "particles", "steps",
+        "ms_per_step_double", "ms_per_step_float", "speedup", "store_bytes_double", "store_bytes_float",
+        "max_drift", "rms_drift_last_step", "drift_1mm_step" };
+
+template<typename T_real>
+void createFloor( PBD::CWorld<T_real>* pWorld, T_real halfSize )
+{
+    //Static slab of two particle layers under z=0
+    PBD::createParticleSystemSolidCube<T_real>(vec3::Vector3<T_real>(-halfSize,-halfSize,-0.1),
+                                               vec3::Vector3<T_real>(2*halfSize,2*halfSize,0.1), pWorld, 0.05, 0, 0);
+}
+
+template<typename T_real>
+void createCubePile( PBD::CWorld<T_real>* pWorld, size_t scale )
+{
+    //Three layers of (2*scale)^2 cubes, odd layers shifted so the pile tumbles
+    const size_t side = 2 * scale;
+    const T_real cubeSize = 0.2;
+    const T_real pitch = 0.3;
+    size_t group = 1;
+    for (size_t layer=0; layer<3; ++layer)
+    {
+        for (size_t i=0; i<side; ++i)
+        {
+            for (size_t j=0; j<side; ++j)
+            {
+                T_real offset = layer % 2 ? 0.07 : 0.0;
+                PBD::createParticleSystemSolidCube<T_real>(vec3::Vector3<T_real>(i*pitch + offset, j*pitch + offset, 0.05 + layer*pitch),
+                                                           vec3::Vector3<T_real>(cubeSize,cubeSize,cubeSize), pWorld, 0.05, 0.02, group++);
+            }
+        }
+    }
+    createFloor<T_real>(pWorld, side*pitch + 0.5);
+}
+
+template<typename T_real>
+void createHangingChains( PBD::CWorld<T_real>* pWorld, size_t scale )
+{
+    //Grid of chains released horizontally from a static anchor, so they swing into each other
+    const size_t side = 4 * scale;
+    const size_t length = 20;
+    const T_real partSize = 0.05;
+    const T_real pitch = 0.3;
+    for (size_t i=0; i<side; ++i)
+    {
+        for (size_t j=0; j<side; ++j)
+        {
+            size_t group = 1 + i*side + j;
+            size_t previous = pWorld->m_particles.push_back( PBD::CParticle<T_real>(i*pitch, j*pitch, 2.0, 0, partSize, group) );
+            for (size_t k=1; k<length; ++k)
+            {
+                size_t current = pWorld->m_particles.push_back(
+                        PBD::CParticle<T_real>(i*pitch + k*partSize*1.05, j*pitch + (k%2)*0.01, 2.0, 0.01, partSize, group) );
+                pWorld->m_permanentConstraints.m_distance.emplace_back(pWorld->m_particles, previous, current);
+                previous = current;
+            }
+        }
+    }
+}
+
+template<typename T_real>
+void createFallingSpheres( PBD::CWorld<T_real>* pWorld, size_t scale )
+{
+    //Large static floor with a grid of spheres dropped from different heights
+    const size_t side = 3 * scale;
+    const T_real radius = 0.15;
+    const T_real pitch = 0.4;
+    size_t group = 1;
+    for (size_t i=0; i<side; ++i)
+    {
+        for (size_t j=0; j<side; ++j)
+        {
+            PBD::createParticleSystemSolidSphere<T_real>(vec3::Vector3<T_real>(i*pitch, j*pitch, 0.3 + ((i+j)%3)*0.2),
+                                                         radius, pWorld, 0.05, 0.02, group++);
+        }
+    }
+    createFloor<T_real>(pWorld, side*pitch + 1.0);
+}
+
+template<typename T_real>
+void setupWorld( PBD::CWorld<T_real>& world, const SBenchOptions& options, const std::string& scenario, size_t scale, size_t threads )
+{
+    world.m_gravity = Eigen::Matrix<T_real,3,1>(0,0,-9.81);
+    world.m_rigidBodyFastPath = options.rigid;
+    world.m_solverMode = options.solver == "jacobi" ? PBD::CWorld<T_real>::JACOBI :
+                         options.solver == "gs"     ? PBD::CWorld<T_real>::GAUSS_SEIDEL :
+                                                      PBD::CWorld<T_real>::COLORED_GAUSS_SEIDEL;
+    world.setNumThreads(threads);
+
+    if      (scenario == "cubes")   createCubePile(&world, scale);
+    else if (scenario == "chains")  createHangingChains(&world, scale);
+    else if (scenario == "spheres") createFallingSpheres(&world, scale);
+
+    for (auto& c:world.m_shapeMatchingConstraints)
+    {
+        c->setRotationExtraction(options.rotation == "svd" ? PBD::CShapeMatchingConstraint<T_real>::JACOBI_SVD :
+                                                             PBD::CShapeMatchingConstraint<T_real>::POLAR_QUATERNION);
+    }
+}
+
+/// Bytes of the per-particle arrays of a store.
+template<typename T_real>
+size_t storeBytes( const PBD::CParticleStore<T_real>& s )
+{
+    return s.size() * ( 5 * sizeof(typename decltype(s.m_position)::value_type) +
+                        2 * sizeof(typename PBD::CParticleStore<T_real>::QuaternionVector::value_type) +
+                        3 * sizeof(T_real) + 2 * sizeof(size_t) );
+}
+
+std::vector<std::string> runBenchmark( const SBenchOptions& options, const std::string& scenario, size_t scale, size_t threads )
+{
+    PBD::CWorld<double> worldDouble;
+    PBD::CWorld<float> worldFloat;
+
+    //The scene creators print their progress, keep stdout machine readable
+    std::ostringstream discard;
+    std::streambuf* coutBuffer = std::cout.rdbuf(discard.rdbuf());
+    setupWorld(worldDouble, options, scenario, scale, threads);
+    setupWorld(worldFloat, options, scenario, scale, threads);
+    std::cout.rdbuf(coutBuffer);
+
+    const size_t n = worldDouble.m_particles.size();
+    if (worldFloat.m_particles.size() != n)
+    {
+        std::cerr << "The " << scenario << " scene has a different number of particles in single precision" << std::endl;
+        return {};
+    }
+
+    double secondsDouble = 0;
+    double secondsFloat = 0;
+    double maxDrift = 0;
+    double sumDrift2 = 0;
+    size_t drift1mmStep = options.steps;
+    for (size_t i=0; i<options.steps; ++i)
+    {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        worldDouble.step(options.timeStep, 1.0);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        worldFloat.step(float(options.timeStep), 1.0);
+        auto t2 = std::chrono::high_resolution_clock::now();
+        secondsDouble += std::chrono::duration<double>(t1 - t0).count();
+        secondsFloat += std::chrono::duration<double>(t2 - t1).count();
+
+        worldDouble.syncRigidBodyParticles();
+        worldFloat.syncRigidBodyParticles();
+        sumDrift2 = 0;
+        for (size_t p=0; p<n; ++p)
+        {
+            double d2 = (worldFloat.m_particles.m_position[p].cast<double>() - worldDouble.m_particles.m_position[p]).squaredNorm();
+            maxDrift = std::max(maxDrift, std::sqrt(d2));
+            sumDrift2 += d2;
+        }
+        if (maxDrift > 1e-3 && drift1mmStep == options.steps) drift1mmStep = i;
+    }
+
+    const double steps = double(std::max(options.steps, size_t(1)));
+    auto num = [](double v) { std::ostringstream o; o << std::setprecision(6) << v; return o.str(); };
+
+    return {
+            scenario, std::to_string(scale), std::to_string(threads), options.solver, options.rigid ? "1" : "0",
+            std::to_string(n), std::to_string(options.steps),
+            num(secondsDouble * 1000.0 / steps), num(secondsFloat * 1000.0 / steps), num(secondsDouble / secondsFloat),
+            std::to_string(storeBytes(worldDouble.m_particles)), std::to_string(storeBytes(worldFloat.m_particles)),
+            num(maxDrift), num(n > 0 ? std::sqrt(sumDrift2 / n) : 0.0), std::to_string(drift1mmStep) };
+}
+
+std::vector<size_t> parseList( const char* arg )
+{
+    std::vector<size_t> values;
+    std::stringstream stream(arg);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        values.push_back(std::strtoul(item.c_str(), nullptr, 10));
+    }
+    return values;
+}
+
+int main( int argc, char** argv )
+{
+    SBenchOptions options;
+    for (int a=1; a<argc; ++a)
+    {
+        std::string arg(argv[a]);
+        bool hasValue = a+1 < argc;
+        if      (arg == "--scenario" && hasValue)
+        {
+            std::string s(argv[++a]);
+            if (s != "all") options.scenarios = {s};
+        }
+        else if (arg == "--scales"  && hasValue) options.scales  = parseList(argv[++a]);
+        else if (arg == "--threads" && hasValue) options.threads = parseList(argv[++a]);
+        else if (arg == "--steps"   && hasValue) options.steps   = std::strtoul(argv[++a], nullptr, 10);
+        else if (arg == "--dt"      && hasValue) options.timeStep = std::strtod(argv[++a], nullptr);
+        else if (arg == "--solver"  && hasValue) options.solver  = argv[++a];
+        else if (arg == "--rotation" && hasValue) options.rotation = argv[++a];
+        else if (arg == "--rigid")   options.rigid = true;
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "[" << std::endl;
+    bool first = true;
+    for (const auto& scenario:options.scenarios)
+    {
+        for (const auto& scale:options.scales)
+        {
+            for (const auto& threads:options.threads)
+            {
+                std::vector<std::string> values = runBenchmark(options, scenario, scale, threads);
+                if (values.empty()) continue;
+
+                //Text columns are quoted, everything else is numeric
+                std::cout << (first ? "" : ",\n") << "  {";
+                for (size_t c=0; c<values.size(); ++c)
+                {
+                    bool text = columns[c] == "scenario" || columns[c] == "solver";
+                    std::cout << (c ? ", " : "") << "\"" << columns[c] << "\": " << (text ? "\"" : "") << values[c] << (text ? "\"" : "");
+                }
+                std::cout << "}" << std::flush;
+                first = false;
+            }
+        }
+    }
+    std::cout << std::endl << "]" << std::endl;
+}
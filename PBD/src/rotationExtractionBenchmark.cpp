@@ -0,0 +1,87 @@
+#include <physics/RotationExtraction.h>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <Eigen/StdVector>
+
+// Rotation extraction microbenchmark: JacobiSVD polar decomposition vs warm-started quaternion refinement
+// (PBD::extractRotation) on a smoothly rotating, slightly deformed sequence of matrices, as in shape matching.
+//
+// Usage: pbd_rotation_bench [frames=200000]
+
+int main( int argc, char** argv )
+{
+    size_t frames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+
+    //Deformation matrices A = R(t) * S(t), with R rotating a few degrees per frame and S a small symmetric stretch
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<double> noise(-0.05, 0.05);
+    std::vector<Eigen::Matrix3d> A(frames);
+    std::vector<Eigen::Quaterniond, Eigen::aligned_allocator<Eigen::Quaterniond> > exact(frames);
+    Eigen::Vector3d axis(1,2,3);
+    axis.normalize();
+    for (size_t f=0; f<frames; ++f)
+    {
+        Eigen::Matrix3d R = Eigen::AngleAxisd(0.05*f, axis).toRotationMatrix();
+        Eigen::Matrix3d S = Eigen::Matrix3d::Identity();
+        for (int i=0; i<3; ++i)
+        {
+            for (int j=i; j<3; ++j)
+            {
+                S(i,j) += noise(rng);
+                S(j,i) = S(i,j);
+            }
+        }
+        A[f] = R * S;
+
+        Eigen::JacobiSVD<Eigen::Matrix3d> svd(A[f], Eigen::ComputeFullU | Eigen::ComputeFullV);
+        exact[f] = Eigen::Quaterniond(svd.matrixU() * svd.matrixV().transpose());
+    }
+
+    std::cout << std::setw(22) << "method" << std::setw(12) << "ns/matrix" << std::setw(12) << "avg iter"
+              << std::setw(16) << "max error(rad)" << std::endl;
+
+    //JacobiSVD
+    {
+        double checksum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t f=0; f<frames; ++f)
+        {
+            Eigen::JacobiSVD<Eigen::Matrix3d> svd(A[f], Eigen::ComputeFullU | Eigen::ComputeFullV);
+            Eigen::Matrix3d R = svd.matrixU() * svd.matrixV().transpose();
+            checksum += R(0,0);
+        }
+        auto elapsed = std::chrono::high_resolution_clock::now() - start;
+        double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / double(frames);
+        std::cout << std::setw(22) << "jacobi-svd" << std::setw(12) << ns << std::setw(12) << "-"
+                  << std::setw(16) << 0.0 << "   (" << checksum << ")" << std::endl;
+    }
+
+    //Warm-started quaternion refinement with different iteration caps
+    for (unsigned int maxIter : {1u, 2u, 4u, 10u})
+    {
+        Eigen::Quaterniond q = exact[0];
+        size_t iterations = 0;
+        std::vector<Eigen::Quaterniond, Eigen::aligned_allocator<Eigen::Quaterniond> > result(frames);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t f=0; f<frames; ++f)
+        {
+            iterations += PBD::extractRotation<double>(A[f], q, maxIter);
+            result[f] = q;
+        }
+        auto elapsed = std::chrono::high_resolution_clock::now() - start;
+        double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / double(frames);
+
+        double maxError = 0;
+        for (size_t f=0; f<frames; ++f)
+        {
+            maxError = std::max(maxError, result[f].angularDistance(exact[f]));
+        }
+        std::cout << std::setw(16) << "polar-quat x" << std::setw(6) << std::left << maxIter << std::right
+                  << std::setw(12) << ns << std::setw(12) << double(iterations) / frames
+                  << std::setw(16) << maxError << std::endl;
+    }
+}
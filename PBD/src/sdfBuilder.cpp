@@ -0,0 +1,73 @@
+#include <physics/CSDFCollider.h>
+#include <io/PointCloudReader.h>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+// Offline builder of the signed distance fields loaded by PBD::CSDFCollider. The input is a point set sampling a
+// closed surface: an ASCII XYZ point cloud, or a binary PLY file whose vertices are used as samples (a mesh must then
+// be sampled more densely than the cell size, otherwise the surface leaks and only a shell is solid).
+//
+// Usage: pbd_sdf_build <input.xyz|input.ply> <output.pbdsdf> <cell size> [band cells=4] [scale=1]
+
+typedef double T_real;
+
+int main( int argc, char** argv )
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <input.xyz|input.ply> <output.pbdsdf> <cell size> [band cells=4] [scale=1]" << std::endl;
+        return 1;
+    }
+    const std::string input(argv[1]);
+    const std::string output(argv[2]);
+    const T_real cellSize = std::strtod(argv[3], nullptr);
+    const size_t bandCells = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 4;
+    const T_real scale = argc > 5 ? std::strtod(argv[5], nullptr) : 1.0;
+    if (cellSize <= 0)
+    {
+        std::cerr << "The cell size must be positive" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    PBD::CSDFCollider<T_real> field;
+    size_t numPoints = 0;
+    const bool isPLY = input.size() > 4 && input.compare(input.size() - 4, 4, ".ply") == 0;
+    if (isPLY)
+    {
+        PBD::CMappedFile file(input);
+        PBD::CStridedPointView<T_real> points;
+        if (!file.isOpen() || !PBD::parseBinaryPLYHeader<T_real>(file.data(), file.size(), points))
+        {
+            std::cerr << "Unable to read binary PLY file: " << input << std::endl;
+            return 1;
+        }
+        points.m_scale = scale;
+        numPoints = points.size();
+        field.build(points, cellSize, bandCells);
+    }
+    else
+    {
+        std::vector< Eigen::Matrix<T_real,3,1> > points;
+        if (!PBD::readASCIIXYZPointCloud<T_real>(input, points, scale))
+        {
+            std::cerr << "Unable to read point cloud: " << input << std::endl;
+            return 1;
+        }
+        numPoints = points.size();
+        field.build(points, cellSize, bandCells);
+    }
+
+    if (field.empty() || !field.save(output))
+    {
+        std::cerr << "Unable to build or write the distance field: " << output << std::endl;
+        return 1;
+    }
+
+    const size_t* dims = field.getDims();
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Wrote " << output << ": " << dims[0] << "x" << dims[1] << "x" << dims[2] << " nodes of "
+              << cellSize << " m from " << numPoints << " points in " << seconds << " s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <physics/CWorld.h>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+
+// Throughput of the contact + permanent constraint solve: serial Gauss-Seidel vs parallel Jacobi and colored
+// Gauss-Seidel.
+//
+// Usage: pbd_solver_bench [particlesPerSide=24] [iterations=20]
+
+void createLatticeScene( PBD::CWorld<>* pWorld, size_t side );
+
+double timeSolver( PBD::CWorld<>* pWorld, const std::vector<Eigen::Vector3d>& predPositions, size_t iterations )
+{
+    pWorld->m_particles.m_predPosition = predPositions;
+    pWorld->setupConstraintSolver(true);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i=0; i<iterations; ++i)
+    {
+        pWorld->constraintSolverIteration(true);
+    }
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / 1000.0 / iterations;
+}
+
+int main( int argc, char** argv )
+{
+    size_t side       = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 24;
+    size_t iterations = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+
+    PBD::CWorld<> world;
+    world.m_gravity = Eigen::Vector3d(0,0,-9.81);
+    createLatticeScene(&world, side);
+
+    world.createCollisionConstraints();
+    const std::vector<Eigen::Vector3d> predPositions = world.m_particles.m_predPosition;
+    const size_t numConstraints = world.m_constraints.size() + world.m_permanentConstraints.size();
+
+    std::cout << "particles: " << world.m_particles.size()
+              << " contacts: " << world.m_constraints.size()
+              << " permanent: " << world.m_permanentConstraints.size() << std::endl;
+    std::cout << std::setw(14) << "mode" << std::setw(9) << "threads" << std::setw(12) << "ms/iter"
+              << std::setw(16) << "Mconstr/s" << std::setw(10) << "speedup" << std::endl;
+
+    world.m_solverMode = PBD::CWorld<>::GAUSS_SEIDEL;
+    double gsTime = timeSolver(&world, predPositions, iterations);
+    std::cout << std::setw(14) << "gauss-seidel" << std::setw(9) << 1 << std::setw(12) << gsTime
+              << std::setw(16) << numConstraints / gsTime / 1000.0 << std::setw(10) << 1.0 << std::endl;
+
+    world.m_solverMode = PBD::CWorld<>::JACOBI;
+    for (size_t threads : {1, 2, 4, 8, 16})
+    {
+        world.setNumThreads(threads);
+        double t = timeSolver(&world, predPositions, iterations);
+        std::cout << std::setw(14) << "jacobi" << std::setw(9) << threads << std::setw(12) << t
+                  << std::setw(16) << numConstraints / t / 1000.0 << std::setw(10) << gsTime / t << std::endl;
+    }
+
+    world.m_solverMode = PBD::CWorld<>::COLORED_GAUSS_SEIDEL;
+    for (size_t threads : {1, 2, 4, 8, 16})
+    {
+        world.setNumThreads(threads);
+        double t = timeSolver(&world, predPositions, iterations);
+        std::cout << std::setw(14) << "colored-gs" << std::setw(9) << threads << std::setw(12) << t
+                  << std::setw(16) << numConstraints / t / 1000.0 << std::setw(10) << gsTime / t << std::endl;
+    }
+}
+
+void createLatticeScene( PBD::CWorld<>* pWorld, size_t side )
+{
+    //Slightly overlapping lattice of particles, each one in its own group so every neighbour pair is a contact
+    const double partSize = 0.1;
+    const double spacing  = 0.095;
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<double> jitter(-0.005, 0.005);
+
+    for (size_t i=0; i<side; ++i)
+    {
+        for (size_t j=0; j<side; ++j)
+        {
+            for (size_t k=0; k<side; ++k)
+            {
+                size_t idx = pWorld->m_particles.push_back( PBD::CParticle<>(i*spacing, j*spacing, k*spacing, 0.01, partSize, pWorld->m_particles.size()) );
+                pWorld->m_particles.m_predPosition[idx] += Eigen::Vector3d(jitter(rng), jitter(rng), jitter(rng));
+            }
+        }
+    }
+
+    //Chains of distance constraints along x
+    for (size_t idx=0; idx+side*side<pWorld->m_particles.size(); ++idx)
+    {
+        pWorld->m_permanentConstraints.m_distance.emplace_back(pWorld->m_particles, idx, idx+side*side);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef PBD_TESTFRAMEWORK_H
+#define PBD_TESTFRAMEWORK_H
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+// Minimal self-registering test harness of pbd_tests. A test is declared with PBD_TEST(group, name) in any test file;
+// pbd_tests <prefix> runs the tests whose "group.name" starts with prefix (all of them without argument), and each
+// ctest entry runs one group. A failed check reports its location and the test goes on; the exit code is non-zero if
+// any check failed.
+
+namespace PBDTest
+{
+
+struct STestCase
+{
+    std::string m_name;
+    void (*m_function)();
+};
+
+inline std::vector<STestCase>& registry()
+{
+    static std::vector<STestCase> tests;
+    return tests;
+}
+
+inline size_t& failedChecks()
+{
+    static size_t failed = 0;
+    return failed;
+}
+
+struct SRegistrar
+{
+    SRegistrar(const char* name, void (*function)()) { registry().push_back(STestCase{ name, function }); }
+};
+
+inline void reportFailure(const char* file, const int& line, const std::string& message)
+{
+    ++failedChecks();
+    std::cerr << file << ":" << line << ": check failed: " << message << std::endl;
+}
+
+}
+
+#define PBD_TEST(group, name) \
+    static void group##_##name(); \
+    static PBDTest::SRegistrar group##_##name##_registrar(#group "." #name, group##_##name); \
+    static void group##_##name()
+
+#define PBD_CHECK(condition) \
+    do { if (!(condition)) PBDTest::reportFailure(__FILE__, __LINE__, #condition); } while (false)
+
+#define PBD_CHECK_NEAR(a, b, tolerance) \
+    do \
+    { \
+        const double _a = double(a), _b = double(b); \
+        if (!(std::abs(_a - _b) <= double(tolerance))) \
+        { \
+            std::ostringstream _message; \
+            _message << #a " = " << _a << ", " #b " = " << _b << ", tolerance " << double(tolerance); \
+            PBDTest::reportFailure(__FILE__, __LINE__, _message.str()); \
+        } \
+    } while (false)
+
+#endif //PBD_TESTFRAMEWORK_H
@@ -0,0 +1,80 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+#include <random>
+#include <set>
+#include <utility>
+
+// The hash grid broad phase (with the object sweep-and-prune in front of it) must find exactly the contacts of the
+// brute force search over all the particle pairs.
+
+namespace
+{
+
+typedef std::set< std::pair<size_t,size_t> > PairSet;
+
+PairSet contactPairs(const PBD::CConstraintStore<double>& constraints)
+{
+    PairSet pairs;
+    for (const auto& c:constraints.m_noPenetration)
+    {
+        pairs.emplace(std::min(c.m_particles[0], c.m_particles[1]), std::max(c.m_particles[0], c.m_particles[1]));
+    }
+    return pairs;
+}
+
+void checkAgainstBruteForce(PBD::CWorld<>& world)
+{
+    world.m_constraints.clear();
+    world.createCollisionConstraints();
+    const PairSet grid = contactPairs(world.m_constraints);
+
+    world.m_constraints.clear();
+    world.createCollisionConstraintsBruteForce();
+    const PairSet bruteForce = contactPairs(world.m_constraints);
+
+    PBD_CHECK(!bruteForce.empty());
+    PBD_CHECK(grid == bruteForce);
+}
+
+}
+
+PBD_TEST(broadPhase, randomScenesMatchBruteForce)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> coordinate(-1.5, 1.5);
+    std::uniform_int_distribution<size_t> group(1, 12);
+    std::uniform_int_distribution<int> choice(0, 3);
+    for (size_t scene=0; scene<20; ++scene)
+    {
+        //Sizes 0.05 and 0.1: the grid cells are 0.1 wide. A quarter of the particles is snapped to cell boundaries.
+        PBD::CWorld<> world;
+        for (size_t p=0; p<600; ++p)
+        {
+            Eigen::Vector3d x(coordinate(rng), coordinate(rng), coordinate(rng));
+            if (choice(rng) == 0) x = (x / 0.1).array().round().matrix() * 0.1;
+            const double size = choice(rng) < 2 ? 0.05 : 0.1;
+            const double mass = choice(rng) == 0 ? 0.0 : 0.01;
+            world.m_particles.push_back(PBD::CParticle<double>(x(0), x(1), x(2), mass, size, group(rng)));
+        }
+        checkAgainstBruteForce(world);
+    }
+}
+
+PBD_TEST(broadPhase, touchingParticlesOnCellBoundaries)
+{
+    //Rows of touching particles (distance exactly equal to the size) along each axis, crossing the origin, so pairs
+    //straddle cell boundaries and negative cell coordinates. The spacing is exact in binary.
+    PBD::CWorld<> world;
+    size_t group = 1;
+    for (int axis=0; axis<3; ++axis)
+    {
+        for (int k=-10; k<=10; ++k)
+        {
+            Eigen::Vector3d x = Eigen::Vector3d::Constant(-0.375 * (axis + 1));
+            x(axis) = k * 0.125;
+            world.m_particles.push_back(PBD::CParticle<double>(x(0), x(1), x(2), 0.01, 0.125, group++));
+        }
+    }
+    checkAgainstBruteForce(world);
+    PBD_CHECK(world.m_constraints.m_noPenetration.size() == 3 * 20);
+}
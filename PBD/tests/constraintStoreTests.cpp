@@ -0,0 +1,84 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+
+// The constraint arrays stamp a new generation on every change of their contents, and the caches CWorld derives from
+// the permanent constraints are rebuilt when the generation changes, also when the number of constraints does not.
+
+namespace
+{
+
+class CColoringWorld: public PBD::CWorld<>
+{
+public:
+    size_t getNumPermanentColors() const { return m_permanentColoring.getNumColors(); }
+};
+
+void addRow(PBD::CWorld<>& world, const size_t& n)
+{
+    for (size_t p=0; p<n; ++p)
+    {
+        world.m_particles.push_back(PBD::CParticle<double>(0.2*p, 0, 1, 0.01, 0.05, p+1));
+    }
+}
+
+}
+
+PBD_TEST(constraintStore, generationChangesOnEveryMutation)
+{
+    PBD::CParticleStore<double> store;
+    store.push_back(PBD::CParticle<double>(0, 0, 0, 1, 0.1, 1));
+    store.push_back(PBD::CParticle<double>(1, 0, 0, 1, 0.1, 2));
+    store.push_back(PBD::CParticle<double>(2, 0, 0, 1, 0.1, 3));
+
+    PBD::CConstraintStore<double> constraints;
+    uint64_t generation = constraints.getGeneration();
+
+    constraints.m_distance.emplace_back(store, 0, 1);
+    PBD_CHECK(constraints.getGeneration() != generation);
+    generation = constraints.getGeneration();
+
+    //Same size, different constraint
+    constraints.clear();
+    constraints.m_distance.emplace_back(store, 1, 2);
+    PBD_CHECK(constraints.getGeneration() != generation);
+    generation = constraints.getGeneration();
+
+    //Writing the accumulated state of a constraint is not a change of the store
+    constraints.m_noPenetration.emplace_back(0, 2);
+    generation = constraints.getGeneration();
+    constraints.m_noPenetration[0].m_correction = 1;
+    PBD_CHECK(constraints.getGeneration() == generation);
+    constraints.m_noPenetration.touch();
+    PBD_CHECK(constraints.getGeneration() != generation);
+
+    //A copy has its own generation
+    PBD::CConstraintStore<double> copy;
+    copy = constraints;
+    PBD_CHECK(copy.getGeneration() != constraints.getGeneration());
+    PBD_CHECK(copy.size() == constraints.size());
+}
+
+PBD_TEST(constraintStore, permanentColoringFollowsReplacedConstraints)
+{
+    CColoringWorld world;
+    world.setNumThreads(2);
+    world.m_solverMode = PBD::CWorld<>::COLORED_GAUSS_SEIDEL;
+    world.m_gravity = Eigen::Vector3d::Zero();
+    addRow(world, 6);
+
+    //Three disjoint pairs fit in one color
+    world.m_permanentConstraints.m_distance.emplace_back(world.m_particles, 0, 1);
+    world.m_permanentConstraints.m_distance.emplace_back(world.m_particles, 2, 3);
+    world.m_permanentConstraints.m_distance.emplace_back(world.m_particles, 4, 5);
+    world.step(0.005, 1.0);
+    PBD_CHECK(world.getNumPermanentColors() == 1);
+
+    //The same number of constraints in a chain: consecutive links share a particle and need two colors
+    world.m_permanentConstraints.clear();
+    world.m_permanentConstraints.m_distance.emplace_back(world.m_particles, 0, 1);
+    world.m_permanentConstraints.m_distance.emplace_back(world.m_particles, 1, 2);
+    world.m_permanentConstraints.m_distance.emplace_back(world.m_particles, 2, 3);
+    world.step(0.005, 1.0);
+    PBD_CHECK(world.getNumPermanentColors() == 2);
+    PBD_CHECK(world.getStepStats().m_numPermanentConstraints == 3);
+}
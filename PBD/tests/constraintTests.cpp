@@ -0,0 +1,74 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+#include <limits>
+
+// Distance constraints are satisfied within their tolerance band, the band project() leaves the particles in, so the
+// solvers can stop iterating once every constraint is projected.
+
+namespace
+{
+
+size_t addParticle(PBD::CParticleStore<double>& store, const double& x, const double& mass)
+{
+    return store.push_back(PBD::CParticle<double>(x, 0, 0, mass, 0.1, 1));
+}
+
+}
+
+PBD_TEST(constraints, distanceSatisfiedWithinTolerance)
+{
+    PBD::CParticleStore<double> store;
+    const size_t a = addParticle(store, 0, 1);
+    const size_t b = addParticle(store, 1, 1);
+    PBD::SDistanceConstraint<double> c(store, a, b);
+    PBD_CHECK(c.isSatisfied(store));
+    PBD_CHECK(c.isPredSatisfied(store));
+
+    //Inside the band, on both sides
+    store.m_predPosition[b](0) = 1 + 0.5*c.getDistanceTolerance();
+    PBD_CHECK(c.isPredSatisfied(store));
+    store.m_predPosition[b](0) = 1 - 0.5*c.getDistanceTolerance();
+    PBD_CHECK(c.isPredSatisfied(store));
+
+    //Outside the band, on both sides
+    store.m_predPosition[b](0) = 1 + 2*c.getDistanceTolerance();
+    PBD_CHECK(!c.isPredSatisfied(store));
+    store.m_predPosition[b](0) = 1 - 2*c.getDistanceTolerance();
+    PBD_CHECK(!c.isPredSatisfied(store));
+
+    store.m_predPosition[b](0) = std::numeric_limits<double>::quiet_NaN();
+    PBD_CHECK(!c.isPredSatisfied(store));
+}
+
+PBD_TEST(constraints, distanceProjectionEndsSatisfied)
+{
+    PBD::CParticleStore<double> store;
+    const size_t a = addParticle(store, 0, 1);
+    const size_t b = addParticle(store, 1, 1);
+    PBD::SDistanceConstraint<double> c(store, a, b);
+    c.setConstraintStiffness(1);
+
+    store.m_predPosition[b](0) = 1.5;
+    PBD_CHECK(!c.isPredSatisfied(store));
+    c.project(store);
+    PBD_CHECK(c.isPredSatisfied(store));
+}
+
+PBD_TEST(constraints, satisfiedDistanceConstraintsStopTheSolver)
+{
+    //A particle hanging from a static one: gravity moves it by far less than the tolerance in one step, so the first
+    //iteration already finds every constraint satisfied
+    const PBD::CWorld<>::ESolverMode modes[] = { PBD::CWorld<>::GAUSS_SEIDEL, PBD::CWorld<>::COLORED_GAUSS_SEIDEL };
+    for (const auto& mode:modes)
+    {
+        PBD::CWorld<> world;
+        world.m_gravity = Eigen::Vector3d(0,0,-9.81);
+        world.m_solverMode = mode;
+        const size_t anchor = world.m_particles.push_back(PBD::CParticle<double>(0, 0, 1, 0, 0.05, 1));
+        const size_t bob = world.m_particles.push_back(PBD::CParticle<double>(0, 0, 0.9, 0.01, 0.05, 1));
+        world.m_permanentConstraints.m_distance.emplace_back(world.m_particles, anchor, bob);
+
+        world.step(0.005, 1.0);
+        PBD_CHECK(world.getStepStats().m_contactIterations == 1);
+    }
+}
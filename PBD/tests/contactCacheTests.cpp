@@ -0,0 +1,82 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+
+// Contacts that persist from one step to the next are found in the contact cache and warm started with a fraction of
+// their previous separation; new contacts start cold.
+
+namespace
+{
+
+/// Column of particles resting on a static one, each in its own group so every pair in touch is a contact.
+void createColumn(PBD::CWorld<>& world, const size_t& height)
+{
+    world.m_gravity = Eigen::Vector3d(0,0,-9.81);
+    for (size_t k=0; k<height; ++k)
+    {
+        world.m_particles.push_back(PBD::CParticle<double>(0, 0, 0.1*k, k == 0 ? 0 : 0.01, 0.1, k+1));
+    }
+}
+
+}
+
+PBD_TEST(contactCache, persistingContactsAreWarmStarted)
+{
+    PBD::CParticleStore<double> store;
+    store.push_back(PBD::CParticle<double>(0, 0, 0, 1, 0.1, 1));
+    store.push_back(PBD::CParticle<double>(0, 0, 0.09, 1, 0.1, 2));
+    store.push_back(PBD::CParticle<double>(0, 0, 0.18, 1, 0.1, 3));
+
+    PBD::CConstraintArray< PBD::SNoPenetrationConstraint<double> > contacts;
+    contacts.emplace_back(0, 1);
+    contacts.emplace_back(2, 1);
+    contacts[0].m_correction = 0.01;
+
+    //Only the contacts that applied a separation are cached, keyed by the unordered pair
+    PBD::CContactCache<double> cache;
+    cache.update(contacts);
+    PBD_CHECK(cache.size() == 1);
+
+    PBD::CConstraintArray< PBD::SNoPenetrationConstraint<double> > next;
+    next.emplace_back(1, 0);
+    next.emplace_back(1, 2);
+    const Eigen::Vector3d before = store.m_predPosition[1];
+    cache.warmStart(next, store, 0.5);
+    PBD_CHECK(cache.getNumWarmStarted() == 1);
+    PBD_CHECK_NEAR(next[0].m_correction, 0.005, 1e-12);
+    PBD_CHECK(next[1].m_correction == 0);
+    PBD_CHECK_NEAR((store.m_predPosition[1] - before).norm() + (store.m_predPosition[0] - Eigen::Vector3d(0,0,0)).norm(), 0.005, 1e-12);
+
+    cache.clear();
+    cache.warmStart(next, store, 0.5);
+    PBD_CHECK(cache.getNumWarmStarted() == 0);
+}
+
+PBD_TEST(contactCache, restingColumnHitsTheCache)
+{
+    PBD::CWorld<> cold;
+    PBD::CWorld<> warm;
+    createColumn(cold, 6);
+    createColumn(warm, 6);
+    warm.m_contactWarmStarting = 0.8;
+
+    //Once settled, every step finds contacts of the previous one in the cache
+    size_t coldHits = 0;
+    bool warmHits = true;
+    for (size_t s=0; s<100; ++s)
+    {
+        cold.step(0.005, 1.0);
+        warm.step(0.005, 1.0);
+        coldHits += cold.getStepStats().m_numWarmStartedContacts;
+
+        const PBD::CStepStats& stats = warm.getStepStats();
+        if (s >= 50) warmHits = warmHits && stats.m_numWarmStartedContacts > 0 &&
+                                stats.m_numWarmStartedContacts <= stats.m_numContactConstraints;
+    }
+    PBD_CHECK(coldHits == 0);
+    PBD_CHECK(warmHits);
+    for (size_t p=0; p<warm.m_particles.size(); ++p)
+    {
+        PBD_CHECK(warm.m_particles.m_position[p].allFinite());
+        PBD_CHECK_NEAR(warm.m_particles.m_position[p](2), cold.m_particles.m_position[p](2), 0.01);
+    }
+}
@@ -0,0 +1,50 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+
+// The particle store keeps each attribute in its own array, indexed like the particles were pushed. A view writes
+// through to the arrays, and static particles have no inverse mass.
+
+PBD_TEST(particleStore, pushBackCopiesEveryAttribute)
+{
+    PBD::CParticleStore<double> store;
+    PBD_CHECK(store.empty());
+    PBD::CParticle<double> moving(1, 2, 3, 0.5, -0.5, 0, 2, 0.1, 7);
+    moving.m_extForce = Eigen::Vector3d(0, 0, -1);
+    PBD_CHECK(store.push_back(moving) == 0);
+    PBD_CHECK(store.emplace_back(PBD::CParticle<double>::Ptr(new PBD::CParticle<double>(4, 5, 6, 0, 0.2, 8))) == 1);
+
+    PBD_CHECK(store.size() == 2);
+    PBD_CHECK(store.m_position[0] == Eigen::Vector3d(1,2,3) && store.m_predPosition[0] == store.m_position[0]);
+    PBD_CHECK(store.m_velocity[0] == Eigen::Vector3d(0.5,-0.5,0) && store.m_extForce[0] == moving.m_extForce);
+    PBD_CHECK(store.m_mass[0] == 2 && store.m_massInv[0] == 0.5);
+    PBD_CHECK(store.m_size[0] == 0.1 && store.m_group[0] == 7 && store.m_rigidBody[0] == PBD::noRigidBody);
+    PBD_CHECK(store.m_position[1] == Eigen::Vector3d(4,5,6) && store.m_group[1] == 8);
+    PBD_CHECK(store.m_mass[1] == 0 && store.m_massInv[1] == 0);
+
+    //Every array holds one entry per particle
+    const size_t sizes[] = { store.m_predPosition.size(), store.m_velocity.size(), store.m_extForce.size(),
+                             store.m_mass.size(), store.m_massInv.size(), store.m_size.size(), store.m_group.size(),
+                             store.m_rigidBody.size(), store.m_orientation.size(), store.m_predOrientation.size(),
+                             store.m_angularVelocity.size() };
+    for (const auto& s:sizes) PBD_CHECK(s == 2);
+
+    store.clear();
+    PBD_CHECK(store.empty() && store.m_massInv.empty() && store.m_angularVelocity.empty());
+}
+
+PBD_TEST(particleStore, viewsWriteThroughToTheArrays)
+{
+    PBD::CParticleStore<double> store;
+    store.push_back(PBD::CParticle<double>(0, 0, 0, 1, 0.1, 1));
+    store.push_back(PBD::CParticle<double>(1, 0, 0, 1, 0.1, 1));
+
+    auto p = store[1];
+    p->m_position = Eigen::Vector3d(1, 1, 1);
+    p->m_group = 3;
+    p->setMass(4);
+    PBD_CHECK(store.m_position[1] == Eigen::Vector3d(1,1,1) && store.m_group[1] == 3);
+    PBD_CHECK(store.m_mass[1] == 4 && store.m_massInv[1] == 0.25 && p->getMassInv() == 0.25);
+    p->setMass(0);
+    PBD_CHECK(store.m_massInv[1] == 0);
+    PBD_CHECK(store.m_position[0] == Eigen::Vector3d(0,0,0) && store.m_mass[0] == 1);
+}
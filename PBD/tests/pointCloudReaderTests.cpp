@@ -0,0 +1,81 @@
+#include "TestFramework.h"
+#include <io/PointCloudReader.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+// Point cloud readers return the points of the file in order, scaled, whatever the number of threads or chunks, and
+// skip what is not a point.
+
+namespace
+{
+
+typedef Eigen::Vector3d Vector;
+
+std::string pointCloudPath(const std::string& name)
+{
+    return "pbd_tests_" + name + "_" + std::to_string(getpid());
+}
+
+}
+
+PBD_TEST(pointCloudReader, asciiLinesAreParsedOrSkipped)
+{
+    const std::string text = "# comment\n"
+                             "1 2 3\n"
+                             "\n"
+                             "  -4.5\t+5e-1 6E1 0.1 0.2 0.3 255 0 0\r\n"
+                             "7,8,9\n"
+                             "1 2\n"
+                             "x 1 2 3\n"
+                             "10 11 12";
+    std::vector<Vector> points(1, Vector::Zero());
+    PBD::parseASCIIXYZ<double>(text.data(), text.data() + text.size(), 2, points);
+
+    PBD_CHECK(points.size() == 5);
+    if (points.size() != 5) return;
+    PBD_CHECK(points[0] == Vector::Zero());
+    PBD_CHECK(points[1] == Vector(2, 4, 6));
+    PBD_CHECK(points[2] == Vector(-9, 1, 120));
+    PBD_CHECK(points[3] == Vector(14, 16, 18));
+    PBD_CHECK(points[4] == Vector(20, 22, 24));
+}
+
+PBD_TEST(pointCloudReader, asciiChunksKeepTheFileOrder)
+{
+    //Several 64 KiB chunks, split inside lines
+    std::mt19937 rng(31);
+    std::uniform_real_distribution<double> coordinate(-100, 100);
+    std::vector<Vector> expected;
+    const std::string path = pointCloudPath("ascii") + ".xyz";
+    {
+        std::ofstream out(path);
+        out.precision(17);
+        for (size_t k=0; k<20000; ++k)
+        {
+            expected.emplace_back(coordinate(rng), coordinate(rng), coordinate(rng));
+            out << expected.back()(0) << " " << expected.back()(1) << " " << expected.back()(2) << " 0 0 1\n";
+        }
+    }
+
+    for (size_t numThreads=1; numThreads<=4; numThreads+=3)
+    {
+        std::vector<Vector> points;
+        double pointsPerSecond = -1;
+        PBD_CHECK(PBD::readASCIIXYZPointCloud<double>(path, points, 1, &pointsPerSecond, numThreads));
+        PBD_CHECK(points == expected);
+        PBD_CHECK(pointsPerSecond >= 0);
+    }
+
+    //Appended, scaled, in single precision
+    std::vector<Eigen::Vector3f> points(2, Eigen::Vector3f::Zero());
+    PBD_CHECK(PBD::readASCIIXYZPointCloud<float>(path, points, 0.5f));
+    PBD_CHECK(points.size() == expected.size() + 2);
+    bool close = true;
+    for (size_t k=0; k<expected.size(); ++k) close = close && (points[k+2].cast<double>() - 0.5*expected[k]).norm() < 1e-4;
+    PBD_CHECK(close);
+
+    std::remove(path.c_str());
+    PBD_CHECK(!PBD::readASCIIXYZPointCloud<double>(path, points));
+}
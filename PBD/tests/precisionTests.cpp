@@ -0,0 +1,95 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+#include <unistd.h>
+#include <cstdio>
+
+// The whole pipeline is instantiated in single precision: a CWorld<float> steps the scenes of a CWorld<double> and
+// stays close to it until contacts diverge. Snapshots record their precision.
+
+namespace
+{
+
+/// Shape-matched and rigid cubes falling on a static slab, and a hanging chain.
+template<typename T_real>
+void createScene(PBD::CWorld<T_real>& world)
+{
+    typedef vec3::Vector3<T_real> V;
+    world.m_gravity = Eigen::Matrix<T_real,3,1>(0,0,-9.81);
+    PBD::createParticleSystemSolidCube<T_real>(V(-1,-1,-0.1), V(3,2,0.1), &world, 0.1, 0, 0);
+    PBD::createParticleSystemSolidCube<T_real>(V(0,0,0.1), V(0.3,0.3,0.3), &world, 0.1, 0.02, 1);
+    world.m_rigidBodyFastPath = true;
+    PBD::createParticleSystemSolidCube<T_real>(V(0.6,0,0.2), V(0.3,0.3,0.3), &world, 0.1, 0.02, 2);
+    world.m_rigidBodyFastPath = false;
+
+    size_t previous = world.m_particles.push_back(PBD::CParticle<T_real>(0, 0.8, 1, 0, 0.05, 3));
+    for (size_t k=1; k<10; ++k)
+    {
+        const size_t current = world.m_particles.push_back(PBD::CParticle<T_real>(T_real(0.052)*k, 0.8, 1, 0.01, 0.05, 3));
+        world.m_permanentConstraints.m_distance.emplace_back(world.m_particles, previous, current);
+        previous = current;
+    }
+}
+
+}
+
+PBD_TEST(precision, floatWorldFollowsDoubleWorld)
+{
+    const PBD::CWorld<double>::ESolverMode modes[] = { PBD::CWorld<double>::GAUSS_SEIDEL, PBD::CWorld<double>::JACOBI,
+                                                       PBD::CWorld<double>::COLORED_GAUSS_SEIDEL };
+    for (const auto& mode:modes)
+    {
+        PBD::CWorld<double> reference;
+        PBD::CWorld<float> world;
+        createScene(reference);
+        createScene(world);
+        reference.m_solverMode = mode;
+        world.m_solverMode = PBD::CWorld<float>::ESolverMode(mode);
+        reference.setNumThreads(2);
+        world.setNumThreads(2);
+        PBD_CHECK(world.m_particles.size() == reference.m_particles.size());
+
+        //The first steps are free falls: the precisions only differ by rounding
+        bool finite = true;
+        double drift = 0;
+        for (size_t s=0; s<200; ++s)
+        {
+            reference.step(0.005, 1.0);
+            world.step(0.005f, 1.0);
+            world.syncRigidBodyParticles();
+            reference.syncRigidBodyParticles();
+            for (size_t p=0; p<world.m_particles.size(); ++p)
+            {
+                finite = finite && world.m_particles.m_position[p].allFinite();
+                if (s < 20)
+                {
+                    drift = std::max(drift, (world.m_particles.m_position[p].cast<double>() - reference.m_particles.m_position[p]).norm());
+                }
+            }
+        }
+        PBD_CHECK(finite);
+        PBD_CHECK(drift < 1e-4);
+    }
+}
+
+PBD_TEST(precision, snapshotsKeepTheirPrecision)
+{
+    PBD::CWorld<float> saved;
+    createScene(saved);
+    for (size_t s=0; s<10; ++s) saved.step(0.005f, 1.0);
+
+    const std::string path = "pbd_tests_precision_" + std::to_string(getpid()) + ".snapshot";
+    PBD_CHECK(saved.saveSnapshot(path));
+
+    PBD::CWorld<double> other;
+    PBD_CHECK(!other.loadSnapshot(path));
+    PBD_CHECK(other.m_particles.size() == 0);
+
+    PBD::CWorld<float> loaded;
+    PBD_CHECK(loaded.loadSnapshot(path));
+    std::remove(path.c_str());
+    PBD_CHECK(loaded.m_particles.size() == saved.m_particles.size());
+    for (size_t p=0; p<saved.m_particles.size(); ++p)
+    {
+        PBD_CHECK(loaded.m_particles.m_position[p] == saved.m_particles.m_position[p]);
+    }
+}
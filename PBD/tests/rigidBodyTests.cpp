@@ -0,0 +1,76 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+
+// Rigid bodies need dynamic particles, and an object created on the rigid body fast path must follow the trajectory
+// of the same object on the shape-matching particle path while nothing touches it.
+
+namespace
+{
+
+typedef vec3::Vector3<double> V;
+
+void createCubes(PBD::CWorld<>& world, const bool& rigid)
+{
+    world.m_gravity = Eigen::Vector3d(0,0,-9.81);
+    world.m_rigidBodyFastPath = rigid;
+    for (size_t k=0; k<3; ++k)
+    {
+        PBD::createParticleSystemSolidCube<double>(V(0.6*k, 0, 0.4*k), V(0.3,0.2,0.4), &world, 0.1, 0.02, k+1);
+    }
+}
+
+}
+
+PBD_TEST(rigidBody, bodiesWithoutMassAreRejected)
+{
+    PBD::CWorld<> world;
+    world.m_gravity = Eigen::Vector3d(0,0,-9.81);
+    world.m_sleepingEnabled = true;
+    for (size_t p=0; p<4; ++p)
+    {
+        world.m_particles.push_back(PBD::CParticle<double>(0.1*p, 0, 0, 0, 0.1, 1));
+    }
+    for (size_t p=0; p<4; ++p)
+    {
+        world.m_particles.push_back(PBD::CParticle<double>(0.1*p, 1, 0, p == 2 ? 0 : 0.01, 0.1, 2));
+    }
+
+    PBD_CHECK(!world.addRigidBody(0, 4));
+    PBD_CHECK(!world.addRigidBody(4, 8));
+    PBD_CHECK(!world.addRigidBody(3, 3));
+    PBD_CHECK(!world.addRigidBody(6, 9));
+    PBD_CHECK(world.m_rigidBodies.empty());
+    PBD_CHECK(world.m_particles.m_rigidBody[0] == PBD::noRigidBody);
+
+    for (size_t s=0; s<10; ++s) world.step(0.005, 1.0);
+    for (size_t p=0; p<world.m_particles.size(); ++p)
+    {
+        PBD_CHECK(world.m_particles.m_position[p].allFinite());
+    }
+    PBD_CHECK(world.m_particles.m_position[0] == Eigen::Vector3d(0,0,0));
+}
+
+PBD_TEST(rigidBody, fastPathFollowsParticlePath)
+{
+    PBD::CWorld<> particles;
+    PBD::CWorld<> rigid;
+    createCubes(particles, false);
+    createCubes(rigid, true);
+    PBD_CHECK(particles.m_rigidBodies.empty() && particles.m_shapeMatchingConstraints.size() == 3);
+    PBD_CHECK(rigid.m_rigidBodies.size() == 3 && rigid.m_shapeMatchingConstraints.empty());
+
+    //Falling without contacts
+    double maxDistance = 0;
+    for (size_t s=0; s<100; ++s)
+    {
+        particles.step(0.005, 1.0);
+        rigid.step(0.005, 1.0);
+        rigid.syncRigidBodyParticles();
+        for (size_t p=0; p<particles.m_particles.size(); ++p)
+        {
+            maxDistance = std::max(maxDistance, (particles.m_particles.m_position[p] - rigid.m_particles.m_position[p]).norm());
+        }
+    }
+    PBD_CHECK(particles.m_particles.m_position[0](2) < -0.1);
+    PBD_CHECK(maxDistance < 1e-6);
+}
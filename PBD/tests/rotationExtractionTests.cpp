@@ -0,0 +1,85 @@
+#include "TestFramework.h"
+#include <physics/RotationExtraction.h>
+#include <random>
+
+// extractRotation converges to the rotation R of a deformation A = R*S (S symmetric positive definite). Warm started
+// from the rotation of the previous frame it needs fewer iterations, and a capped number of iterations per frame
+// follows a moving body continuously, a bounded angle behind it.
+
+namespace
+{
+
+typedef Eigen::Matrix3d Matrix;
+
+/// Random stretch: symmetric with eigenvalues in [minScale, maxScale].
+Matrix randomStretch(std::mt19937& rng, const double& minScale, const double& maxScale)
+{
+    std::uniform_real_distribution<double> scale(minScale, maxScale);
+    const Matrix basis = Eigen::Quaterniond::UnitRandom().toRotationMatrix();
+    return basis * Eigen::Vector3d(scale(rng), scale(rng), scale(rng)).asDiagonal() * basis.transpose();
+}
+
+}
+
+PBD_TEST(rotationExtraction, convergesToThePolarRotation)
+{
+    //UnitRandom draws from std::rand
+    std::mt19937 rng(23);
+    std::srand(23);
+    for (size_t k=0; k<100; ++k)
+    {
+        const Eigen::Quaterniond rotation = Eigen::Quaterniond::UnitRandom();
+        const Matrix A = rotation.toRotationMatrix() * randomStretch(rng, 0.5, 2);
+
+        //Cold start from the identity
+        Eigen::Quaterniond q = Eigen::Quaterniond::Identity();
+        PBD::extractRotation<double>(A, q, 200);
+        PBD_CHECK(q.angularDistance(rotation) < 1e-6);
+        PBD_CHECK_NEAR(q.norm(), 1, 1e-12);
+
+        //A rotation is its own polar rotation: nothing to do
+        q = rotation;
+        const Matrix R = rotation.toRotationMatrix();
+        PBD_CHECK(PBD::extractRotation<double>(R, q) == 0);
+        PBD_CHECK(q.angularDistance(rotation) < 1e-9);
+    }
+}
+
+PBD_TEST(rotationExtraction, warmStartFollowsSmallMotions)
+{
+    //A slightly deformed body spinning by 0.02 rad per frame, the rotation of each frame starting the next one
+    std::mt19937 rng(29);
+    const Matrix stretch = randomStretch(rng, 0.9, 1.1);
+    const Eigen::Vector3d axis = Eigen::Vector3d(1, 2, -1).normalized();
+    Eigen::Quaterniond warm = Eigen::Quaterniond::Identity();
+    Eigen::Quaterniond capped = Eigen::Quaterniond::Identity();
+    unsigned int warmIterations = 0, coldIterations = 0;
+    double warmError = 0, cappedError = 0, cappedJump = 0;
+    for (size_t frame=1; frame<=300; ++frame)
+    {
+        const Eigen::Quaterniond rotation(Eigen::AngleAxisd(0.02*frame, axis));
+        const Matrix A = rotation.toRotationMatrix() * stretch;
+        warmIterations += PBD::extractRotation<double>(A, warm, 100);
+        warmError = std::max(warmError, warm.angularDistance(rotation));
+
+        Eigen::Quaterniond cold = Eigen::Quaterniond::Identity();
+        coldIterations += PBD::extractRotation<double>(A, cold, 100);
+
+        //Two iterations per frame lag behind the motion, by a bounded angle
+        const Eigen::Quaterniond previous = capped;
+        PBD::extractRotation<double>(A, capped, 2);
+        cappedError = std::max(cappedError, capped.angularDistance(rotation));
+        cappedJump = std::max(cappedJump, capped.angularDistance(previous));
+    }
+    PBD_CHECK(warmError < 1e-6);
+    PBD_CHECK(warmIterations < coldIterations);
+    PBD_CHECK(cappedError < 0.01);
+    PBD_CHECK(cappedJump < 0.03);
+
+    //Single precision stops at its own epsilon
+    Eigen::Quaternionf qf = Eigen::Quaternionf::Identity();
+    const Eigen::Quaternionf rotation(Eigen::AngleAxisf(0.7f, axis.cast<float>()));
+    const Eigen::Matrix3f A = rotation.toRotationMatrix() * stretch.cast<float>();
+    PBD::extractRotation<float>(A, qf, 200);
+    PBD_CHECK(qf.angularDistance(rotation) < 1e-3);
+}
@@ -0,0 +1,109 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+#include <unistd.h>
+#include <cstdio>
+#include <random>
+
+// A distance field built from samples of a sphere must return the distance to the sphere within a cell, with a normal
+// along the radius, wherever it is placed. A saved field maps back to the same distances.
+
+namespace
+{
+
+typedef Eigen::Vector3d Vector;
+
+const double radius = 0.5;
+const double cellSize = 0.04;
+
+/// Fibonacci sphere of the given radius around the origin, several samples per cell.
+std::vector<Vector> sphereSamples()
+{
+    const size_t numSamples = 40000;
+    std::vector<Vector> samples;
+    for (size_t k=0; k<numSamples; ++k)
+    {
+        const double z = 1 - 2*(k + 0.5)/numSamples;
+        const double phi = k * M_PI * (3 - std::sqrt(5.0));
+        samples.push_back(radius * Vector(std::sqrt(1 - z*z)*std::cos(phi), std::sqrt(1 - z*z)*std::sin(phi), z));
+    }
+    return samples;
+}
+
+/// Compare the field with the sphere at random points of the grid, with the field placed at center with rotation.
+void checkAgainstSphere(const PBD::CSDFCollider<double>& sdf, const Vector& center, const Eigen::Matrix3d& rotation)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> coordinate(-radius - 2*cellSize, radius + 2*cellSize);
+    size_t insidePoints = 0;
+    for (size_t k=0; k<2000; ++k)
+    {
+        const Vector local(coordinate(rng), coordinate(rng), coordinate(rng));
+        const Vector p = center + rotation*local;
+        Vector normal;
+        const double distance = sdf.signedDistance(p, normal);
+        const double exact = local.norm() - radius;
+        insidePoints += exact < 0 ? 1 : 0;
+
+        PBD_CHECK_NEAR(distance, exact, cellSize);
+        PBD_CHECK_NEAR(normal.norm(), 1, 1e-9);
+
+        //Away from the center, where the distance has no gradient, the normal follows the radius
+        if (local.norm() > 0.3) PBD_CHECK(normal.dot(rotation*local.normalized()) > 0.95);
+    }
+    PBD_CHECK(insidePoints > 0 && insidePoints < 2000);
+}
+
+}
+
+PBD_TEST(sdfCollider, sphereMatchesAnalyticDistance)
+{
+    PBD::CSDFCollider<double> sdf;
+    PBD_CHECK(sdf.empty());
+    sdf.build(sphereSamples(), cellSize, 4);
+    PBD_CHECK(!sdf.empty());
+    checkAgainstSphere(sdf, Vector::Zero(), Eigen::Matrix3d::Identity());
+
+    //The field frame can be moved and rotated
+    sdf.m_position = Vector(1, -2, 0.5);
+    sdf.m_rotation = Eigen::AngleAxisd(0.8, Vector(1,-1,2).normalized()).toRotationMatrix();
+    checkAgainstSphere(sdf, sdf.m_position, sdf.m_rotation);
+
+    //Outside the grid nothing collides
+    Vector normal;
+    PBD_CHECK(sdf.signedDistance(sdf.m_position + Vector(radius + 10*cellSize, 0, 0), normal) == std::numeric_limits<double>::max());
+    PBD_CHECK(PBD::CSDFCollider<double>().signedDistance(Vector::Zero(), normal) == std::numeric_limits<double>::max());
+}
+
+PBD_TEST(sdfCollider, savedFieldMapsBack)
+{
+    PBD::CSDFCollider<double> built;
+    built.build(sphereSamples(), cellSize, 2);
+
+    const std::string path = "pbd_tests_sdf_" + std::to_string(getpid()) + ".pbdsdf";
+    PBD_CHECK(built.save(path));
+
+    PBD::CSDFCollider<double> loaded;
+    PBD_CHECK(loaded.load(path));
+    PBD::CSDFCollider<float> loadedFloat;
+    PBD_CHECK(loadedFloat.load(path));
+    std::remove(path.c_str());
+
+    PBD_CHECK(loaded.getNumValues() == built.getNumValues() && loaded.getCellSize() == built.getCellSize());
+    PBD_CHECK(loaded.getOrigin() == built.getOrigin());
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> coordinate(-radius, radius);
+    for (size_t k=0; k<200; ++k)
+    {
+        const Vector p(coordinate(rng), coordinate(rng), coordinate(rng));
+        Vector builtNormal, loadedNormal;
+        Eigen::Vector3f floatNormal;
+        const double distance = built.signedDistance(p, builtNormal);
+        PBD_CHECK(loaded.signedDistance(p, loadedNormal) == distance);
+        PBD_CHECK(loadedNormal == builtNormal);
+        PBD_CHECK_NEAR(loadedFloat.signedDistance(p.cast<float>(), floatNormal), distance, 1e-5);
+    }
+
+    //A missing file leaves the collider as it was
+    PBD_CHECK(!loaded.load(path));
+    PBD_CHECK(loaded.getNumValues() == built.getNumValues());
+}
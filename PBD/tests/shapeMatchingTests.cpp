@@ -0,0 +1,134 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+
+// A shape-matched cube dropped on a static floor must stay finite and come to rest on it. The default rotation
+// extraction is POLAR_QUATERNION; JACOBI_SVD must at least keep an orthonormal, hence invertible, frame. Objects
+// solved on several threads give the same results as on one.
+
+namespace
+{
+
+typedef vec3::Vector3<double> V;
+
+struct SCubeScene
+{
+    PBD::CWorld<> m_world;
+    size_t m_firstCubeParticle = 0;
+    bool m_finite = true;
+
+    SCubeScene()
+    {
+        m_world.m_gravity = Eigen::Vector3d(0,0,-9.81);
+        PBD::createParticleSystemSolidCube<double>(V(-1,-1,0), V(2,2,0.1), &m_world, 0.1, 0, 0);
+        m_firstCubeParticle = m_world.m_particles.size();
+        PBD::createParticleSystemSolidCube<double>(V(-0.1,-0.1,0.2), V(0.3,0.3,0.3), &m_world, 0.1, 0.02, 1);
+    }
+
+    void run(const size_t& steps)
+    {
+        for (size_t s=0; s<steps; ++s)
+        {
+            m_world.step(0.005, 1.0);
+            for (size_t p=0; p<m_world.m_particles.size(); ++p)
+            {
+                m_finite = m_finite && m_world.m_particles.m_position[p].allFinite();
+            }
+        }
+    }
+
+    double maxCubeSpeed() const
+    {
+        double speed = 0;
+        for (size_t p=m_firstCubeParticle; p<m_world.m_particles.size(); ++p)
+        {
+            speed = std::max(speed, m_world.m_particles.m_velocity[p].norm());
+        }
+        return speed;
+    }
+
+    double minCubeHeight() const
+    {
+        double z = std::numeric_limits<double>::max();
+        for (size_t p=m_firstCubeParticle; p<m_world.m_particles.size(); ++p)
+        {
+            z = std::min(z, m_world.m_particles.m_position[p](2));
+        }
+        return z;
+    }
+};
+
+}
+
+PBD_TEST(shapeMatching, restingCubeStaysFiniteAndComesToRest)
+{
+    SCubeScene scene;
+    PBD_CHECK(scene.m_world.m_shapeMatchingConstraints.size() == 1);
+    PBD_CHECK(scene.m_world.m_shapeMatchingConstraints[0]->getRotationExtraction() ==
+              PBD::CShapeMatchingConstraint<>::POLAR_QUATERNION);
+
+    scene.run(400);
+    PBD_CHECK(scene.m_finite);
+    PBD_CHECK(scene.maxCubeSpeed() < 0.2);
+
+    //Bottom layer resting on the floor particles (top at z=0.1, particles 0.1 wide), not sunk into it
+    PBD_CHECK_NEAR(scene.minCubeHeight(), 0.2, 0.03);
+}
+
+PBD_TEST(shapeMatching, svdFrameStaysOrthonormal)
+{
+    SCubeScene scene;
+    auto& constraint = *scene.m_world.m_shapeMatchingConstraints[0];
+    constraint.setRotationExtraction(PBD::CShapeMatchingConstraint<>::JACOBI_SVD);
+
+    for (size_t s=0; s<50; ++s)
+    {
+        scene.run(1);
+        const Eigen::Matrix3d frame = constraint.getDeformedCovMat();
+        PBD_CHECK((frame.transpose() * frame - Eigen::Matrix3d::Identity()).norm() < 1e-6);
+    }
+    PBD_CHECK(scene.m_finite);
+
+    //Swapped and flipped axes are matched back to the previous frame
+    const Eigen::Matrix3d previous = Eigen::Matrix3d::Identity();
+    Eigen::Matrix3d swapped;
+    swapped << 0, -1, 0,
+               1,  0, 0,
+               0,  0, 1;
+    const Eigen::Matrix3d matched = constraint.checkAxisInversion(previous, constraint.checkAxisPermutation(previous, swapped));
+    PBD_CHECK((matched - previous).norm() < 1e-12);
+}
+
+PBD_TEST(shapeMatching, threadCountDoesNotChangeResults)
+{
+    //Objects of very different sizes, handed out one at a time to the threads
+    auto createScene = [](PBD::CWorld<>& world)
+    {
+        world.m_gravity = Eigen::Vector3d(0,0,-9.81);
+        PBD::createParticleSystemSolidCube<double>(V(-1,-1,0), V(3,2,0.1), &world, 0.1, 0, 0);
+        PBD::createParticleSystemSolidCube<double>(V(-0.8,-0.8,0.2), V(0.6,0.6,0.4), &world, 0.1, 0.02, 1);
+        PBD::createParticleSystemSolidCube<double>(V(0,-0.8,0.2), V(0.2,0.2,0.2), &world, 0.1, 0.02, 2);
+        PBD::createParticleSystemSolidCube<double>(V(0.5,0,0.2), V(0.3,0.5,0.3), &world, 0.1, 0.02, 3);
+        PBD::createParticleSystemSolidCube<double>(V(1.2,0.5,0.3), V(0.2,0.2,0.5), &world, 0.1, 0.02, 4);
+    };
+    PBD::CWorld<> serial;
+    PBD::CWorld<> parallel;
+    createScene(serial);
+    createScene(parallel);
+    parallel.setNumThreads(3);
+    PBD_CHECK(parallel.m_shapeMatchingConstraints.size() == 4);
+
+    bool same = true;
+    for (size_t s=0; s<150; ++s)
+    {
+        serial.step(0.005, 1.0);
+        parallel.step(0.005, 1.0);
+        for (size_t p=0; p<serial.m_particles.size(); ++p)
+        {
+            same = same && serial.m_particles.m_position[p] == parallel.m_particles.m_position[p];
+        }
+    }
+    PBD_CHECK(same);
+    PBD_CHECK(parallel.getStepStats().m_numShapeMatchingConstraints == 4);
+    PBD_CHECK(parallel.getStepStats().m_maxShapeMatchingIterations >= 1);
+    PBD_CHECK(parallel.getStepStats().m_maxShapeMatchingIterations == serial.getStepStats().m_maxShapeMatchingIterations);
+}
@@ -0,0 +1,80 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+
+// Separate objects form separate islands. An island at rest falls asleep and stops moving, and wakes up when an awake
+// particle touches it or one of its particles gets an external force.
+
+namespace
+{
+
+typedef vec3::Vector3<double> V;
+
+/// Two shape-matched cubes resting apart on a static slab.
+void createScene(PBD::CWorld<>& world)
+{
+    world.m_gravity = Eigen::Vector3d(0,0,-9.81);
+    world.m_sleepingEnabled = true;
+    PBD::createParticleSystemSolidCube<double>(V(-1,-1,0), V(2,2,0.1), &world, 0.1, 0, 0);
+    PBD::createParticleSystemSolidCube<double>(V(-0.6,-0.1,0.2), V(0.3,0.3,0.3), &world, 0.1, 0.02, 1);
+    PBD::createParticleSystemSolidCube<double>(V(0.3,-0.1,0.2), V(0.3,0.3,0.3), &world, 0.1, 0.02, 2);
+}
+
+size_t numDynamicParticles(const PBD::CWorld<>& world)
+{
+    size_t n = 0;
+    for (const auto& m:world.m_particles.m_mass) n += m > 0 ? 1 : 0;
+    return n;
+}
+
+}
+
+PBD_TEST(sleeping, restingIslandsFallAsleep)
+{
+    PBD::CWorld<> world;
+    createScene(world);
+    const size_t dynamic = numDynamicParticles(world);
+
+    world.step(0.005, 1.0);
+    PBD_CHECK(world.getNumIslands() == 2);
+    PBD_CHECK(world.getNumSleepingParticles() == 0);
+
+    for (size_t s=0; s<600 && world.getNumSleepingParticles() < dynamic; ++s) world.step(0.005, 1.0);
+    PBD_CHECK(world.getNumSleepingParticles() == dynamic);
+    PBD_CHECK(world.getNumActiveParticles() == 0);
+
+    //Asleep, nothing moves
+    const std::vector<Eigen::Vector3d> asleep = world.m_particles.m_position;
+    for (size_t s=0; s<20; ++s) world.step(0.005, 1.0);
+    PBD_CHECK(world.m_particles.m_position == asleep);
+    for (size_t p=0; p<world.m_particles.size(); ++p) PBD_CHECK(world.m_particles.m_velocity[p].isZero(0));
+}
+
+PBD_TEST(sleeping, contactsAndForcesWakeIslands)
+{
+    PBD::CWorld<> world;
+    createScene(world);
+    const size_t dynamic = numDynamicParticles(world);
+    for (size_t s=0; s<600 && world.getNumSleepingParticles() < dynamic; ++s) world.step(0.005, 1.0);
+    PBD_CHECK(world.getNumSleepingParticles() == dynamic);
+    const size_t cubeSize = dynamic / 2;
+
+    //A particle dropped on the first cube wakes it, not the other one
+    const size_t dropped = world.m_particles.push_back(PBD::CParticle<double>(-0.5, 0, 0.6, 0.01, 0.1, 3));
+    bool woken = false;
+    for (size_t s=0; s<100 && !woken; ++s)
+    {
+        world.step(0.005, 1.0);
+        woken = !world.isSleeping(world.m_shapeMatchingConstraints[0]->m_particles[0]);
+    }
+    PBD_CHECK(woken);
+    PBD_CHECK(world.isSleeping(world.m_shapeMatchingConstraints[1]->m_particles[0]));
+    PBD_CHECK(world.getNumSleepingParticles() == cubeSize);
+    PBD_CHECK(!world.isSleeping(dropped));
+
+    //A force on one particle of the second cube wakes all of it
+    const size_t pushed = world.m_shapeMatchingConstraints[1]->m_particles[0];
+    world.m_particles.m_extForce[pushed] = Eigen::Vector3d(0.5, 0, 0);
+    world.step(0.005, 1.0);
+    PBD_CHECK(world.getNumSleepingParticles() == 0);
+    PBD_CHECK(world.m_particles.m_velocity[pushed](0) > 0);
+}
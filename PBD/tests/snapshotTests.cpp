@@ -0,0 +1,120 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+#include <unistd.h>
+#include <cstdio>
+
+// A world restored from a snapshot must continue the simulation of the saved world, and a snapshot with invalid rigid
+// body ranges must be rejected without touching the world.
+
+namespace
+{
+
+typedef vec3::Vector3<double> V;
+
+std::string snapshotPath(const std::string& name)
+{
+    return "pbd_tests_" + name + "_" + std::to_string(getpid()) + ".snapshot";
+}
+
+/// Shape-matched and rigid cubes falling on a static slab, next to a hanging chain.
+void createScene(PBD::CWorld<>& world)
+{
+    world.m_gravity = Eigen::Vector3d(0,0,-9.81);
+    PBD::createParticleSystemSolidCube<double>(V(-1,-1,-0.1), V(3,2,0.1), &world, 0.1, 0, 0);
+    PBD::createParticleSystemSolidCube<double>(V(0,0,0.1), V(0.3,0.3,0.3), &world, 0.1, 0.02, 1);
+    world.m_rigidBodyFastPath = true;
+    PBD::createParticleSystemSolidCube<double>(V(0.6,0,0.2), V(0.3,0.3,0.3), &world, 0.1, 0.02, 2);
+    PBD::createParticleSystemSolidCube<double>(V(1.2,0,0.3), V(0.3,0.3,0.3), &world, 0.1, 0.02, 3);
+
+    size_t previous = world.m_particles.push_back(PBD::CParticle<double>(0, 0.8, 1, 0, 0.05, 4));
+    for (size_t k=1; k<10; ++k)
+    {
+        const size_t current = world.m_particles.push_back(PBD::CParticle<double>(0.052*k, 0.8, 1, 0.01, 0.05, 4));
+        world.m_permanentConstraints.m_distance.emplace_back(world.m_particles, previous, current);
+        previous = current;
+    }
+}
+
+}
+
+PBD_TEST(snapshot, roundTripContinuesTheSimulation)
+{
+    PBD::CWorld<> saved;
+    createScene(saved);
+    PBD_CHECK(saved.m_rigidBodies.size() == 2 && saved.m_shapeMatchingConstraints.size() == 1);
+    for (size_t s=0; s<20; ++s) saved.step(0.005, 1.0);
+
+    const std::string path = snapshotPath("roundTrip");
+    PBD_CHECK(saved.saveSnapshot(path));
+
+    PBD::CWorld<> loaded;
+    loaded.m_particleSystems.emplace_back(new PBD::CParticleSystem<double>(&loaded.m_particles));
+    PBD_CHECK(loaded.loadSnapshot(path));
+    std::remove(path.c_str());
+
+    PBD_CHECK(loaded.m_particleSystems.empty());
+    PBD_CHECK(loaded.m_particles.size() == saved.m_particles.size());
+    PBD_CHECK(loaded.m_permanentConstraints.size() == saved.m_permanentConstraints.size());
+    PBD_CHECK(loaded.m_shapeMatchingConstraints.size() == saved.m_shapeMatchingConstraints.size());
+    PBD_CHECK(loaded.m_rigidBodies.size() == saved.m_rigidBodies.size());
+    PBD_CHECK(loaded.m_rigidBodyFastPath && loaded.m_gravity == saved.m_gravity);
+
+    for (size_t s=0; s<50; ++s)
+    {
+        saved.step(0.005, 1.0);
+        loaded.step(0.005, 1.0);
+    }
+    saved.syncRigidBodyParticles();
+    loaded.syncRigidBodyParticles();
+    double maxDistance = 0;
+    for (size_t p=0; p<saved.m_particles.size(); ++p)
+    {
+        maxDistance = std::max(maxDistance, (saved.m_particles.m_position[p] - loaded.m_particles.m_position[p]).norm());
+    }
+    PBD_CHECK(maxDistance < 1e-9);
+}
+
+PBD_TEST(snapshot, invalidRigidBodyRangesAreRejected)
+{
+    //Ranges of the same total size as the bodies, so only their placement is wrong
+    const size_t numCorruptions = 3;
+    for (size_t corruption=0; corruption<numCorruptions; ++corruption)
+    {
+        PBD::CWorld<> saved;
+        createScene(saved);
+        auto& first = *saved.m_rigidBodies[0];
+        auto& second = *saved.m_rigidBodies[1];
+        const size_t bodySize = second.m_idxEnd - second.m_idxIni;
+        if (corruption == 0)
+        {
+            //Overlapping ranges
+            second.m_idxIni -= 2;
+            second.m_idxEnd -= 2;
+        }
+        else if (corruption == 1)
+        {
+            //Past the last particle
+            second.m_idxEnd = saved.m_particles.size() + 1;
+            second.m_idxIni = second.m_idxEnd - bodySize;
+        }
+        else
+        {
+            //Static particles of the slab
+            first.m_idxIni = 0;
+            first.m_idxEnd = bodySize;
+        }
+
+        const std::string path = snapshotPath("invalidRanges");
+        PBD_CHECK(saved.saveSnapshot(path));
+
+        PBD::CWorld<> loaded;
+        loaded.m_particles.push_back(PBD::CParticle<double>(0, 0, 0, 1, 0.1, 1));
+        loaded.m_particleSystems.emplace_back(new PBD::CParticleSystem<double>(&loaded.m_particles));
+        PBD_CHECK(!loaded.loadSnapshot(path));
+        std::remove(path.c_str());
+
+        PBD_CHECK(loaded.m_particles.size() == 1);
+        PBD_CHECK(loaded.m_rigidBodies.empty());
+        PBD_CHECK(loaded.m_particleSystems.size() == 1);
+    }
+}
@@ -0,0 +1,181 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+#include <random>
+
+// The analytic static colliders must return the signed distance of a brute force closest point search over dense
+// samples of their surface, with a normal pointing away from the closest point. Particles falling on them must end
+// up resting on their surface.
+
+namespace
+{
+
+typedef Eigen::Vector3d Vector;
+
+/// Smallest distance from p to the samples, and the closest sample.
+double closestSample(const std::vector<Vector>& samples, const Vector& p, Vector& closest)
+{
+    double best = std::numeric_limits<double>::max();
+    for (const auto& s:samples)
+    {
+        const double d = (s - p).squaredNorm();
+        if (d < best)
+        {
+            best = d;
+            closest = s;
+        }
+    }
+    return std::sqrt(best);
+}
+
+/// Compare the collider with the samples of its surface at random points of box. spacing is the sample spacing.
+template<typename T_collider, typename T_inside>
+void checkAgainstSamples(const T_collider& collider, const std::vector<Vector>& samples, T_inside inside,
+                         const Eigen::AlignedBox3d& box, const double& spacing)
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> unit(0, 1);
+    const double tolerance = spacing;
+    size_t insidePoints = 0;
+    for (size_t k=0; k<300; ++k)
+    {
+        const Vector p = box.min() + Vector(unit(rng), unit(rng), unit(rng)).cwiseProduct(box.sizes());
+        Vector normal, closest;
+        const double distance = collider.signedDistance(p, normal, std::numeric_limits<double>::max());
+        const double bruteForce = closestSample(samples, p, closest);
+        const bool isInside = inside(p);
+        insidePoints += isInside ? 1 : 0;
+
+        PBD_CHECK_NEAR(distance, isInside ? -bruteForce : bruteForce, tolerance);
+        PBD_CHECK_NEAR(normal.norm(), 1, 1e-9);
+
+        //Away from the surface, the normal points from the closest point to p (outside) or from p to it (inside)
+        if (bruteForce > 10*spacing)
+        {
+            const Vector direction = (isInside ? closest - p : p - closest).normalized();
+            PBD_CHECK(normal.dot(direction) > 0.98);
+        }
+    }
+    PBD_CHECK(insidePoints > 0 && insidePoints < 300);
+}
+
+}
+
+PBD_TEST(staticColliders, boxMatchesBruteForce)
+{
+    const Eigen::Matrix3d rotation = Eigen::AngleAxisd(0.6, Vector(1,2,3).normalized()).toRotationMatrix();
+    const Vector center(0.2, -0.1, 0.3);
+    const Vector half(0.5, 0.3, 0.2);
+    const PBD::SBoxCollider<double> box(center, half, rotation);
+
+    const double spacing = 0.01;
+    std::vector<Vector> samples;
+    for (int axis=0; axis<3; ++axis)
+    {
+        const int u = (axis+1)%3;
+        const int v = (axis+2)%3;
+        for (double side:{-1.0, 1.0})
+        {
+            for (double a=-half(u); a<=half(u)+1e-12; a+=spacing)
+            {
+                for (double b=-half(v); b<=half(v)+1e-12; b+=spacing)
+                {
+                    Vector local;
+                    local(axis) = side*half(axis);
+                    local(u) = a;
+                    local(v) = b;
+                    samples.push_back(center + rotation*local);
+                }
+            }
+        }
+    }
+    auto inside = [&](const Vector& p){ return ((rotation.transpose()*(p - center)).cwiseAbs() - half).maxCoeff() < 0; };
+    checkAgainstSamples(box, samples, inside, Eigen::AlignedBox3d(center - Vector::Constant(1), center + Vector::Constant(1)), spacing);
+}
+
+PBD_TEST(staticColliders, capsuleMatchesBruteForce)
+{
+    const Vector p0(-0.4, 0.1, 0.2);
+    const Vector p1(0.3, -0.2, 0.5);
+    const double radius = 0.25;
+    const PBD::SCapsuleCollider<double> capsule(p0, p1, radius);
+
+    //Cylinder around the axis and the two hemispherical caps. The inside test uses the distance to axis samples.
+    const double spacing = 0.01;
+    const Vector axis = (p1 - p0).normalized();
+    const Vector u = axis.unitOrthogonal();
+    const Vector v = axis.cross(u);
+    std::vector<Vector> samples;
+    for (double t=0; t<=(p1 - p0).norm(); t+=spacing)
+    {
+        for (double angle=0; angle<2*M_PI; angle+=spacing/radius)
+        {
+            samples.push_back(p0 + t*axis + radius*(std::cos(angle)*u + std::sin(angle)*v));
+        }
+    }
+    const size_t numSphere = 8000;
+    for (size_t k=0; k<numSphere; ++k)
+    {
+        //Fibonacci sphere, about one point per spacing^2
+        const double z = 1 - 2*(k + 0.5)/numSphere;
+        const double phi = k * M_PI * (3 - std::sqrt(5.0));
+        const Vector s = radius * Vector(std::sqrt(1 - z*z)*std::cos(phi), std::sqrt(1 - z*z)*std::sin(phi), z);
+        samples.push_back((s.dot(axis) < 0 ? p0 : p1) + s);
+    }
+    std::vector<Vector> centers;
+    for (double t=0; t<=1+1e-12; t+=0.002) centers.push_back(p0 + t*(p1 - p0));
+    auto inside = [&](const Vector& p){ Vector c; return closestSample(centers, p, c) < radius; };
+    checkAgainstSamples(capsule, samples, inside, Eigen::AlignedBox3d(Vector(-0.8,-0.6,-0.2), Vector(0.7,0.4,0.9)), spacing);
+}
+
+PBD_TEST(staticColliders, heightfieldMatchesBruteForce)
+{
+    //Tilted plane sampled on the grid: the bilinear surface is the plane itself
+    const size_t n = 21;
+    const double gridSpacing = 0.1;
+    const Vector origin(-1, -1, 0.1);
+    std::vector<double> heights(n*n);
+    auto height = [](const double& x, const double& y){ return 0.3*x - 0.2*y; };
+    for (size_t j=0; j<n; ++j)
+    {
+        for (size_t i=0; i<n; ++i) heights[j*n + i] = height(i*gridSpacing, j*gridSpacing);
+    }
+    const PBD::SHeightfieldCollider<double> heightfield(origin, gridSpacing, n, n, heights);
+
+    const double spacing = 0.01;
+    std::vector<Vector> samples;
+    for (double x=0; x<=2+1e-12; x+=spacing)
+    {
+        for (double y=0; y<=2+1e-12; y+=spacing) samples.push_back(origin + Vector(x, y, height(x, y)));
+    }
+    auto inside = [&](const Vector& p){ return p(2) - origin(2) < height(p(0) - origin(0), p(1) - origin(1)); };
+
+    //Close enough to the surface for the closest point to be on the grid footprint
+    checkAgainstSamples(heightfield, samples, inside, Eigen::AlignedBox3d(Vector(-0.6,-0.6,-0.1), Vector(0.6,0.6,0.5)), spacing);
+
+    //Outside the footprint nothing collides
+    Vector normal;
+    PBD_CHECK(heightfield.signedDistance(Vector(1.5, 0, 0), normal) == std::numeric_limits<double>::max());
+}
+
+PBD_TEST(staticColliders, particlesRestOnColliders)
+{
+    PBD::CWorld<> world;
+    world.m_gravity = Vector(0,0,-9.81);
+    world.m_staticColliders.m_boxes.emplace_back(Vector(0,0,0), Vector(0.3,0.3,0.3),
+                                                 Eigen::AngleAxisd(0.3, Vector::UnitX()).toRotationMatrix());
+    world.m_staticColliders.m_capsules.emplace_back(Vector(2,-0.5,0), Vector(2,0.5,0), 0.2);
+    world.m_staticColliders.m_planes.emplace_back(Vector(0,0,-2), Vector(0,0,1));
+    const size_t onBox = world.m_particles.push_back(PBD::CParticle<double>(0.05, 0.05, 0.6, 0.01, 0.1, 1));
+    const size_t onCapsule = world.m_particles.push_back(PBD::CParticle<double>(2, 0, 0.5, 0.01, 0.1, 2));
+
+    for (size_t s=0; s<300; ++s) world.step(0.005, 1.0);
+
+    //The box top is tilted: the particle slides off it and down to the plane, the capsule holds its particle on top
+    Vector normal;
+    const Vector& x = world.m_particles.m_position[onBox];
+    PBD_CHECK_NEAR(world.m_staticColliders.m_planes[0].signedDistance(x, normal), 0.05, 1e-3);
+    PBD_CHECK(world.m_staticColliders.m_boxes[0].signedDistance(x, normal) >= 0.05 - 1e-3);
+    const Vector& y = world.m_particles.m_position[onCapsule];
+    PBD_CHECK_NEAR(world.m_staticColliders.m_capsules[0].signedDistance(y, normal), 0.05, 1e-3);
+    PBD_CHECK(y(2) > 0.2);
+}
@@ -0,0 +1,42 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+
+// getStepStats() describes the last step: phase times adding up to at most the step time, the constraints each solver
+// saw and the violation the contact solve left.
+
+PBD_TEST(stepStats, lastStepIsReported)
+{
+    typedef vec3::Vector3<double> V;
+    PBD::CWorld<> world;
+    world.m_gravity = Eigen::Vector3d(0,0,-9.81);
+    PBD::createParticleSystemSolidCube<double>(V(-1,-1,0), V(2,2,0.1), &world, 0.1, 0, 0);
+    PBD::createParticleSystemSolidCube<double>(V(-0.1,-0.1,0.2), V(0.3,0.3,0.3), &world, 0.1, 0.02, 1);
+    size_t previous = world.m_particles.push_back(PBD::CParticle<double>(0, 0.8, 1, 0, 0.05, 2));
+    for (size_t k=1; k<5; ++k)
+    {
+        const size_t current = world.m_particles.push_back(PBD::CParticle<double>(0.052*k, 0.8, 1, 0.01, 0.05, 2));
+        world.m_permanentConstraints.m_distance.emplace_back(world.m_particles, previous, current);
+        previous = current;
+    }
+
+    PBD_CHECK(world.getStepStats().m_totalTime == 0);
+    for (size_t s=0; s<100; ++s) world.step(0.005, 1.0);
+
+    const PBD::CStepStats& stats = world.getStepStats();
+    const double phases = stats.m_preStabilizationTime + stats.m_integrationTime + stats.m_collisionDetectionTime +
+                          stats.m_contactSolveTime + stats.m_shapeMatchingTime + stats.m_velocityUpdateTime;
+    PBD_CHECK(stats.m_totalTime > 0);
+    PBD_CHECK(stats.m_preStabilizationTime >= 0 && stats.m_integrationTime >= 0 && stats.m_collisionDetectionTime >= 0 &&
+              stats.m_contactSolveTime >= 0 && stats.m_shapeMatchingTime >= 0 && stats.m_velocityUpdateTime >= 0);
+    PBD_CHECK(phases <= stats.m_totalTime * (1 + 1e-9));
+
+    //The cube rests on the slab, the chain hangs
+    PBD_CHECK(stats.m_numContactConstraints > 0);
+    PBD_CHECK(stats.m_numPermanentConstraints == 4);
+    PBD_CHECK(stats.m_numShapeMatchingConstraints == 1);
+    PBD_CHECK(stats.m_contactIterations >= 1 && stats.m_maxShapeMatchingIterations >= 1);
+    PBD_CHECK(!stats.m_timeoutHit);
+    PBD_CHECK(stats.m_numActiveParticles == world.getNumActiveParticles());
+    PBD_CHECK(stats.m_numActiveParticles == world.m_shapeMatchingConstraints[0]->m_particles.size() + 4);
+    PBD_CHECK(stats.m_rmsError <= stats.m_maxError && stats.m_maxError < 0.01);
+}
@@ -0,0 +1,98 @@
+#include "TestFramework.h"
+#include <physics/CSweepAndPrune.h>
+#include <random>
+
+// The object sweep-and-prune must report exactly the overlapping pairs of the pairwise box test, across updates of
+// moving boxes (kept sorted incrementally), changes of sweep axis and of the number of boxes.
+
+namespace
+{
+
+typedef PBD::CSweepAndPrune<double> SAP;
+
+std::vector<SAP::Pair> pairwiseOverlaps(const std::vector<SAP::Box>& boxes)
+{
+    std::vector<SAP::Pair> pairs;
+    for (size_t i=0; i<boxes.size(); ++i)
+    {
+        for (size_t j=i+1; j<boxes.size(); ++j)
+        {
+            if (!boxes[i].isEmpty() && !boxes[j].isEmpty() && boxes[i].intersects(boxes[j])) pairs.emplace_back(i, j);
+        }
+    }
+    return pairs;
+}
+
+bool samePairs(std::vector<SAP::Pair> pairs, const std::vector<SAP::Pair>& expected)
+{
+    std::sort(pairs.begin(), pairs.end());
+    return pairs == expected;
+}
+
+}
+
+PBD_TEST(sweepAndPrune, movingBoxesMatchPairwiseTest)
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> coordinate(-2, 2);
+    std::uniform_real_distribution<double> extent(0.05, 0.4);
+    std::uniform_real_distribution<double> move(-0.05, 0.05);
+    std::uniform_int_distribution<int> choice(0, 9);
+
+    SAP sap;
+    std::vector<SAP::Pair> pairs;
+    for (size_t scene=0; scene<5; ++scene)
+    {
+        //Boxes on a 0.25 grid touch exactly; a few are empty
+        std::vector<SAP::Box> boxes(150 + 50*scene);
+        for (auto& box:boxes)
+        {
+            Eigen::Vector3d center(coordinate(rng), coordinate(rng), coordinate(rng));
+            Eigen::Vector3d half(extent(rng), extent(rng), extent(rng));
+            if (choice(rng) == 0)
+            {
+                center = (center / 0.25).array().round().matrix() * 0.25;
+                half.setConstant(0.125);
+            }
+            box = SAP::Box(center - half, center + half);
+            if (choice(rng) == 0) box.setEmpty();
+        }
+
+        for (size_t update=0; update<20; ++update)
+        {
+            sap.update(boxes, pairs);
+            PBD_CHECK(samePairs(pairs, pairwiseOverlaps(boxes)));
+
+            //Small moves, and stretches along x then z so the sweep axis changes
+            for (auto& box:boxes)
+            {
+                if (box.isEmpty()) continue;
+                Eigen::Vector3d delta(move(rng), move(rng), move(rng));
+                delta(update < 10 ? 0 : 2) *= 10;
+                box.translate(delta * (1 + (update % 10)));
+            }
+        }
+    }
+}
+
+PBD_TEST(sweepAndPrune, degenerateSets)
+{
+    SAP sap;
+    std::vector<SAP::Pair> pairs(1, SAP::Pair(0, 1));
+    std::vector<SAP::Box> boxes;
+    sap.update(boxes, pairs);
+    PBD_CHECK(pairs.empty());
+
+    //Identical boxes all overlap, empty ones never
+    boxes.assign(4, SAP::Box(Eigen::Vector3d(0,0,0), Eigen::Vector3d(1,1,1)));
+    boxes.emplace_back();
+    sap.update(boxes, pairs);
+    PBD_CHECK(samePairs(pairs, pairwiseOverlaps(boxes)));
+    PBD_CHECK(pairs.size() == 6);
+
+    //Boxes touching at a corner overlap
+    boxes.assign(1, SAP::Box(Eigen::Vector3d(0,0,0), Eigen::Vector3d(1,1,1)));
+    boxes.emplace_back(Eigen::Vector3d(1,1,1), Eigen::Vector3d(2,2,2));
+    sap.update(boxes, pairs);
+    PBD_CHECK(pairs.size() == 1);
+}
@@ -0,0 +1,27 @@
+#include "TestFramework.h"
+
+// Usage: pbd_tests [test name prefix]
+
+int main( int argc, char** argv )
+{
+    const std::string prefix = argc > 1 ? argv[1] : "";
+
+    size_t run = 0;
+    for (const auto& test:PBDTest::registry())
+    {
+        if (test.m_name.compare(0, prefix.size(), prefix) != 0) continue;
+
+        const size_t failedBefore = PBDTest::failedChecks();
+        test.m_function();
+        std::cout << (PBDTest::failedChecks() == failedBefore ? "[ OK ] " : "[FAIL] ") << test.m_name << std::endl;
+        ++run;
+    }
+
+    if (run == 0)
+    {
+        std::cerr << "No test matches: " << prefix << std::endl;
+        return 1;
+    }
+    std::cout << run << " tests, " << PBDTest::failedChecks() << " failed checks" << std::endl;
+    return PBDTest::failedChecks() == 0 ? 0 : 1;
+}
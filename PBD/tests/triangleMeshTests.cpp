@@ -0,0 +1,221 @@
+#include "TestFramework.h"
+#include <physics/CPositionBasedDynamics.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+// The triangle mesh collider must find the closest point of a brute force search over all the triangles, on the side
+// of the closed surface given by a ray parity test, and report nothing beyond maxDistance. A mesh read from a binary PLY
+// file gives the same distances.
+
+namespace
+{
+
+typedef Eigen::Vector3d Vector;
+typedef PBD::CTriangleMeshCollider<double>::Triangle Triangle;
+
+const double ringRadius = 0.6;
+const double tubeRadius = 0.25;
+
+/// Closed torus around z, counter clockwise seen from outside.
+void createTorus(std::vector<Vector>& vertices, std::vector<Triangle>& triangles)
+{
+    const uint32_t ring = 48, tube = 24;
+    for (uint32_t i=0; i<ring; ++i)
+    {
+        const double u = 2*M_PI*i/ring;
+        for (uint32_t j=0; j<tube; ++j)
+        {
+            const double v = 2*M_PI*j/tube;
+            const double r = ringRadius + tubeRadius*std::cos(v);
+            vertices.emplace_back(r*std::cos(u), r*std::sin(u), tubeRadius*std::sin(v));
+        }
+    }
+    for (uint32_t i=0; i<ring; ++i)
+    {
+        for (uint32_t j=0; j<tube; ++j)
+        {
+            const uint32_t a = i*tube + j, b = ((i+1)%ring)*tube + j;
+            const uint32_t c = ((i+1)%ring)*tube + (j+1)%tube, d = i*tube + (j+1)%tube;
+            triangles.push_back({a, b, c});
+            triangles.push_back({a, c, d});
+        }
+    }
+}
+
+/// Closest point of triangle abc to p (Real-Time Collision Detection, 5.1.5).
+Vector closestPointOnTriangle(const Vector& p, const Vector& a, const Vector& b, const Vector& c)
+{
+    const Vector ab = b - a, ac = c - a, ap = p - a;
+    const double d1 = ab.dot(ap), d2 = ac.dot(ap);
+    if (d1 <= 0 && d2 <= 0) return a;
+    const Vector bp = p - b;
+    const double d3 = ab.dot(bp), d4 = ac.dot(bp);
+    if (d3 >= 0 && d4 <= d3) return b;
+    const double vc = d1*d4 - d3*d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+    const Vector cp = p - c;
+    const double d5 = ab.dot(cp), d6 = ac.dot(cp);
+    if (d6 >= 0 && d5 <= d6) return c;
+    const double vb = d5*d2 - d1*d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+    const double va = d3*d6 - d5*d4;
+    if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    const double denominator = 1 / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+double bruteForceDistance(const std::vector<Vector>& vertices, const std::vector<Triangle>& triangles, const Vector& p)
+{
+    double best = std::numeric_limits<double>::max();
+    for (const auto& t:triangles)
+    {
+        best = std::min(best, (closestPointOnTriangle(p, vertices[t[0]], vertices[t[1]], vertices[t[2]]) - p).squaredNorm());
+    }
+    return std::sqrt(best);
+}
+
+/// Inside test of a closed mesh: parity of the crossings of a ray in a direction no edge or vertex lies on.
+bool isInside(const std::vector<Vector>& vertices, const std::vector<Triangle>& triangles, const Vector& p)
+{
+    const Vector direction = Vector(0.5377, 0.3188, 0.7806).normalized();
+    size_t crossings = 0;
+    for (const auto& t:triangles)
+    {
+        //Moller-Trumbore
+        const Vector e1 = vertices[t[1]] - vertices[t[0]];
+        const Vector e2 = vertices[t[2]] - vertices[t[0]];
+        const Vector h = direction.cross(e2);
+        const double det = e1.dot(h);
+        if (std::abs(det) < 1e-15) continue;
+        const Vector s = p - vertices[t[0]];
+        const double u = s.dot(h) / det;
+        const Vector q = s.cross(e1);
+        const double v = direction.dot(q) / det;
+        if (u >= 0 && v >= 0 && u + v <= 1 && e2.dot(q) / det > 0) ++crossings;
+    }
+    return crossings % 2 == 1;
+}
+
+}
+
+PBD_TEST(triangleMesh, torusMatchesBruteForce)
+{
+    std::vector<Vector> vertices;
+    std::vector<Triangle> triangles;
+    createTorus(vertices, triangles);
+    PBD::CTriangleMeshCollider<double> mesh(vertices, triangles);
+    PBD_CHECK(!mesh.empty() && mesh.getBVH()->getNumTriangles() == triangles.size());
+    mesh.m_position = Vector(0.3, -1, 2);
+    mesh.m_rotation = Eigen::AngleAxisd(1.1, Vector(2,1,-1).normalized()).toRotationMatrix();
+
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<double> coordinate(-1, 1);
+    size_t insidePoints = 0;
+    for (size_t k=0; k<500; ++k)
+    {
+        const Vector local = Vector(coordinate(rng), coordinate(rng), 0.5*coordinate(rng));
+        const Vector p = mesh.m_position + mesh.m_rotation*local;
+        Vector normal;
+        const double distance = mesh.signedDistance(p, normal);
+        const double bruteForce = bruteForceDistance(vertices, triangles, local);
+        PBD_CHECK_NEAR(std::abs(distance), bruteForce, 1e-9);
+        PBD_CHECK_NEAR(normal.norm(), 1, 1e-9);
+        PBD_CHECK((distance < 0) == isInside(vertices, triangles, local));
+        insidePoints += distance < 0 ? 1 : 0;
+
+        //Within maxDistance only
+        if (bruteForce > 0.01)
+        {
+            PBD_CHECK(mesh.signedDistance(p, normal, 0.99*bruteForce) == std::numeric_limits<double>::max());
+            PBD_CHECK(mesh.signedDistance(p, normal, 1.01*bruteForce) == distance);
+        }
+    }
+    PBD_CHECK(insidePoints > 0 && insidePoints < 500);
+
+    //Far points and negative distances find nothing
+    Vector normal;
+    PBD_CHECK(mesh.signedDistance(mesh.m_position + Vector(10, 0, 0), normal, 1) == std::numeric_limits<double>::max());
+    PBD_CHECK(mesh.signedDistance(mesh.m_position, normal, -1) == std::numeric_limits<double>::max());
+    PBD::CTriangleMeshCollider<double>::BVH::SHit hit;
+    PBD_CHECK(!mesh.getBVH()->closestPoint(Vector::Zero(), -1, hit));
+    PBD_CHECK(PBD::CTriangleMeshCollider<double>().signedDistance(Vector::Zero(), normal) == std::numeric_limits<double>::max());
+}
+
+PBD_TEST(triangleMesh, sharpEdgesUsePseudoNormals)
+{
+    //The normals of the faces around an edge or a vertex of a tetrahedron are more than 90 degrees apart: the normal
+    //of one of them would put points near the edge on the wrong side
+    const std::vector<Vector> vertices = { Vector(1,1,1), Vector(1,-1,-1), Vector(-1,1,-1), Vector(-1,-1,1) };
+    const std::vector<Triangle> triangles = { {0,1,2}, {0,3,1}, {0,2,3}, {1,3,2} };
+    const PBD::CTriangleMeshCollider<double> mesh(vertices, triangles);
+
+    std::mt19937 rng(19);
+    std::uniform_real_distribution<double> coordinate(-1.5, 1.5);
+    size_t insidePoints = 0;
+    for (size_t k=0; k<2000; ++k)
+    {
+        const Vector p(coordinate(rng), coordinate(rng), coordinate(rng));
+        Vector normal;
+        const double distance = mesh.signedDistance(p, normal);
+        PBD_CHECK_NEAR(std::abs(distance), bruteForceDistance(vertices, triangles, p), 1e-9);
+        PBD_CHECK((distance < 0) == isInside(vertices, triangles, p));
+        insidePoints += distance < 0 ? 1 : 0;
+    }
+    PBD_CHECK(insidePoints > 0 && insidePoints < 2000);
+}
+
+PBD_TEST(triangleMesh, binaryPLYMatchesMemoryMesh)
+{
+    std::vector<Vector> vertices;
+    std::vector<Triangle> triangles;
+    createTorus(vertices, triangles);
+
+    //Float vertices, and faces with a property before their index list
+    const std::string path = "pbd_tests_mesh_" + std::to_string(getpid()) + ".ply";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "ply\nformat binary_little_endian 1.0\nelement vertex " << vertices.size()
+            << "\nproperty float x\nproperty float y\nproperty float z\nelement face " << triangles.size()
+            << "\nproperty uchar flags\nproperty list uchar int vertex_indices\nend_header\n";
+        for (auto& v:vertices)
+        {
+            const Eigen::Vector3f f = v.cast<float>();
+            out.write(reinterpret_cast<const char*>(f.data()), 3*sizeof(float));
+            v = f.cast<double>();
+        }
+        for (const auto& t:triangles)
+        {
+            const uint8_t flags = 0, count = 3;
+            const int32_t indices[3] = { int32_t(t[0]), int32_t(t[1]), int32_t(t[2]) };
+            out.write(reinterpret_cast<const char*>(&flags), 1);
+            out.write(reinterpret_cast<const char*>(&count), 1);
+            out.write(reinterpret_cast<const char*>(indices), sizeof(indices));
+        }
+    }
+
+    std::vector<Vector> readVertices;
+    std::vector<Triangle> readTriangles;
+    PBD_CHECK(PBD::readBinaryPLYMesh<double>(path, readVertices, readTriangles));
+    PBD_CHECK(readVertices == vertices && readTriangles == triangles);
+
+    PBD::CTriangleMeshCollider<double> loaded;
+    PBD_CHECK(loaded.load(path, 2));
+    std::remove(path.c_str());
+    PBD_CHECK(!loaded.load(path));
+    PBD_CHECK(!loaded.empty());
+
+    //The mesh was scaled by 2 when loaded
+    for (auto& v:vertices) v *= 2;
+    const PBD::CTriangleMeshCollider<double> memory(vertices, triangles);
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<double> coordinate(-2, 2);
+    for (size_t k=0; k<200; ++k)
+    {
+        const Vector p(coordinate(rng), coordinate(rng), coordinate(rng));
+        Vector loadedNormal, memoryNormal;
+        PBD_CHECK_NEAR(loaded.signedDistance(p, loadedNormal), memory.signedDistance(p, memoryNormal), 1e-12);
+        PBD_CHECK((loadedNormal - memoryNormal).norm() < 1e-9);
+    }
+}